@@ -15,14 +15,30 @@ echo "  Machine Report vs Fastfetch Benchmark Suite"
 echo "==================================================================="
 echo ""
 
+FRAMEWORKS=""
+if [ "$(uname)" = "Darwin" ]; then
+    FRAMEWORKS="-framework IOKit -framework CoreFoundation"
+fi
+
 # Check if machine_report exists
 if [ ! -f "$MACHINE_REPORT" ]; then
     echo "Error: machine_report not found. Compiling..."
-    clang++ -std=c++17 -O3 -march=native -flto -o "$MACHINE_REPORT" "$SCRIPT_DIR/machine_report.cpp"
+    ${CXX:-c++} -std=c++17 -O3 -march=native -flto -o "$MACHINE_REPORT" "$SCRIPT_DIR/machine_report.cpp" $FRAMEWORKS
     echo "Compilation complete."
     echo ""
 fi
 
+# Checks of internals against the fixtures in tests/
+TEST_BUILD_DIR=$(mktemp -d)
+trap 'rm -rf "$TEST_BUILD_DIR"' EXIT
+SELFTEST="$TEST_BUILD_DIR/selftest"
+${CXX:-c++} -std=c++17 -O2 -march=native -o "$SELFTEST" "$SCRIPT_DIR/tests/selftest.cpp" \
+    $FRAMEWORKS -lpthread
+# machine_report with the test hooks, such as MACHINE_REPORT_STALL, compiled in
+MACHINE_REPORT_HOOKS="$TEST_BUILD_DIR/machine_report_hooks"
+${CXX:-c++} -std=c++17 -O2 -DMACHINE_REPORT_TEST_HOOKS -o "$MACHINE_REPORT_HOOKS" \
+    "$SCRIPT_DIR/machine_report.cpp" $FRAMEWORKS -lpthread
+
 # Check if fastfetch is installed
 if ! command -v fastfetch &> /dev/null; then
     echo "Warning: fastfetch not found. Install with: brew install fastfetch"
@@ -133,6 +149,556 @@ if command -v /usr/bin/time &> /dev/null; then
     fi
 fi
 
+# Process spawn check: the report must not fork or exec anything
+echo "==================================================================="
+echo "  Process Spawn Check"
+echo "==================================================================="
+echo ""
+
+if command -v strace &> /dev/null; then
+    TRACE_FILE=$(mktemp)
+    strace -f -qq -e trace=fork,vfork,execve,execveat,posix_spawn -o "$TRACE_FILE" "$MACHINE_REPORT" > /dev/null
+    # The only exec allowed is the one that started machine_report itself
+    SPAWNS=$(( $(grep -cE 'fork\(|execve(at)?\(|posix_spawn' "$TRACE_FILE") - 1 ))
+    rm -f "$TRACE_FILE"
+    if [ "$SPAWNS" -eq 0 ]; then
+        echo "✅ no fork/exec calls"
+    else
+        echo "❌ $SPAWNS fork/exec calls"
+        exit 1
+    fi
+elif command -v dtruss &> /dev/null && [ "$(id -u)" -eq 0 ]; then
+    SPAWNS=$(dtruss -f "$MACHINE_REPORT" 2>&1 >/dev/null | grep -cE '^ *[0-9/]+ +(fork|vfork|posix_spawn|execve)\(' || true)
+    if [ "$SPAWNS" -eq 0 ]; then
+        echo "✅ no fork/exec calls"
+    else
+        echo "❌ $SPAWNS fork/exec calls"
+        exit 1
+    fi
+else
+    echo "  (strace or root dtruss required, skipping)"
+fi
+echo ""
+
+# Disk collector against a container-host sized mount table: 250 extra
+# bind and tmpfs mounts in a private mount namespace (Linux only)
+echo "==================================================================="
+echo "  Mount Table Scaling"
+echo "==================================================================="
+echo ""
+
+MOUNT_COUNT=250
+if [ "$(uname)" = "Linux" ] && unshare -rm true 2>/dev/null; then
+    MOUNT_DIR=$(mktemp -d)
+    DISK_MS=$(unshare -rm sh -c "
+        for i in \$(seq $MOUNT_COUNT); do
+            mkdir -p \"$MOUNT_DIR/\$i\"
+            if [ \$((i % 2)) -eq 0 ]; then
+                mount --bind \"$MOUNT_DIR/\$i\" \"$MOUNT_DIR/\$i\"
+            else
+                mount -t tmpfs -o size=1m tmpfs \"$MOUNT_DIR/\$i\"
+            fi
+        done
+        \"$MACHINE_REPORT\" --profile /dev/null 2>&1 >/dev/null | awk '\$1 == \"collect.disk\" { print \$2 }'
+    ")
+    rm -rf "$MOUNT_DIR"
+    echo "  disk collector with $MOUNT_COUNT extra mounts: ${DISK_MS} ms"
+    if awk "BEGIN { exit !($DISK_MS < 1.0) }"; then
+        echo "✅ under 1 ms"
+    else
+        echo "⚠️  over 1 ms"
+    fi
+else
+    echo "  (Linux with unprivileged user namespaces required, skipping)"
+fi
+echo ""
+
+echo "==================================================================="
+echo "  Process Table Scaling"
+echo "==================================================================="
+echo ""
+
+PROCESS_COUNT=50000
+if [ "$(uname)" = "Linux" ] && unshare -rm true 2>/dev/null; then
+    # A synthetic /proc of stat files bind-mounted over the real one
+    PROC_DIR=$(mktemp -d)
+    seq "$PROCESS_COUNT" | sed "s|^|$PROC_DIR/|" | xargs mkdir
+    seq "$PROCESS_COUNT" | awk -v dir="$PROC_DIR" '{
+        file = dir "/" $1 "/stat"
+        printf "%d (worker-%d) S 1 %d %d 0 -1 4194560 1234 0 0 0 %d %d 0 0 20 0 1 0 %d 12345678 %d 0\n",
+               $1, $1 % 977, $1, $1, $1 % 500, $1 % 300, $1 * 7, $1 % 4000 + 100 > file
+        close(file)
+    }'
+    SCAN_MS=$(unshare -rm sh -c "
+        mount --bind \"$PROC_DIR\" /proc
+        \"$MACHINE_REPORT\" --top 5 --profile /dev/null 2>&1 >/dev/null | awk '\$1 == \"collect.processes\" { print \$2 }'
+    ")
+    rm -rf "$PROC_DIR"
+    echo "  process scan with $PROCESS_COUNT processes: ${SCAN_MS} ms"
+    # The target assumes a descriptor kept open per process and the table
+    # split across cores; smaller hosts only get a warning
+    SCAN_CORES=$(nproc)
+    SCAN_FDS=$(ulimit -Hn)
+    SCAN_STRICT=false
+    if [ "$SCAN_CORES" -ge 8 ] &&
+        { [ "$SCAN_FDS" = "unlimited" ] || [ "$SCAN_FDS" -gt $((PROCESS_COUNT + 256)) ]; }; then
+        SCAN_STRICT=true
+    fi
+    if awk "BEGIN { exit !($SCAN_MS < 20.0) }"; then
+        echo "✅ under 20 ms"
+    elif [ "$SCAN_STRICT" = true ]; then
+        echo "❌ over 20 ms on $SCAN_CORES cores"
+        exit 1
+    else
+        echo "⚠️  over 20 ms on $SCAN_CORES cores with a descriptor limit of $SCAN_FDS;"
+        echo "   the target is checked from 8 cores and $((PROCESS_COUNT + 256)) descriptors"
+    fi
+else
+    echo "  (Linux with unprivileged user namespaces required, skipping)"
+fi
+
+# The parallel path on four threads whatever the core count, then with the
+# pool workers' chunks hung: the scan must drop them and return
+if SCAN_RESULT=$("$SELFTEST" process-scan) &&
+    STALLED_RESULT=$(MACHINE_REPORT_STALL=process_scan:5000 "$SELFTEST" process-scan stalled); then
+    echo "✅ parallel scan: $SCAN_RESULT"
+    echo "✅ hung pool workers: $STALLED_RESULT"
+else
+    echo "$SCAN_RESULT"
+    echo "$STALLED_RESULT"
+    echo "❌ parallel process scan missed a chunk or waited on hung workers"
+    exit 1
+fi
+echo ""
+
+echo "==================================================================="
+echo "  Block Device Scaling"
+echo "==================================================================="
+echo ""
+
+NAMESPACE_COUNT=256
+DM_COUNT=200
+if [ "$(uname)" = "Linux" ] && unshare -rm true 2>/dev/null; then
+    # A synthetic /proc/diskstats of NVMe namespaces with three partitions
+    # each, plus dm devices, bind-mounted over the real one
+    DISKSTATS=$(mktemp)
+    awk -v namespaces="$NAMESPACE_COUNT" -v dms="$DM_COUNT" 'BEGIN {
+        minor = 0
+        for (i = 0; i < namespaces; i++) {
+            name = sprintf("nvme%dn%d", int(i / 16), i % 16 + 1)
+            printf " 259 %d %s %d 0 %d %d %d 0 %d %d 0 %d %d 0 0 0 0 0 0\n",
+                   minor++, name, i + 100, i * 800, i, i + 50, i * 400, i, i * 2, i * 3
+            for (p = 1; p <= 3; p++) {
+                printf " 259 %d %sp%d 10 0 80 1 5 0 40 1 0 1 2 0 0 0 0 0 0\n", minor++, name, p
+            }
+        }
+        for (i = 0; i < dms; i++) {
+            printf " 252 %d dm-%d %d 0 %d 1 %d 0 8 1 0 %d 2 0 0 0 0 0 0\n", i, i, i + 1, i * 8, i + 1, i
+        }
+    }' > "$DISKSTATS"
+    IO_MS=$(unshare -rm sh -c "
+        mount --bind \"$DISKSTATS\" /proc/diskstats
+        \"$MACHINE_REPORT\" --profile /dev/null 2>&1 >/dev/null | awk '\$1 == \"collect.disk_io\" { print \$2 }'
+    ")
+    rm -f "$DISKSTATS"
+    echo "  disk I/O sample with $NAMESPACE_COUNT namespaces and $DM_COUNT dm devices: ${IO_MS} ms"
+    if awk "BEGIN { exit !($IO_MS < 1.0) }"; then
+        echo "✅ under 1 ms"
+    else
+        echo "⚠️  over 1 ms"
+    fi
+else
+    echo "  (Linux with unprivileged user namespaces required, skipping)"
+fi
+echo ""
+
+echo "==================================================================="
+echo "  Collector Deadlines"
+echo "==================================================================="
+echo ""
+
+# The user lookup (blocking, 1 s deadline) and the disk collector (I/O,
+# 300 ms) hang for 5 s: the report must still come out after about 1 s,
+# with those rows reading "timeout"
+STALL_START=$(date +%s%N)
+STALL_OUTPUT=$(MACHINE_REPORT_STALL=user:5000,disk:5000 "$MACHINE_REPORT_HOOKS" --no-cache \
+    --cpu-window 0 | sed 's/\x1b\[[0-9;]*m//g')
+STALL_MS=$(( ($(date +%s%N) - STALL_START) / 1000000 ))
+echo "  report with two hung collectors: ${STALL_MS} ms"
+if echo "$STALL_OUTPUT" | grep -q "user: *timeout" &&
+        echo "$STALL_OUTPUT" | grep -q "volume: .* timeout" && [ "$STALL_MS" -lt 1500 ]; then
+    echo "✅ printed within the deadline, hung rows read timeout"
+else
+    echo "$STALL_OUTPUT"
+    echo "❌ hung collectors held up the report or were not marked"
+    exit 1
+fi
+
+# With --watch the hung disk collector is still on its worker on later
+# ticks; it must time out straight away instead of holding up every tick
+WATCH_FILE="$TEST_BUILD_DIR/watch.json"
+MACHINE_REPORT_STALL=disk:5000 "$MACHINE_REPORT_HOOKS" --json --watch 0.25 > "$WATCH_FILE" &
+WATCH_PID=$!
+sleep 2
+kill "$WATCH_PID"
+wait "$WATCH_PID" 2>/dev/null || true
+WATCH_TICKS=$(wc -l < "$WATCH_FILE")
+WATCH_MARKED=$(grep -c '"timed_out":\["disk"\]' "$WATCH_FILE" || true)
+echo "  --watch 0.25 for 2 s with the disk collector hung: $WATCH_TICKS ticks"
+if [ "$WATCH_TICKS" -ge 4 ] && [ "$WATCH_MARKED" -eq "$WATCH_TICKS" ]; then
+    echo "✅ every tick arrived with disk timed out"
+else
+    echo "❌ $WATCH_MARKED of $WATCH_TICKS ticks marked disk as timed out"
+    exit 1
+fi
+echo ""
+
+echo "==================================================================="
+echo "  Nameserver Probe"
+echo "==================================================================="
+echo ""
+
+# A stub nameserver on loopback addresses stands in for resolv.conf's
+# servers: one answers, one answers with SERVFAIL, one never answers and one
+# answers after 150 ms. The run must name each one's state and, with a
+# server that never answers, take no longer than --dns-probe plus startup.
+if [ "$(uname)" = "Linux" ]; then
+    python3 "$SCRIPT_DIR/tests/dns_stub.py" 127.0.0.2=answer 127.0.0.3=servfail 127.0.0.4=drop \
+        127.0.0.5=delay:150 > "$TEST_BUILD_DIR/dns_port" &
+    DNS_STUB_PID=$!
+    for i in $(seq 50); do
+        [ -s "$TEST_BUILD_DIR/dns_port" ] && break
+        sleep 0.1
+    done
+    DNS_PORT=$(head -n 1 "$TEST_BUILD_DIR/dns_port")
+    printf 'nameserver 127.0.0.2\nnameserver 127.0.0.3\nnameserver 127.0.0.4\n' \
+        > "$TEST_BUILD_DIR/resolv_mixed.conf"
+    printf 'nameserver 127.0.0.5\n' > "$TEST_BUILD_DIR/resolv_slow.conf"
+    probe_report() {
+        MACHINE_REPORT_RESOLV_CONF="$TEST_BUILD_DIR/$1" MACHINE_REPORT_DNS_PORT="$DNS_PORT" \
+            "$MACHINE_REPORT_HOOKS" --no-cache --cpu-window 0 --dns-probe 300
+    }
+    PROBE_START=$(date +%s%N)
+    MIXED_OUTPUT=$(probe_report resolv_mixed.conf)
+    PROBE_MS=$(( ($(date +%s%N) - PROBE_START) / 1000000 ))
+    SLOW_OUTPUT=$(probe_report resolv_slow.conf)
+    kill "$DNS_STUB_PID"
+    if echo "$MIXED_OUTPUT" | grep -Eq "127\.0\.0\.2 [0-9.]+ ms" &&
+        echo "$MIXED_OUTPUT" | grep -q "127.0.0.3 error" &&
+        echo "$MIXED_OUTPUT" | grep -q "127.0.0.4 dead" &&
+        echo "$SLOW_OUTPUT" | grep -Eq "127\.0\.0\.5 slow [0-9]+ ms"; then
+        echo "✅ answering, SERVFAIL, silent and slow servers read ok, error, dead and slow"
+    else
+        echo "$MIXED_OUTPUT" "$SLOW_OUTPUT" | grep "dns"
+        echo "❌ nameserver rows do not match the stub's behaviour"
+        exit 1
+    fi
+    if [ "$PROBE_MS" -ge 300 ] && [ "$PROBE_MS" -lt 500 ]; then
+        echo "✅ run with a silent server took ${PROBE_MS} ms against --dns-probe 300"
+    else
+        echo "❌ run with a silent server took ${PROBE_MS} ms against --dns-probe 300"
+        exit 1
+    fi
+else
+    echo "  (needs the whole of 127.0.0.0/8 on loopback, skipping)"
+fi
+echo ""
+
+echo "==================================================================="
+echo "  Golden Render"
+echo "==================================================================="
+echo ""
+
+# A fixed report, and the same one with every collector timed out, must
+# render byte for byte as the checked-in terminal output
+RENDER_DIR="$SCRIPT_DIR/tests/fixtures/render"
+RENDER_FAILED=0
+check_render() {
+    local golden=$1
+    shift
+    "$SELFTEST" render "$@" > "$TEST_BUILD_DIR/$golden"
+    if cmp -s "$RENDER_DIR/$golden" "$TEST_BUILD_DIR/$golden"; then
+        echo "✅ $golden matches"
+    else
+        diff -u "$RENDER_DIR/$golden" "$TEST_BUILD_DIR/$golden" | cat -v | head -40
+        echo "❌ $golden differs"
+        RENDER_FAILED=1
+    fi
+}
+check_render report.txt
+check_render report_timeouts.txt timeouts
+[ "$RENDER_FAILED" -eq 0 ] || exit 1
+echo ""
+
+echo "==================================================================="
+echo "  Prometheus Exposition"
+echo "==================================================================="
+echo ""
+
+# The fixed report as --prometheus (OpenMetrics) and --textfile (classic
+# text format) write it, against the checked-in files; then the classic
+# parser's rules over the golden and over a live --textfile
+METRICS_FAILED=0
+check_metrics() {
+    local golden=$1
+    shift
+    "$SELFTEST" metrics "$@" > "$TEST_BUILD_DIR/$golden"
+    if cmp -s "$RENDER_DIR/$golden" "$TEST_BUILD_DIR/$golden"; then
+        echo "✅ $golden matches"
+    else
+        diff -u "$RENDER_DIR/$golden" "$TEST_BUILD_DIR/$golden" | head -40
+        echo "❌ $golden differs"
+        METRICS_FAILED=1
+    fi
+}
+check_metrics metrics.prom
+check_metrics metrics_classic.prom classic
+"$MACHINE_REPORT" --textfile "$TEST_BUILD_DIR/live.prom" --cpu-window 0
+if python3 "$SCRIPT_DIR/tests/check_exposition.py" "$RENDER_DIR/metrics_classic.prom" \
+        "$TEST_BUILD_DIR/live.prom"; then
+    echo "✅ --textfile output parses as the classic text format"
+else
+    echo "❌ --textfile output breaks the classic text format"
+    METRICS_FAILED=1
+fi
+[ "$METRICS_FAILED" -eq 0 ] || exit 1
+echo ""
+
+echo "==================================================================="
+echo "  Last Login Fixtures"
+echo "==================================================================="
+echo ""
+
+# Synthetic wtmp files in the 64-bit glibc layout (make_fixtures.py)
+WTMP_DIR="$SCRIPT_DIR/tests/fixtures/wtmp"
+if [ "$(uname)" = "Linux" ]; then
+    if (cd "$WTMP_DIR" && "$SELFTEST" wtmp empty.wtmp logins.wtmp no_logins.wtmp partial.wtmp \
+            truncated.wtmp) | diff -u "$WTMP_DIR/expected.txt" -; then
+        echo "✅ newest login found in every fixture"
+    else
+        echo "❌ last login differs from tests/fixtures/wtmp/expected.txt"
+        exit 1
+    fi
+else
+    echo "  (Linux wtmp layout, skipping)"
+fi
+echo ""
+
+echo "==================================================================="
+echo "  Platform Fixtures"
+echo "==================================================================="
+echo ""
+
+# Each directory in tests/fixtures/dmi stands in for /sys through
+# MACHINE_REPORT_SYSFS_ROOT: firmware strings under class/dmi/id, the CPUID
+# hypervisor name in cpuid_hypervisor (left out on bare metal), and the Xen
+# type under hypervisor. The JSON platform object must match expected.txt.
+DMI_DIR="$SCRIPT_DIR/tests/fixtures/dmi"
+if [ "$(uname)" = "Linux" ]; then
+    if for fixture in "$DMI_DIR"/*/; do
+            name=$(basename "$fixture")
+            printf '%s: ' "$name"
+            MACHINE_REPORT_SYSFS_ROOT="$fixture" "$MACHINE_REPORT_HOOKS" --json --no-cache \
+                --cpu-window 0 |
+                python3 -c 'import json, sys; print(json.dumps(json.load(sys.stdin)["platform"]))'
+        done | diff -u "$DMI_DIR/expected.txt" -; then
+        echo "✅ hypervisor, cloud and instance type named for every fixture"
+    else
+        echo "❌ platform differs from tests/fixtures/dmi/expected.txt"
+        exit 1
+    fi
+else
+    echo "  (Linux sysfs layout, skipping)"
+fi
+echo ""
+
+echo "==================================================================="
+echo "  Network Mounts"
+echo "==================================================================="
+echo ""
+
+# Volumes from fixture mountinfo files: a network mount next to a local
+# root, and a container whose only root is an overlay. With the network
+# statvfs() stalled, only that row may go missing, the wait must stay near
+# its 150 ms budget, and the next pass must skip the mount while it is stuck.
+MOUNT_DIR="$SCRIPT_DIR/tests/fixtures/mountinfo"
+if [ "$(uname)" = "Linux" ]; then
+    if (cd "$MOUNT_DIR" && "$SELFTEST" disks network.mountinfo overlay.mountinfo) |
+            diff -u "$MOUNT_DIR/expected.txt" -; then
+        echo "✅ network and overlay-root volumes listed with their types"
+    else
+        echo "❌ volumes differ from tests/fixtures/mountinfo/expected.txt"
+        exit 1
+    fi
+    MOUNT_START=$(date +%s%N)
+    if (cd "$MOUNT_DIR" && MACHINE_REPORT_STALL=statvfs:5000 "$SELFTEST" disks network.mountinfo) |
+            diff -u "$MOUNT_DIR/expected_stalled.txt" -; then
+        MOUNT_MS=$(( ($(date +%s%N) - MOUNT_START) / 1000000 ))
+        if [ "$MOUNT_MS" -lt 1000 ]; then
+            echo "✅ hung share dropped its own row, both passes in ${MOUNT_MS} ms"
+        else
+            echo "❌ hung share held the disk collector for ${MOUNT_MS} ms"
+            exit 1
+        fi
+    else
+        echo "❌ stalled volumes differ from tests/fixtures/mountinfo/expected_stalled.txt"
+        exit 1
+    fi
+else
+    echo "  (Linux mountinfo, skipping)"
+fi
+echo ""
+
+echo "==================================================================="
+echo "  Display Width: Vector vs Scalar"
+echo "==================================================================="
+echo ""
+
+# getDisplayWidth against the byte-at-a-time function it replaced and a
+# token-by-token loop, in the -march=native build (AVX2 where the CPU has
+# it) and in a baseline build that takes the SSE2 or NEON path
+SELFTEST_BASELINE="$TEST_BUILD_DIR/selftest_baseline"
+${CXX:-c++} -std=c++17 -O2 -o "$SELFTEST_BASELINE" "$SCRIPT_DIR/tests/selftest.cpp" \
+    $FRAMEWORKS -lpthread
+for build in "$SELFTEST" "$SELFTEST_BASELINE"; do
+    if FUZZ_RESULT=$("$build" width-fuzz); then
+        echo "✅ $FUZZ_RESULT"
+    else
+        echo "$FUZZ_RESULT"
+        echo "❌ getDisplayWidth disagrees with the scalar reference"
+        exit 1
+    fi
+done
+"$SELFTEST" width-bench
+echo ""
+
+echo "==================================================================="
+echo "  Display Width Table"
+echo "==================================================================="
+echo ""
+
+# The packed table against a linear search of WIDTH_RANGES for every code
+# point, then the column count of each rendered row, measured independently
+# with Python's unicodedata, against the box border: the golden reports
+# (which carry the Japanese processor and volume labels) and a live run
+if TABLE_RESULT=$("$SELFTEST" width-table); then
+    echo "✅ $TABLE_RESULT"
+else
+    echo "$TABLE_RESULT"
+    echo "❌ width table disagrees with WIDTH_RANGES"
+    exit 1
+fi
+"$MACHINE_REPORT" > "$TEST_BUILD_DIR/live.txt"
+if python3 "$SCRIPT_DIR/tests/check_alignment.py" --require "しょり" --require "きおくいき" \
+        "$SCRIPT_DIR"/tests/fixtures/render/report*.txt &&
+    python3 "$SCRIPT_DIR/tests/check_alignment.py" --require "しょり" "$TEST_BUILD_DIR/live.txt"; then
+    echo "✅ every rendered row is as wide as the border"
+else
+    echo "❌ rendered rows are misaligned"
+    exit 1
+fi
+echo ""
+
+echo "==================================================================="
+echo "  Border Drawing: Per Column vs Layout"
+echo "==================================================================="
+echo ""
+
+# One divider drawn the old way, a glyph copy per column, and from the
+# prebuilt BoxLayout line, at box widths from 20 to 200 columns
+if ! "$SELFTEST" border-bench; then
+    echo "❌ printBorder draws different bytes from the per-column path"
+    exit 1
+fi
+echo ""
+
+# Static facts cache: collection time without a cache record (cold) and
+# with the record the previous run left (warm), in a private cache directory
+echo "==================================================================="
+echo "  Static Cache: Cold vs Warm"
+echo "==================================================================="
+echo ""
+
+CACHE_RUNS=50
+CACHE_DIR=$(mktemp -d)
+collect_ms() {
+    XDG_CACHE_HOME="$CACHE_DIR" "$MACHINE_REPORT" --cpu-window 0 --profile /dev/null 2>&1 >/dev/null |
+        awk '$1 == "collect.total" { print $2 }'
+}
+COLD_TOTAL=0
+WARM_TOTAL=0
+for i in $(seq "$CACHE_RUNS"); do
+    rm -f "$CACHE_DIR/machine_report/static.bin"
+    COLD_TOTAL=$(awk "BEGIN { print $COLD_TOTAL + $(collect_ms) }")
+    WARM_TOTAL=$(awk "BEGIN { print $WARM_TOTAL + $(collect_ms) }")
+done
+rm -rf "$CACHE_DIR"
+COLD_MS=$(awk "BEGIN { printf \"%.3f\", $COLD_TOTAL / $CACHE_RUNS }")
+WARM_MS=$(awk "BEGIN { printf \"%.3f\", $WARM_TOTAL / $CACHE_RUNS }")
+echo "  collection, cold cache: ${COLD_MS} ms (average of $CACHE_RUNS)"
+echo "  collection, warm cache: ${WARM_MS} ms (average of $CACHE_RUNS)"
+if awk "BEGIN { exit !($WARM_MS < $COLD_MS) }"; then
+    echo "✅ warm runs are faster"
+else
+    echo "⚠️  warm runs are not faster"
+fi
+
+# As under sudo: HOME names a directory the effective user does not own, so
+# no record may be written there
+if [ "$(id -u)" -eq 0 ]; then
+    SUDO_HOME=$(mktemp -d)
+    chown nobody "$SUDO_HOME"
+    env -u XDG_CACHE_HOME HOME="$SUDO_HOME" "$MACHINE_REPORT" --cpu-window 0 > /dev/null
+    if [ -e "$SUDO_HOME/.cache" ]; then
+        rm -rf "$SUDO_HOME"
+        echo "❌ root wrote a cache record into another user's home"
+        exit 1
+    fi
+    rm -rf "$SUDO_HOME"
+    echo "✅ no record written into a home root does not own"
+else
+    echo "  (not root, skipping the sudo check)"
+fi
+echo ""
+
+# Daemon load test: many logins at once against one resident daemon
+echo "==================================================================="
+echo "  Daemon Load Test"
+echo "==================================================================="
+echo ""
+
+LOAD_CLIENTS=2000
+LOAD_PARALLEL=64
+LOAD_DIR=$(mktemp -d)
+SOCKET="$LOAD_DIR/machine_report.sock"
+"$MACHINE_REPORT" --daemon --socket "$SOCKET" &
+DAEMON_PID=$!
+for i in $(seq 50); do
+    [ -S "$SOCKET" ] && break
+    sleep 0.1
+done
+EXPECTED_LINES=$("$MACHINE_REPORT" --client --socket "$SOCKET" | wc -l)
+
+LOAD_START=$(date +%s%N)
+# Every client prints its line count; anything but a full report is a failure
+seq "$LOAD_CLIENTS" | xargs -P "$LOAD_PARALLEL" -I{} \
+    sh -c "\"$MACHINE_REPORT\" --client --socket \"$SOCKET\" | wc -l" > "$LOAD_DIR/lines"
+LOAD_END=$(date +%s%N)
+kill "$DAEMON_PID"
+wait "$DAEMON_PID" 2>/dev/null || true
+
+SHORT=$(grep -vcx " *$EXPECTED_LINES" "$LOAD_DIR/lines" || true)
+rm -rf "$LOAD_DIR"
+LOAD_MS=$(( (LOAD_END - LOAD_START) / 1000000 ))
+echo "  $LOAD_CLIENTS clients, $LOAD_PARALLEL at a time: ${LOAD_MS} ms"
+if [ "$SHORT" -eq 0 ]; then
+    echo "✅ every client got the full report"
+else
+    echo "❌ $SHORT clients got a truncated report"
+    exit 1
+fi
+echo ""
+
 echo "==================================================================="
 echo "  Benchmark Complete"
 echo "==================================================================="
@@ -31,26 +31,75 @@
 
 #include <algorithm>
 #include <arpa/inet.h>
-#include <array>
-#include <future>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <dirent.h>
+#include <deque>
+#include <fcntl.h>
+#include <functional>
 #include <ifaddrs.h>
-#include <iomanip>
-#include <iostream>
-#include <mach/mach.h>
-#include <mach/mach_host.h>
 #include <memory>
 #include <netdb.h>
+#include <mutex>
+#include <net/if.h>
 #include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
 #include <pwd.h>
-#include <sstream>
 #include <string>
-#include <sys/mount.h>
+#include <string_view>
 #include <sys/resource.h>
-#include <sys/sysctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/un.h>
+#include <thread>
+#include <type_traits>
 #include <unistd.h>
+#include <utmpx.h>
 #include <vector>
 
+#if defined(__APPLE__)
+#include <CoreFoundation/CoreFoundation.h>
+#include <IOKit/IOBSD.h>
+#include <IOKit/IOKitLib.h>
+#include <IOKit/storage/IOBlockStorageDriver.h>
+#include <libproc.h>
+#include <mach/mach.h>
+#include <mach/mach_host.h>
+#include <mach/mach_time.h>
+#include <net/if_dl.h>
+#include <net/route.h>
+#include <sys/mount.h>
+#include <sys/sysctl.h>
+#elif defined(__linux__)
+#include <sys/mman.h>
+#include <sys/statvfs.h>
+#include <sys/utsname.h>
+#else
+#error "machine_report supports macOS and Linux only"
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
 // Cute pastel color constants
 constexpr const char* PINK = "\033[38;5;213m";
 constexpr const char* CYAN = "\033[38;5;159m";
@@ -74,85 +123,403 @@ constexpr int MAX_DATA_LEN = 32;
 constexpr int BORDERS_AND_PADDING = 7;
 constexpr const char *REPORT_TITLE = "SYSTEM STATUS REPORT";
 
-// Function to execute shell command
-inline std::string execCommand(const char *cmd) {
-  std::array<char, 128> buffer;
-  std::string result;
-  result.reserve(256);
-  std::unique_ptr<FILE, decltype(&pclose)> pipe(popen(cmd, "r"), pclose);
-  if (!pipe) {
-    return "";
+// Code points whose terminal width is not 1, from Unicode 14.0: width 0 for
+// general categories Mn, Me and Cf (except the soft hyphen U+00AD) and the
+// conjoining Hangul jamo U+1160-U+11FF; width 2 for East Asian Width W and F
+// and the unassigned ideograph ranges that default to W. Sorted, disjoint and
+// all above U+007F. Everything not listed, ambiguous width included, is 1.
+struct WidthRange {
+  char32_t first;
+  char32_t last;
+  uint8_t width;
+};
+
+constexpr WidthRange WIDTH_RANGES[] = {
+    {0x0300, 0x036F, 0}, {0x0483, 0x0489, 0}, {0x0591, 0x05BD, 0}, {0x05BF, 0x05BF, 0},
+    {0x05C1, 0x05C2, 0}, {0x05C4, 0x05C5, 0}, {0x05C7, 0x05C7, 0}, {0x0600, 0x0605, 0},
+    {0x0610, 0x061A, 0}, {0x061C, 0x061C, 0}, {0x064B, 0x065F, 0}, {0x0670, 0x0670, 0},
+    {0x06D6, 0x06DD, 0}, {0x06DF, 0x06E4, 0}, {0x06E7, 0x06E8, 0}, {0x06EA, 0x06ED, 0},
+    {0x070F, 0x070F, 0}, {0x0711, 0x0711, 0}, {0x0730, 0x074A, 0}, {0x07A6, 0x07B0, 0},
+    {0x07EB, 0x07F3, 0}, {0x07FD, 0x07FD, 0}, {0x0816, 0x0819, 0}, {0x081B, 0x0823, 0},
+    {0x0825, 0x0827, 0}, {0x0829, 0x082D, 0}, {0x0859, 0x085B, 0}, {0x0890, 0x0891, 0},
+    {0x0898, 0x089F, 0}, {0x08CA, 0x0902, 0}, {0x093A, 0x093A, 0}, {0x093C, 0x093C, 0},
+    {0x0941, 0x0948, 0}, {0x094D, 0x094D, 0}, {0x0951, 0x0957, 0}, {0x0962, 0x0963, 0},
+    {0x0981, 0x0981, 0}, {0x09BC, 0x09BC, 0}, {0x09C1, 0x09C4, 0}, {0x09CD, 0x09CD, 0},
+    {0x09E2, 0x09E3, 0}, {0x09FE, 0x09FE, 0}, {0x0A01, 0x0A02, 0}, {0x0A3C, 0x0A3C, 0},
+    {0x0A41, 0x0A42, 0}, {0x0A47, 0x0A48, 0}, {0x0A4B, 0x0A4D, 0}, {0x0A51, 0x0A51, 0},
+    {0x0A70, 0x0A71, 0}, {0x0A75, 0x0A75, 0}, {0x0A81, 0x0A82, 0}, {0x0ABC, 0x0ABC, 0},
+    {0x0AC1, 0x0AC5, 0}, {0x0AC7, 0x0AC8, 0}, {0x0ACD, 0x0ACD, 0}, {0x0AE2, 0x0AE3, 0},
+    {0x0AFA, 0x0AFF, 0}, {0x0B01, 0x0B01, 0}, {0x0B3C, 0x0B3C, 0}, {0x0B3F, 0x0B3F, 0},
+    {0x0B41, 0x0B44, 0}, {0x0B4D, 0x0B4D, 0}, {0x0B55, 0x0B56, 0}, {0x0B62, 0x0B63, 0},
+    {0x0B82, 0x0B82, 0}, {0x0BC0, 0x0BC0, 0}, {0x0BCD, 0x0BCD, 0}, {0x0C00, 0x0C00, 0},
+    {0x0C04, 0x0C04, 0}, {0x0C3C, 0x0C3C, 0}, {0x0C3E, 0x0C40, 0}, {0x0C46, 0x0C48, 0},
+    {0x0C4A, 0x0C4D, 0}, {0x0C55, 0x0C56, 0}, {0x0C62, 0x0C63, 0}, {0x0C81, 0x0C81, 0},
+    {0x0CBC, 0x0CBC, 0}, {0x0CBF, 0x0CBF, 0}, {0x0CC6, 0x0CC6, 0}, {0x0CCC, 0x0CCD, 0},
+    {0x0CE2, 0x0CE3, 0}, {0x0D00, 0x0D01, 0}, {0x0D3B, 0x0D3C, 0}, {0x0D41, 0x0D44, 0},
+    {0x0D4D, 0x0D4D, 0}, {0x0D62, 0x0D63, 0}, {0x0D81, 0x0D81, 0}, {0x0DCA, 0x0DCA, 0},
+    {0x0DD2, 0x0DD4, 0}, {0x0DD6, 0x0DD6, 0}, {0x0E31, 0x0E31, 0}, {0x0E34, 0x0E3A, 0},
+    {0x0E47, 0x0E4E, 0}, {0x0EB1, 0x0EB1, 0}, {0x0EB4, 0x0EBC, 0}, {0x0EC8, 0x0ECD, 0},
+    {0x0F18, 0x0F19, 0}, {0x0F35, 0x0F35, 0}, {0x0F37, 0x0F37, 0}, {0x0F39, 0x0F39, 0},
+    {0x0F71, 0x0F7E, 0}, {0x0F80, 0x0F84, 0}, {0x0F86, 0x0F87, 0}, {0x0F8D, 0x0F97, 0},
+    {0x0F99, 0x0FBC, 0}, {0x0FC6, 0x0FC6, 0}, {0x102D, 0x1030, 0}, {0x1032, 0x1037, 0},
+    {0x1039, 0x103A, 0}, {0x103D, 0x103E, 0}, {0x1058, 0x1059, 0}, {0x105E, 0x1060, 0},
+    {0x1071, 0x1074, 0}, {0x1082, 0x1082, 0}, {0x1085, 0x1086, 0}, {0x108D, 0x108D, 0},
+    {0x109D, 0x109D, 0}, {0x1100, 0x115F, 2}, {0x1160, 0x11FF, 0}, {0x135D, 0x135F, 0},
+    {0x1712, 0x1714, 0}, {0x1732, 0x1733, 0}, {0x1752, 0x1753, 0}, {0x1772, 0x1773, 0},
+    {0x17B4, 0x17B5, 0}, {0x17B7, 0x17BD, 0}, {0x17C6, 0x17C6, 0}, {0x17C9, 0x17D3, 0},
+    {0x17DD, 0x17DD, 0}, {0x180B, 0x180F, 0}, {0x1885, 0x1886, 0}, {0x18A9, 0x18A9, 0},
+    {0x1920, 0x1922, 0}, {0x1927, 0x1928, 0}, {0x1932, 0x1932, 0}, {0x1939, 0x193B, 0},
+    {0x1A17, 0x1A18, 0}, {0x1A1B, 0x1A1B, 0}, {0x1A56, 0x1A56, 0}, {0x1A58, 0x1A5E, 0},
+    {0x1A60, 0x1A60, 0}, {0x1A62, 0x1A62, 0}, {0x1A65, 0x1A6C, 0}, {0x1A73, 0x1A7C, 0},
+    {0x1A7F, 0x1A7F, 0}, {0x1AB0, 0x1ACE, 0}, {0x1B00, 0x1B03, 0}, {0x1B34, 0x1B34, 0},
+    {0x1B36, 0x1B3A, 0}, {0x1B3C, 0x1B3C, 0}, {0x1B42, 0x1B42, 0}, {0x1B6B, 0x1B73, 0},
+    {0x1B80, 0x1B81, 0}, {0x1BA2, 0x1BA5, 0}, {0x1BA8, 0x1BA9, 0}, {0x1BAB, 0x1BAD, 0},
+    {0x1BE6, 0x1BE6, 0}, {0x1BE8, 0x1BE9, 0}, {0x1BED, 0x1BED, 0}, {0x1BEF, 0x1BF1, 0},
+    {0x1C2C, 0x1C33, 0}, {0x1C36, 0x1C37, 0}, {0x1CD0, 0x1CD2, 0}, {0x1CD4, 0x1CE0, 0},
+    {0x1CE2, 0x1CE8, 0}, {0x1CED, 0x1CED, 0}, {0x1CF4, 0x1CF4, 0}, {0x1CF8, 0x1CF9, 0},
+    {0x1DC0, 0x1DFF, 0}, {0x200B, 0x200F, 0}, {0x202A, 0x202E, 0}, {0x2060, 0x2064, 0},
+    {0x2066, 0x206F, 0}, {0x20D0, 0x20F0, 0}, {0x231A, 0x231B, 2}, {0x2329, 0x232A, 2},
+    {0x23E9, 0x23EC, 2}, {0x23F0, 0x23F0, 2}, {0x23F3, 0x23F3, 2}, {0x25FD, 0x25FE, 2},
+    {0x2614, 0x2615, 2}, {0x2648, 0x2653, 2}, {0x267F, 0x267F, 2}, {0x2693, 0x2693, 2},
+    {0x26A1, 0x26A1, 2}, {0x26AA, 0x26AB, 2}, {0x26BD, 0x26BE, 2}, {0x26C4, 0x26C5, 2},
+    {0x26CE, 0x26CE, 2}, {0x26D4, 0x26D4, 2}, {0x26EA, 0x26EA, 2}, {0x26F2, 0x26F3, 2},
+    {0x26F5, 0x26F5, 2}, {0x26FA, 0x26FA, 2}, {0x26FD, 0x26FD, 2}, {0x2705, 0x2705, 2},
+    {0x270A, 0x270B, 2}, {0x2728, 0x2728, 2}, {0x274C, 0x274C, 2}, {0x274E, 0x274E, 2},
+    {0x2753, 0x2755, 2}, {0x2757, 0x2757, 2}, {0x2795, 0x2797, 2}, {0x27B0, 0x27B0, 2},
+    {0x27BF, 0x27BF, 2}, {0x2B1B, 0x2B1C, 2}, {0x2B50, 0x2B50, 2}, {0x2B55, 0x2B55, 2},
+    {0x2CEF, 0x2CF1, 0}, {0x2D7F, 0x2D7F, 0}, {0x2DE0, 0x2DFF, 0}, {0x2E80, 0x2E99, 2},
+    {0x2E9B, 0x2EF3, 2}, {0x2F00, 0x2FD5, 2}, {0x2FF0, 0x2FFB, 2}, {0x3000, 0x3029, 2},
+    {0x302A, 0x302D, 0}, {0x302E, 0x303E, 2}, {0x3041, 0x3096, 2}, {0x3099, 0x309A, 0},
+    {0x309B, 0x30FF, 2}, {0x3105, 0x312F, 2}, {0x3131, 0x318E, 2}, {0x3190, 0x31E3, 2},
+    {0x31F0, 0x321E, 2}, {0x3220, 0x3247, 2}, {0x3250, 0x4DBF, 2}, {0x4E00, 0xA48C, 2},
+    {0xA490, 0xA4C6, 2}, {0xA66F, 0xA672, 0}, {0xA674, 0xA67D, 0}, {0xA69E, 0xA69F, 0},
+    {0xA6F0, 0xA6F1, 0}, {0xA802, 0xA802, 0}, {0xA806, 0xA806, 0}, {0xA80B, 0xA80B, 0},
+    {0xA825, 0xA826, 0}, {0xA82C, 0xA82C, 0}, {0xA8C4, 0xA8C5, 0}, {0xA8E0, 0xA8F1, 0},
+    {0xA8FF, 0xA8FF, 0}, {0xA926, 0xA92D, 0}, {0xA947, 0xA951, 0}, {0xA960, 0xA97C, 2},
+    {0xA980, 0xA982, 0}, {0xA9B3, 0xA9B3, 0}, {0xA9B6, 0xA9B9, 0}, {0xA9BC, 0xA9BD, 0},
+    {0xA9E5, 0xA9E5, 0}, {0xAA29, 0xAA2E, 0}, {0xAA31, 0xAA32, 0}, {0xAA35, 0xAA36, 0},
+    {0xAA43, 0xAA43, 0}, {0xAA4C, 0xAA4C, 0}, {0xAA7C, 0xAA7C, 0}, {0xAAB0, 0xAAB0, 0},
+    {0xAAB2, 0xAAB4, 0}, {0xAAB7, 0xAAB8, 0}, {0xAABE, 0xAABF, 0}, {0xAAC1, 0xAAC1, 0},
+    {0xAAEC, 0xAAED, 0}, {0xAAF6, 0xAAF6, 0}, {0xABE5, 0xABE5, 0}, {0xABE8, 0xABE8, 0},
+    {0xABED, 0xABED, 0}, {0xAC00, 0xD7A3, 2}, {0xF900, 0xFAFF, 2}, {0xFB1E, 0xFB1E, 0},
+    {0xFE00, 0xFE0F, 0}, {0xFE10, 0xFE19, 2}, {0xFE20, 0xFE2F, 0}, {0xFE30, 0xFE52, 2},
+    {0xFE54, 0xFE66, 2}, {0xFE68, 0xFE6B, 2}, {0xFEFF, 0xFEFF, 0}, {0xFF01, 0xFF60, 2},
+    {0xFFE0, 0xFFE6, 2}, {0xFFF9, 0xFFFB, 0}, {0x101FD, 0x101FD, 0}, {0x102E0, 0x102E0, 0},
+    {0x10376, 0x1037A, 0}, {0x10A01, 0x10A03, 0}, {0x10A05, 0x10A06, 0}, {0x10A0C, 0x10A0F, 0},
+    {0x10A38, 0x10A3A, 0}, {0x10A3F, 0x10A3F, 0}, {0x10AE5, 0x10AE6, 0}, {0x10D24, 0x10D27, 0},
+    {0x10EAB, 0x10EAC, 0}, {0x10F46, 0x10F50, 0}, {0x10F82, 0x10F85, 0}, {0x11001, 0x11001, 0},
+    {0x11038, 0x11046, 0}, {0x11070, 0x11070, 0}, {0x11073, 0x11074, 0}, {0x1107F, 0x11081, 0},
+    {0x110B3, 0x110B6, 0}, {0x110B9, 0x110BA, 0}, {0x110BD, 0x110BD, 0}, {0x110C2, 0x110C2, 0},
+    {0x110CD, 0x110CD, 0}, {0x11100, 0x11102, 0}, {0x11127, 0x1112B, 0}, {0x1112D, 0x11134, 0},
+    {0x11173, 0x11173, 0}, {0x11180, 0x11181, 0}, {0x111B6, 0x111BE, 0}, {0x111C9, 0x111CC, 0},
+    {0x111CF, 0x111CF, 0}, {0x1122F, 0x11231, 0}, {0x11234, 0x11234, 0}, {0x11236, 0x11237, 0},
+    {0x1123E, 0x1123E, 0}, {0x112DF, 0x112DF, 0}, {0x112E3, 0x112EA, 0}, {0x11300, 0x11301, 0},
+    {0x1133B, 0x1133C, 0}, {0x11340, 0x11340, 0}, {0x11366, 0x1136C, 0}, {0x11370, 0x11374, 0},
+    {0x11438, 0x1143F, 0}, {0x11442, 0x11444, 0}, {0x11446, 0x11446, 0}, {0x1145E, 0x1145E, 0},
+    {0x114B3, 0x114B8, 0}, {0x114BA, 0x114BA, 0}, {0x114BF, 0x114C0, 0}, {0x114C2, 0x114C3, 0},
+    {0x115B2, 0x115B5, 0}, {0x115BC, 0x115BD, 0}, {0x115BF, 0x115C0, 0}, {0x115DC, 0x115DD, 0},
+    {0x11633, 0x1163A, 0}, {0x1163D, 0x1163D, 0}, {0x1163F, 0x11640, 0}, {0x116AB, 0x116AB, 0},
+    {0x116AD, 0x116AD, 0}, {0x116B0, 0x116B5, 0}, {0x116B7, 0x116B7, 0}, {0x1171D, 0x1171F, 0},
+    {0x11722, 0x11725, 0}, {0x11727, 0x1172B, 0}, {0x1182F, 0x11837, 0}, {0x11839, 0x1183A, 0},
+    {0x1193B, 0x1193C, 0}, {0x1193E, 0x1193E, 0}, {0x11943, 0x11943, 0}, {0x119D4, 0x119D7, 0},
+    {0x119DA, 0x119DB, 0}, {0x119E0, 0x119E0, 0}, {0x11A01, 0x11A0A, 0}, {0x11A33, 0x11A38, 0},
+    {0x11A3B, 0x11A3E, 0}, {0x11A47, 0x11A47, 0}, {0x11A51, 0x11A56, 0}, {0x11A59, 0x11A5B, 0},
+    {0x11A8A, 0x11A96, 0}, {0x11A98, 0x11A99, 0}, {0x11C30, 0x11C36, 0}, {0x11C38, 0x11C3D, 0},
+    {0x11C3F, 0x11C3F, 0}, {0x11C92, 0x11CA7, 0}, {0x11CAA, 0x11CB0, 0}, {0x11CB2, 0x11CB3, 0},
+    {0x11CB5, 0x11CB6, 0}, {0x11D31, 0x11D36, 0}, {0x11D3A, 0x11D3A, 0}, {0x11D3C, 0x11D3D, 0},
+    {0x11D3F, 0x11D45, 0}, {0x11D47, 0x11D47, 0}, {0x11D90, 0x11D91, 0}, {0x11D95, 0x11D95, 0},
+    {0x11D97, 0x11D97, 0}, {0x11EF3, 0x11EF4, 0}, {0x13430, 0x13438, 0}, {0x16AF0, 0x16AF4, 0},
+    {0x16B30, 0x16B36, 0}, {0x16F4F, 0x16F4F, 0}, {0x16F8F, 0x16F92, 0}, {0x16FE0, 0x16FE3, 2},
+    {0x16FE4, 0x16FE4, 0}, {0x16FF0, 0x16FF1, 2}, {0x17000, 0x187F7, 2}, {0x18800, 0x18CD5, 2},
+    {0x18D00, 0x18D08, 2}, {0x1AFF0, 0x1AFF3, 2}, {0x1AFF5, 0x1AFFB, 2}, {0x1AFFD, 0x1AFFE, 2},
+    {0x1B000, 0x1B122, 2}, {0x1B150, 0x1B152, 2}, {0x1B164, 0x1B167, 2}, {0x1B170, 0x1B2FB, 2},
+    {0x1BC9D, 0x1BC9E, 0}, {0x1BCA0, 0x1BCA3, 0}, {0x1CF00, 0x1CF2D, 0}, {0x1CF30, 0x1CF46, 0},
+    {0x1D167, 0x1D169, 0}, {0x1D173, 0x1D182, 0}, {0x1D185, 0x1D18B, 0}, {0x1D1AA, 0x1D1AD, 0},
+    {0x1D242, 0x1D244, 0}, {0x1DA00, 0x1DA36, 0}, {0x1DA3B, 0x1DA6C, 0}, {0x1DA75, 0x1DA75, 0},
+    {0x1DA84, 0x1DA84, 0}, {0x1DA9B, 0x1DA9F, 0}, {0x1DAA1, 0x1DAAF, 0}, {0x1E000, 0x1E006, 0},
+    {0x1E008, 0x1E018, 0}, {0x1E01B, 0x1E021, 0}, {0x1E023, 0x1E024, 0}, {0x1E026, 0x1E02A, 0},
+    {0x1E130, 0x1E136, 0}, {0x1E2AE, 0x1E2AE, 0}, {0x1E2EC, 0x1E2EF, 0}, {0x1E8D0, 0x1E8D6, 0},
+    {0x1E944, 0x1E94A, 0}, {0x1F004, 0x1F004, 2}, {0x1F0CF, 0x1F0CF, 2}, {0x1F18E, 0x1F18E, 2},
+    {0x1F191, 0x1F19A, 2}, {0x1F200, 0x1F202, 2}, {0x1F210, 0x1F23B, 2}, {0x1F240, 0x1F248, 2},
+    {0x1F250, 0x1F251, 2}, {0x1F260, 0x1F265, 2}, {0x1F300, 0x1F320, 2}, {0x1F32D, 0x1F335, 2},
+    {0x1F337, 0x1F37C, 2}, {0x1F37E, 0x1F393, 2}, {0x1F3A0, 0x1F3CA, 2}, {0x1F3CF, 0x1F3D3, 2},
+    {0x1F3E0, 0x1F3F0, 2}, {0x1F3F4, 0x1F3F4, 2}, {0x1F3F8, 0x1F43E, 2}, {0x1F440, 0x1F440, 2},
+    {0x1F442, 0x1F4FC, 2}, {0x1F4FF, 0x1F53D, 2}, {0x1F54B, 0x1F54E, 2}, {0x1F550, 0x1F567, 2},
+    {0x1F57A, 0x1F57A, 2}, {0x1F595, 0x1F596, 2}, {0x1F5A4, 0x1F5A4, 2}, {0x1F5FB, 0x1F64F, 2},
+    {0x1F680, 0x1F6C5, 2}, {0x1F6CC, 0x1F6CC, 2}, {0x1F6D0, 0x1F6D2, 2}, {0x1F6D5, 0x1F6D7, 2},
+    {0x1F6DD, 0x1F6DF, 2}, {0x1F6EB, 0x1F6EC, 2}, {0x1F6F4, 0x1F6FC, 2}, {0x1F7E0, 0x1F7EB, 2},
+    {0x1F7F0, 0x1F7F0, 2}, {0x1F90C, 0x1F93A, 2}, {0x1F93C, 0x1F945, 2}, {0x1F947, 0x1F9FF, 2},
+    {0x1FA70, 0x1FA74, 2}, {0x1FA78, 0x1FA7C, 2}, {0x1FA80, 0x1FA86, 2}, {0x1FA90, 0x1FAAC, 2},
+    {0x1FAB0, 0x1FABA, 2}, {0x1FAC0, 0x1FAC5, 2}, {0x1FAD0, 0x1FAD9, 2}, {0x1FAE0, 0x1FAE7, 2},
+    {0x1FAF0, 0x1FAF6, 2}, {0x20000, 0x2FFFD, 2}, {0x30000, 0x3FFFD, 2}, {0xE0001, 0xE0001, 0},
+    {0xE0020, 0xE007F, 0}, {0xE0100, 0xE01EF, 0}
+};
+
+// Two-level lookup built from WIDTH_RANGES at compile time: the code point's
+// high bits pick a 256-entry block, whose two-bit widths are packed sixteen
+// to a word. Uniform blocks (all width 1, such as most of the BMP, or all
+// width 2, such as the ideographs) are shared, so the whole table is a few
+// kilobytes.
+constexpr size_t WIDTH_BLOCK_BITS = 8;
+constexpr size_t WIDTH_BLOCK_COUNT = 0x110000 >> WIDTH_BLOCK_BITS;
+constexpr uint32_t WIDTH_WORD[] = {0x00000000, 0x55555555, 0xAAAAAAAA};  // all 0, 1, 2
+
+struct WidthBlock {
+  uint32_t words[16];
+};
+
+constexpr WidthBlock makeWidthBlock(size_t block, size_t& range) {
+  WidthBlock result{};
+  for (uint32_t& word : result.words) {
+    word = WIDTH_WORD[1];
   }
-  while (fgets(buffer.data(), buffer.size(), pipe.get()) != nullptr) {
-    result += buffer.data();
+  const char32_t first = static_cast<char32_t>(block << WIDTH_BLOCK_BITS);
+  const char32_t last = first + 255;
+  constexpr size_t ranges = sizeof(WIDTH_RANGES) / sizeof(WIDTH_RANGES[0]);
+  while (range < ranges && WIDTH_RANGES[range].last < first) {
+    ++range;
   }
-  if (!result.empty() && result.back() == '\n') {
-    result.pop_back();
+  for (size_t r = range; r < ranges && WIDTH_RANGES[r].first <= last; ++r) {
+    size_t k = WIDTH_RANGES[r].first > first ? WIDTH_RANGES[r].first - first : 0;
+    const size_t end = (WIDTH_RANGES[r].last < last ? WIDTH_RANGES[r].last : last) - first + 1;
+    const uint32_t width = WIDTH_RANGES[r].width;
+    while (k < end) {
+      if (k % 16 == 0 && k + 16 <= end) {
+        result.words[k / 16] = WIDTH_WORD[width];  // whole word at once
+        k += 16;
+      } else {
+        const unsigned shift = static_cast<unsigned>(k % 16) * 2;
+        result.words[k / 16] = (result.words[k / 16] & ~(3u << shift)) | (width << shift);
+        ++k;
+      }
+    }
   }
   return result;
 }
 
+// Width shared by every entry of a uniform block, or -1
+constexpr int uniformWidthBlock(const WidthBlock& block) {
+  const uint32_t word = block.words[0];
+  for (const uint32_t other : block.words) {
+    if (other != word) {
+      return -1;
+    }
+  }
+  for (int width = 0; width < 3; ++width) {
+    if (word == WIDTH_WORD[width]) {
+      return width;
+    }
+  }
+  return -1;
+}
+
+// The table with room for every possible block, trimmed below once the
+// number of distinct blocks is known
+struct WidthTableBuilder {
+  uint8_t index[WIDTH_BLOCK_COUNT];
+  WidthBlock blocks[256];
+  size_t count;
+};
+
+constexpr WidthTableBuilder buildWidthTable() {
+  WidthTableBuilder table{};
+  for (int width = 0; width < 3; ++width) {
+    for (uint32_t& word : table.blocks[width].words) {
+      word = WIDTH_WORD[width];
+    }
+  }
+  table.count = 3;
+  size_t range = 0;
+  for (size_t block = 0; block < WIDTH_BLOCK_COUNT; ++block) {
+    const WidthBlock widths = makeWidthBlock(block, range);
+    const int uniform = uniformWidthBlock(widths);
+    if (uniform >= 0) {
+      table.index[block] = static_cast<uint8_t>(uniform);
+    } else {
+      table.blocks[table.count] = widths;  // past 256 fails to compile
+      table.index[block] = static_cast<uint8_t>(table.count++);
+    }
+  }
+  return table;
+}
+
+constexpr WidthTableBuilder WIDTH_TABLE_FULL = buildWidthTable();
+
+struct WidthTable {
+  uint8_t index[WIDTH_BLOCK_COUNT];
+  WidthBlock blocks[WIDTH_TABLE_FULL.count];
+};
+
+constexpr WidthTable trimWidthTable() {
+  WidthTable table{};
+  for (size_t block = 0; block < WIDTH_BLOCK_COUNT; ++block) {
+    table.index[block] = WIDTH_TABLE_FULL.index[block];
+  }
+  for (size_t block = 0; block < WIDTH_TABLE_FULL.count; ++block) {
+    table.blocks[block] = WIDTH_TABLE_FULL.blocks[block];
+  }
+  return table;
+}
+
+constexpr WidthTable WIDTH_TABLE = trimWidthTable();
+
+inline unsigned codePointWidth(char32_t cp) {
+  if (cp >= 0x110000) {
+    return 1;
+  }
+  const WidthBlock& block = WIDTH_TABLE.blocks[WIDTH_TABLE.index[cp >> WIDTH_BLOCK_BITS]];
+  const unsigned k = cp & 0xFF;
+  return (block.words[k / 16] >> ((k % 16) * 2)) & 3;
+}
+
 inline std::string toLower(const std::string& str) {
   std::string result = str;
   std::transform(result.begin(), result.end(), result.begin(), ::tolower);
   return result;
 }
 
-inline size_t getDisplayWidth(const std::string& str) {
-  size_t width = 0;
-  for (size_t i = 0; i < str.length(); ) {
-    unsigned char c = static_cast<unsigned char>(str[i]);
-    if (c == 0x1B) {
-      size_t j = i + 1;
-      if (j < str.length() && str[j] == '[') {
-        j++;
-        while (j < str.length()) {
-          unsigned char ch = static_cast<unsigned char>(str[j]);
-          if (ch >= 0x40 && ch <= 0x7E) {
-            i = j + 1;
-            break;
-          }
-          if (ch < 0x20 || ch > 0x3F) {
-            break;
-          }
-          j++;
-        }
-        if (j >= str.length()) {
-          i = str.length();
-        }
-        continue;
+// Length of the run of plain ASCII (no ESC, no UTF-8 bytes) at the start of
+// str, checked a whole vector at a time and byte by byte after the last one
+inline size_t plainASCIIPrefix(const char* str, size_t len) {
+  size_t i = 0;
+#if defined(__AVX2__)
+  const __m256i esc = _mm256_set1_epi8(0x1B);
+  for (; i + 32 <= len; i += 32) {
+    const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(str + i));
+    const uint32_t special = static_cast<uint32_t>(
+        _mm256_movemask_epi8(_mm256_or_si256(v, _mm256_cmpeq_epi8(v, esc))));
+    if (special != 0) {
+      return i + static_cast<size_t>(__builtin_ctz(special));
+    }
+  }
+#endif
+#if defined(__SSE2__)
+  const __m128i esc16 = _mm_set1_epi8(0x1B);
+  for (; i + 16 <= len; i += 16) {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i));
+    const uint32_t special =
+        static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(v, _mm_cmpeq_epi8(v, esc16))));
+    if (special != 0) {
+      return i + static_cast<size_t>(__builtin_ctz(special));
+    }
+  }
+#elif defined(__aarch64__)
+  const uint8x16_t esc = vdupq_n_u8(0x1B);
+  const uint8x16_t high = vdupq_n_u8(0x80);
+  for (; i + 16 <= len; i += 16) {
+    const uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t*>(str + i));
+    const uint8x16_t special = vorrq_u8(vcgeq_u8(v, high), vceqq_u8(v, esc));
+    if (vmaxvq_u8(special) != 0) {
+      // Narrowing shift packs one nibble per byte into a 64-bit mask
+      const uint64_t mask = vget_lane_u64(
+          vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(special), 4)), 0);
+      return i + static_cast<size_t>(__builtin_ctzll(mask) / 4);
+    }
+  }
+#endif
+  while (i < len && static_cast<unsigned char>(str[i]) < 0x80 && str[i] != 0x1B) {
+    ++i;
+  }
+  return i;
+}
+
+// Width of the token starting at str[i], advancing i past it: an ANSI CSI
+// sequence (zero width), an ASCII character, or one UTF-8 sequence (width
+// from WIDTH_TABLE)
+inline size_t displayTokenWidth(const char* str, size_t len, size_t& i) {
+  const unsigned char c = static_cast<unsigned char>(str[i]);
+  if (c == 0x1B) {
+    size_t j = i + 1;
+    if (j < len && str[j] == '[') {
+      j++;
+      while (j < len && static_cast<unsigned char>(str[j]) >= 0x20 &&
+             static_cast<unsigned char>(str[j]) <= 0x3F) {
+        j++;  // parameter and intermediate bytes
       }
-      width += 1;
-      i += 1;
-    } else if ((c & 0x80) == 0) {
-      width += 1;
-      i += 1;
-    } else if ((c & 0xE0) == 0xC0) {
-      if (i + 1 < str.length()) {
-        unsigned char c1 = static_cast<unsigned char>(str[i + 1]);
-        if ((c == 0xC2 && c1 >= 0xA1 && c1 <= 0xAF) || (c == 0xC3 && c1 >= 0x80 && c1 <= 0xBF)) {
-          width += 1;
-        } else {
-          width += 2;
+      if (j < len) {
+        const unsigned char ch = static_cast<unsigned char>(str[j]);
+        if (ch >= 0x40 && ch <= 0x7E) {
+          j++;  // final byte
         }
-      } else {
-        width += 2;
-      }
-      i += 2;
-    } else if ((c & 0xF0) == 0xE0) {
-      width += 1;
-      i += 3;
-    } else if ((c & 0xF8) == 0xF0) {
-      width += 2;
-      i += 4;
+        // otherwise malformed: the terminal drops what it has read so far
+      }
+      i = j;
+      return 0;
+    }
+    i += 1;
+    return 1;
+  } else if ((c & 0x80) == 0) {
+    i += 1;
+    return 1;
+  }
+
+  // UTF-8: decode the sequence and look the code point up. A malformed or
+  // truncated sequence shows as one replacement character for its valid
+  // prefix, as terminals draw it.
+  size_t extra;
+  char32_t cp;
+  if ((c & 0xE0) == 0xC0) {
+    extra = 1;
+    cp = c & 0x1F;
+  } else if ((c & 0xF0) == 0xE0) {
+    extra = 2;
+    cp = c & 0x0F;
+  } else if ((c & 0xF8) == 0xF0) {
+    extra = 3;
+    cp = c & 0x07;
+  } else {
+    i += 1;
+    return 1;
+  }
+  for (size_t k = 1; k <= extra; ++k) {
+    const unsigned char cont = i + k < len ? static_cast<unsigned char>(str[i + k]) : 0;
+    if ((cont & 0xC0) != 0x80) {
+      i += k;
+      return 1;
+    }
+    cp = (cp << 6) | (cont & 0x3F);
+  }
+  i += extra + 1;
+  return codePointWidth(cp);
+}
+
+// Terminal columns taken by str. Runs of plain ASCII are counted a vector at
+// a time; escape sequences and UTF-8 go through displayTokenWidth.
+inline size_t getDisplayWidth(const std::string& str) {
+  const char* data = str.data();
+  const size_t len = str.size();
+  size_t width = 0;
+  size_t i = 0;
+  while (i < len) {
+    const unsigned char c = static_cast<unsigned char>(data[i]);
+    if (c < 0x80 && c != 0x1B) {
+      const size_t run = plainASCIIPrefix(data + i, len - i);
+      width += run;
+      i += run;
     } else {
-      width += 1;
-      i += 1;
+      width += displayTokenWidth(data, len, i);
     }
   }
   return width;
 }
 
+// Longest prefix of str that fits in columns, never splitting a character or
+// escape sequence
+inline std::string truncateToWidth(const std::string& str, size_t columns) {
+  size_t width = 0;
+  size_t i = 0;
+  while (i < str.size()) {
+    size_t next = i;
+    const size_t token = displayTokenWidth(str.data(), str.size(), next);
+    if (width + token > columns) {
+      break;
+    }
+    width += token;
+    i = next;
+  }
+  return str.substr(0, i);
+}
+
 inline size_t maxLength(const std::vector<std::string> &strings) {
   size_t max_len = MIN_DATA_LEN;
   for (const auto &str : strings) {
@@ -172,225 +539,783 @@ inline size_t maxLength(const std::vector<std::string> &strings) {
 
 inline std::string formatBytes(uint64_t bytes) {
   const double gb = static_cast<double>(bytes) / (1024.0 * 1024.0 * 1024.0);
-  std::stringstream ss;
-  ss << static_cast<int>(gb + 0.5);
-  return ss.str();
+  return std::to_string(static_cast<int>(gb + 0.5));
+}
+
+// "1.2 mb", "310 kb", "0 b" in decimal units, as network tools count
+inline std::string formatTraffic(double bytes, const char* suffix = "") {
+  static constexpr const char* UNITS[] = {"b", "kb", "mb", "gb", "tb"};
+  size_t unit = 0;
+  while (bytes >= 1000.0 && unit + 1 < sizeof(UNITS) / sizeof(UNITS[0])) {
+    bytes /= 1000.0;
+    ++unit;
+  }
+  char buf[32];
+  snprintf(buf, sizeof(buf), bytes < 10.0 && unit > 0 ? "%.1f %s%s" : "%.0f %s%s", bytes,
+           UNITS[unit], suffix);
+  return buf;
 }
 
 inline std::string formatGiB(uint64_t bytes) {
   const double gib = static_cast<double>(bytes) / (1024.0 * 1024.0 * 1024.0);
-  std::stringstream ss;
-  ss << static_cast<int>(gib + 0.5);
-  return ss.str();
+  return std::to_string(static_cast<int>(gib + 0.5));
 }
 
-// Gradient bar graph with blocks, cute dim
-inline std::string drawBarGraph(double percent, int width) {
-  const int num_blocks = static_cast<int>((percent / 100.0) * width);
-  std::string graph;
-  graph.reserve(width * 8);
+// "312 mib", "1.4 gib" in binary units, as memory is counted
+inline std::string formatMemory(uint64_t bytes) {
+  static constexpr const char* UNITS[] = {"b", "kib", "mib", "gib", "tib"};
+  double value = static_cast<double>(bytes);
+  size_t unit = 0;
+  while (value >= 1024.0 && unit + 1 < sizeof(UNITS) / sizeof(UNITS[0])) {
+    value /= 1024.0;
+    ++unit;
+  }
+  char buf[32];
+  snprintf(buf, sizeof(buf), value < 10.0 && unit > 0 ? "%.1f %s" : "%.0f %s", value, UNITS[unit]);
+  return buf;
+}
+
+// How bar graphs are drawn: the percentages where the colour turns from
+// green to yellow and from yellow to pink, and whether the last filled cell
+// shows the remainder in eighths
+struct BarStyle {
+  double warn = 50.0;
+  double critical = 75.0;
+  bool eighths = false;
+};
+
+// Settings of the pretty renderer
+struct RenderOptions {
+  BarStyle bars;
+  size_t interface_rows = 3;  // busiest interfaces shown, 0 hides the section
+  size_t io_device_rows = 2;  // busiest block devices shown, 0 hides them
+};
+
+// Strips of MAX_DATA_LEN cells of one 3-byte glyph, so a bar segment of any
+// width is a single copy from the front of a strip
+struct GlyphStrip {
+  char bytes[MAX_DATA_LEN * 3];
+};
+
+constexpr GlyphStrip makeGlyphStrip(const char (&glyph)[4]) {
+  GlyphStrip strip{};
+  for (int i = 0; i < MAX_DATA_LEN; ++i) {
+    strip.bytes[i * 3] = glyph[0];
+    strip.bytes[i * 3 + 1] = glyph[1];
+    strip.bytes[i * 3 + 2] = glyph[2];
+  }
+  return strip;
+}
+
+constexpr GlyphStrip BAR_FILLED = makeGlyphStrip("▰");
+constexpr GlyphStrip BAR_EMPTY = makeGlyphStrip("▱");
+constexpr GlyphStrip BAR_FULL_BLOCK = makeGlyphStrip("█");
+constexpr GlyphStrip BAR_SHADE = makeGlyphStrip("░");
+
+// Left one to seven eighths of a cell
+constexpr const char* BAR_EIGHTHS[] = {"", "▏", "▎", "▍", "▌", "▋", "▊", "▉"};
+
+// Gradient bar graph with blocks, cute dim. Percentages outside 0-100 are
+// clamped so an overloaded machine fills the bar instead of overflowing it.
+inline std::string drawBarGraph(double percent, int width, const BarStyle& style = BarStyle()) {
+  width = std::max(0, std::min(width, MAX_DATA_LEN));
+  const double clamped = percent > 0.0 ? std::min(percent, 100.0) : 0.0;
+  const int eighths = style.eighths ? static_cast<int>(clamped / 100.0 * width * 8) : 0;
+  const int filled = style.eighths ? eighths / 8 : static_cast<int>(clamped / 100.0 * width);
+  const int partial = style.eighths && filled < width ? eighths % 8 : 0;
+  const int empty = width - filled - (partial > 0 ? 1 : 0);
+
   const char* bar_color;
-  if (percent < 50) {
+  if (percent < style.warn) {
     bar_color = GREEN;
-  } else if (percent < 75) {
+  } else if (percent < style.critical) {
     bar_color = YELLOW;
   } else {
     bar_color = PINK;
   }
-  graph += bar_color;
-  for (int i = 0; i < num_blocks; ++i)
-    graph += "▰";
-  graph += RESET;
-  graph += "\033[2m";
-  for (int i = num_blocks; i < width; ++i)
-    graph += "▱";
-  graph += RESET;
+  const GlyphStrip& filled_strip = style.eighths ? BAR_FULL_BLOCK : BAR_FILLED;
+  const GlyphStrip& empty_strip = style.eighths ? BAR_SHADE : BAR_EMPTY;
+
+  // A segment with no cells gets no escapes either
+  std::string graph;
+  graph.reserve(width * 3 + 24);
+  if (filled > 0 || partial > 0) {
+    graph += bar_color;
+    graph.append(filled_strip.bytes, filled * 3);
+    graph += BAR_EIGHTHS[partial];
+    graph += RESET;
+  }
+  if (empty > 0) {
+    graph += "\033[2m";
+    graph.append(empty_strip.bytes, empty * 3);
+    graph += RESET;
+  }
+  return graph;
+}
+
+struct BarSegment {
+  double percent;
+  const char* color;
+};
+
+// Segments side by side in their own colours, then the rest of the width
+// empty. Each boundary is rounded from the running total, so the cells add
+// up to the width however the segments round.
+inline std::string drawStackedBar(const BarSegment* segments, size_t count, int width,
+                                  const BarStyle& style = BarStyle()) {
+  width = std::max(0, std::min(width, MAX_DATA_LEN));
+  const GlyphStrip& filled_strip = style.eighths ? BAR_FULL_BLOCK : BAR_FILLED;
+  const GlyphStrip& empty_strip = style.eighths ? BAR_SHADE : BAR_EMPTY;
+  std::string graph;
+  graph.reserve(width * 3 + count * 16 + 16);
+  double total = 0.0;
+  int drawn = 0;
+  for (size_t i = 0; i < count; ++i) {
+    total += std::max(segments[i].percent, 0.0);
+    const int end = static_cast<int>(std::min(total, 100.0) / 100.0 * width + 0.5);
+    if (end > drawn) {
+      graph += segments[i].color;
+      graph.append(filled_strip.bytes, (end - drawn) * 3);
+      drawn = end;
+    }
+  }
+  if (drawn > 0) {
+    graph += RESET;
+  }
+  if (drawn < width) {
+    graph += "\033[2m";
+    graph.append(empty_strip.bytes, (width - drawn) * 3);
+    graph += RESET;
+  }
   return graph;
 }
 
-// Cutified: still efficient
-inline void printHeader(int current_len) {
-  const int length = current_len + MAX_NAME_LEN + BORDERS_AND_PADDING;
-  std::string top = PINK;
-  top += "╭";
-  for (int i = 0; i < length - 2; ++i) {
-    top += "─";
+// One eighth-height block per logical CPU. With more CPUs than cells, each
+// cell shows the average of a consecutive group.
+inline std::string drawCoreGraph(const std::vector<double>& cores, int width) {
+  static constexpr const char* LEVELS[] = {"▁", "▂", "▃", "▄", "▅", "▆", "▇", "█"};
+  const size_t count = cores.size();
+  const size_t cells = std::min(count, static_cast<size_t>(width));
+  std::string graph;
+  graph.reserve(cells * 3);
+  for (size_t cell = 0; cell < cells; ++cell) {
+    const size_t first = cell * count / cells;
+    const size_t last = (cell + 1) * count / cells;
+    double sum = 0.0;
+    for (size_t i = first; i < last; ++i) sum += cores[i];
+    const int level = static_cast<int>(sum / static_cast<double>(last - first) / 100.0 * 8.0);
+    graph += LEVELS[std::max(0, std::min(level, 7))];
   }
-  top += "╮";
-  top += RESET;
-  std::cout << top << '\n';
+  return graph;
 }
 
-inline void printCenteredData(const std::string &text, int current_len, const char* color = CYAN) {
+// Contiguous output buffer. Rows are formatted straight into it and the
+// whole report leaves the process in a single write(2).
+struct RenderBuffer {
+  explicit RenderBuffer(size_t capacity = 16 * 1024) : storage(capacity), size(0) {}
+
+  void reserve(size_t extra) {
+    if (size + extra > storage.size()) {
+      storage.resize(std::max(storage.size() * 2, size + extra));
+    }
+  }
+  void append(const char* str, size_t len) {
+    reserve(len);
+    memcpy(storage.data() + size, str, len);
+    size += len;
+  }
+  void append(const char* str) { append(str, strlen(str)); }
+  void append(const std::string& str) { append(str.data(), str.size()); }
+  void append(char c) {
+    reserve(1);
+    storage[size++] = c;
+  }
+  void appendRepeat(char c, size_t count) {
+    reserve(count);
+    memset(storage.data() + size, c, count);
+    size += count;
+  }
+  void appendInt(long value) {
+    char digits[24];
+    const int len = snprintf(digits, sizeof(digits), "%ld", value);
+    append(digits, static_cast<size_t>(len));
+  }
+  const char* data() const { return storage.data(); }
+  void clear() { size = 0; }
+
+  // Writes everything to fd, retrying short writes
+  bool flush(int fd) const {
+    size_t done = 0;
+    while (done < size) {
+      const ssize_t n = write(fd, storage.data() + done, size - done);
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) return false;
+      done += static_cast<size_t>(n);
+    }
+    return true;
+  }
+
+  std::vector<char> storage;
+  size_t size;
+};
+
+// A rendered report: newline-terminated rows in one buffer plus the offset
+// where each row ends, so watch mode can diff frames row by row.
+struct Frame {
+  void endRow() {
+    buf.append('\n');
+    row_ends.push_back(buf.size);
+  }
+  size_t rows() const { return row_ends.size(); }
+  // Row i without its newline
+  std::string_view row(size_t i) const {
+    const size_t start = i == 0 ? 0 : row_ends[i - 1];
+    return std::string_view(buf.data() + start, row_ends[i] - start - 1);
+  }
+  void clear() {
+    buf.clear();
+    row_ends.clear();
+  }
+
+  RenderBuffer buf;
+  std::vector<size_t> row_ends;
+};
+
+// Streaming JSON writer over a RenderBuffer. Nesting state is a fixed-size
+// array, strings are escaped straight into the buffer and numbers are
+// formatted on the stack, so no field allocates.
+struct JsonWriter {
+  static constexpr int MAX_DEPTH = 16;
+
+  explicit JsonWriter(RenderBuffer& buffer) : out(buffer) {}
+
+  void beginObject(const char* key = nullptr) { open(key, '{'); }
+  void endObject() { close('}'); }
+  void beginArray(const char* key = nullptr) { open(key, '['); }
+  void endArray() { close(']'); }
+
+  // A member of the current object, or an array element when key is null
+  template <typename T>
+  void field(const char* key, const T& value) {
+    separator(key);
+    if constexpr (std::is_same_v<T, bool>) {
+      out.append(value ? "true" : "false");
+    } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+      char digits[24];
+      out.append(digits, static_cast<size_t>(
+                             snprintf(digits, sizeof(digits), "%lld", static_cast<long long>(value))));
+    } else if constexpr (std::is_integral_v<T>) {
+      char digits[24];
+      out.append(digits, static_cast<size_t>(snprintf(digits, sizeof(digits), "%llu",
+                                                      static_cast<unsigned long long>(value))));
+    } else if constexpr (std::is_floating_point_v<T>) {
+      if (value != value || value - value != 0) {
+        out.append("null");  // NaN and infinities have no JSON spelling
+      } else {
+        char digits[32];
+        out.append(digits, static_cast<size_t>(
+                               snprintf(digits, sizeof(digits), "%.6g", static_cast<double>(value))));
+      }
+    } else {
+      string(std::string_view(value));
+    }
+  }
+
+  void null(const char* key) {
+    separator(key);
+    out.append("null");
+  }
+
+ private:
+  void separator(const char* key) {
+    if (depth > 0) {
+      if (has_items[depth - 1]) out.append(',');
+      has_items[depth - 1] = true;
+    }
+    if (key != nullptr) {
+      string(key);
+      out.append(':');
+    }
+  }
+  void open(const char* key, char bracket) {
+    separator(key);
+    out.append(bracket);
+    if (depth < MAX_DEPTH) has_items[depth++] = false;
+  }
+  void close(char bracket) {
+    if (depth > 0) --depth;
+    out.append(bracket);
+  }
+  void string(std::string_view str) {
+    static constexpr char HEX[] = "0123456789abcdef";
+    out.append('"');
+    size_t run = 0;  // unescaped bytes are copied in runs
+    for (size_t i = 0; i < str.size(); ++i) {
+      const unsigned char c = static_cast<unsigned char>(str[i]);
+      if (c >= 0x20 && c != '"' && c != '\\') continue;
+      out.append(str.data() + run, i - run);
+      run = i + 1;
+      if (c == '"' || c == '\\') {
+        out.append('\\');
+        out.append(static_cast<char>(c));
+      } else if (c == '\n') {
+        out.append("\\n");
+      } else if (c == '\t') {
+        out.append("\\t");
+      } else {
+        const char escape[] = {'\\', 'u', '0', '0', HEX[c >> 4], HEX[c & 0xF]};
+        out.append(escape, sizeof(escape));
+      }
+    }
+    out.append(str.data() + run, str.size() - run);
+    out.append('"');
+  }
+
+  RenderBuffer& out;
+  bool has_items[MAX_DEPTH] = {};
+  int depth = 0;
+};
+
+inline void printCenteredData(Frame& frame, const std::string &text, int current_len,
+                              const char* color = CYAN) {
   const int max_len = current_len + MAX_NAME_LEN - BORDERS_AND_PADDING;
   const int total_width = max_len + 12;
-  int padding_left = (total_width - static_cast<int>(getDisplayWidth(text))) / 2;
-  int padding_right = total_width - static_cast<int>(getDisplayWidth(text)) - padding_left;
+  const int text_width = static_cast<int>(getDisplayWidth(text));
+  int padding_left = (total_width - text_width) / 2;
+  int padding_right = total_width - text_width - padding_left;
   if (padding_left < 0) padding_left = 0;
   if (padding_left > 1000) padding_left = 1000;
   if (padding_right < 0) padding_right = 0;
   if (padding_right > 1000) padding_right = 1000;
-  std::cout << PURPLE << "│" << RESET << std::string(padding_left, ' ') 
-            << color << BOLD << text << RESET
-            << std::string(padding_right, ' ') << PURPLE << "│" << RESET << "\n";
+  RenderBuffer& out = frame.buf;
+  out.append(PURPLE);
+  out.append("│");
+  out.append(RESET);
+  out.appendRepeat(' ', padding_left);
+  out.append(color);
+  out.append(BOLD);
+  out.append(text);
+  out.append(RESET);
+  out.appendRepeat(' ', padding_right);
+  out.append(PURPLE);
+  out.append("│");
+  out.append(RESET);
+  frame.endRow();
 }
 
-// Cute dividers
-inline void printDivider(const std::string &side, int current_len) {
-  const char *left_symbol, *right_symbol;
-  const char* color = CYAN;
-
-  if (side == "top") {
-    left_symbol = "├";
-    right_symbol = "┤";
-  } else if (side == "bottom") {
-    left_symbol = "╰";
-    right_symbol = "╯";
-  } else {
-    left_symbol = "├";
-    right_symbol = "┤";
+// Horizontal border lines of the box
+enum class Border : uint8_t { Top, Divider, Bottom, Count };
+
+// Border lines for one report width, colours included, so drawing one is a
+// single copy into the frame
+struct BoxLayout {
+  int current_len = -1;
+  std::string lines[static_cast<size_t>(Border::Count)];
+};
+
+inline std::string buildBorder(const char* color, const char* left, const char* right,
+                               int length) {
+  std::string line;
+  line.reserve(strlen(color) + (length + 2) * 3 + strlen(RESET));
+  line += color;
+  line += left;
+  for (int i = 2; i < length; ++i) line += "─";
+  line += right;
+  line += RESET;
+  return line;
+}
+
+// Layout for current_len, rebuilt only when the width changes between
+// reports
+inline const BoxLayout& boxLayout(int current_len) {
+  static thread_local BoxLayout layout;
+  if (layout.current_len != current_len) {
+    const int length = current_len + MAX_NAME_LEN + BORDERS_AND_PADDING;
+    layout.lines[static_cast<size_t>(Border::Top)] = buildBorder(PINK, "╭", "╮", length);
+    layout.lines[static_cast<size_t>(Border::Divider)] = buildBorder(CYAN, "├", "┤", length);
+    layout.lines[static_cast<size_t>(Border::Bottom)] = buildBorder(CYAN, "╰", "╯", length);
+    layout.current_len = current_len;
   }
+  return layout;
+}
 
-  const int length = current_len + MAX_NAME_LEN + BORDERS_AND_PADDING;
-  std::string divider = color;
-  divider += left_symbol;
-  for (int i = 0; i < length - 2; ++i)
-    divider += "─";
-  divider += right_symbol;
-  divider += RESET;
-  std::cout << divider << '\n';
+// Cute dividers
+inline void printBorder(Frame& frame, const BoxLayout& layout, Border border) {
+  frame.buf.append(layout.lines[static_cast<size_t>(border)]);
+  frame.endRow();
 }
 
-inline void printData(std::string name, std::string data, int current_len,
-                     const char* color = RESET, const char* emoji = "") {
-  if (name.length() > MAX_NAME_LEN) {
-    name = name.substr(0, MAX_NAME_LEN - 3) + "...";
+inline void printData(Frame& frame, const std::string& full_name, const std::string& full_data,
+                      int current_len, const char* color = RESET, const char* emoji = "") {
+  // Over-long names and values are the rare case; only they pay for a copy
+  std::string truncated_name;
+  const std::string* name_ptr = &full_name;
+  if (getDisplayWidth(full_name) > MAX_NAME_LEN) {
+    truncated_name = truncateToWidth(full_name, MAX_NAME_LEN - 3) + "...";
+    name_ptr = &truncated_name;
+  }
+  const std::string& name = *name_ptr;
+
+  const bool is_graph = (full_data.find("█") != std::string::npos ||
+                         full_data.find("░") != std::string::npos ||
+                         full_data.find("▰") != std::string::npos);
+
+  const bool has_emoji = emoji && *emoji;
+  size_t japanese_display_width = has_emoji ? getDisplayWidth(emoji) + 1 : 0;
+
+  // The value shares the data column with its Japanese label, if any
+  const size_t available = static_cast<size_t>(current_len) > japanese_display_width
+      ? current_len - japanese_display_width
+      : 0;
+  std::string truncated_data;
+  const std::string* data_ptr = &full_data;
+  size_t data_display_width = getDisplayWidth(full_data);
+  if (!is_graph && (data_display_width >= MAX_DATA_LEN || data_display_width > available)) {
+    const size_t keep = std::min<size_t>(MAX_DATA_LEN - 4, available > 3 ? available - 3 : 0);
+    truncated_data = truncateToWidth(full_data, keep) + "...";
+    data_ptr = &truncated_data;
+    data_display_width = getDisplayWidth(truncated_data);
   }
-  
-  const bool is_graph = (data.find("█") != std::string::npos ||
-                         data.find("░") != std::string::npos ||
-                         data.find("▰") != std::string::npos);
+  const std::string& data = *data_ptr;
 
   size_t name_display_width = getDisplayWidth(name);
   const size_t label_width = MAX_NAME_LEN;
   size_t name_padding = (name_display_width < label_width) ? (label_width - name_display_width) : 0;
 
-  std::string japanese_str = (emoji && *emoji) ? std::string(emoji) + " " : "";
-  size_t japanese_display_width = (emoji && *emoji) ? getDisplayWidth(japanese_str) : 0;
-  
   const size_t left_border = 2;
   const size_t right_border = 2;
   const size_t colon = 1;
   const size_t spacing = 2;
   size_t total_box_width = current_len + MAX_NAME_LEN + BORDERS_AND_PADDING;
-  size_t fixed_elements_width = left_border + name_display_width + colon + name_padding + spacing + japanese_display_width;
-  size_t target_data_width = total_box_width - fixed_elements_width - right_border;
-  
-  if (is_graph) {
-    size_t graph_display_width = getDisplayWidth(data);
-    size_t data_padding = 0;
-    size_t total_content_width = left_border + name_display_width + colon + name_padding + spacing + 
-                                 japanese_display_width + graph_display_width + right_border;
-    if (total_content_width < total_box_width) {
-      data_padding = total_box_width - total_content_width;
-    }
-    std::cout << PURPLE << "│ " << RESET << color << BOLD << name << RESET << ":"
-              << std::string(name_padding, ' ') << "  " << japanese_str << data
-              << std::string(data_padding, ' ') << PURPLE << " │" << RESET << "\n";
-  } else {
-    size_t data_display_width = getDisplayWidth(data);
-    if (data_display_width >= MAX_DATA_LEN) {
-      data = data.substr(0, MAX_DATA_LEN - 4) + "...";
-      data_display_width = getDisplayWidth(data);
-    }
-    size_t data_padding = 0;
-    size_t total_content_width = left_border + name_display_width + colon + name_padding + spacing + 
-                                 japanese_display_width + data_display_width + right_border;
-    if (total_content_width < total_box_width) {
-      data_padding = total_box_width - total_content_width;
+  size_t data_padding = 0;
+  size_t total_content_width = left_border + name_display_width + colon + name_padding + spacing +
+                               japanese_display_width + data_display_width + right_border;
+  if (total_content_width < total_box_width) {
+    data_padding = total_box_width - total_content_width;
+  }
+
+  RenderBuffer& out = frame.buf;
+  out.append(PURPLE);
+  out.append("│ ");
+  out.append(RESET);
+  out.append(color);
+  out.append(BOLD);
+  out.append(name);
+  out.append(RESET);
+  out.append(':');
+  out.appendRepeat(' ', name_padding + spacing);
+  if (has_emoji) {
+    out.append(emoji);
+    out.append(' ');
+  }
+  out.append(data);
+  out.appendRepeat(' ', data_padding);
+  out.append(PURPLE);
+  out.append(" │");
+  out.append(RESET);
+  frame.endRow();
+}
+
+// Cores of one kind on a hybrid CPU
+struct CoreClass {
+  std::string name;  // "performance", "efficiency"
+  int physical = 0;
+  int logical = 0;
+};
+
+// One kind of cache: every instance has the same size and is shared by the
+// same number of logical CPUs
+struct CacheInfo {
+  int level = 0;
+  char kind = 'u';    // 'd'ata, 'i'nstruction or 'u'nified
+  uint64_t size = 0;  // bytes per instance
+  int shared_by = 1;  // logical CPUs per instance
+  int instances = 0;
+};
+
+struct NumaNode {
+  int id = 0;
+  std::string cpus;  // "0-15,32-47"
+};
+
+// Layout of the CPUs, read once with the rest of the static CPU facts
+struct CPUTopology {
+  std::vector<CoreClass> classes;  // empty unless the cores differ
+  int threads_per_core = 1;
+  std::vector<CacheInfo> caches;   // by level, then data before instruction
+  std::vector<NumaNode> numa;      // empty where the platform has no NUMA
+};
+
+// Adds a cache kind, folding it into an equal one seen on another cluster
+inline void addCache(std::vector<CacheInfo>& caches, const CacheInfo& cache) {
+  for (CacheInfo& known : caches) {
+    if (known.level == cache.level && known.kind == cache.kind && known.size == cache.size &&
+        known.shared_by == cache.shared_by) {
+      known.instances += cache.instances;
+      return;
     }
-    std::cout << PURPLE << "│ " << RESET << color << BOLD << name << RESET << ":"
-              << std::string(name_padding, ' ') << "  " << japanese_str << data
-              << std::string(data_padding, ' ') << PURPLE << " │" << RESET << "\n";
   }
+  caches.push_back(cache);
+  std::sort(caches.begin(), caches.end(), [](const CacheInfo& a, const CacheInfo& b) {
+    return a.level != b.level ? a.level < b.level : a.kind < b.kind;
+  });
 }
 
 struct CPUInfo {
   std::string model;
-  int cores_physical;
-  int cores_logical;
-  int sockets;
-  double load_1;
-  double load_5;
-  double load_15;
+  int cores_physical = 0;
+  int cores_logical = 0;
+  int sockets = 0;
+  CPUTopology topology;
+  double load_1 = 0.0;
+  double load_5 = 0.0;
+  double load_15 = 0.0;
+};
+
+// Cumulative CPU time counters, in clock ticks
+struct CPUTicks {
+  uint64_t user = 0;
+  uint64_t nice = 0;
+  uint64_t system = 0;
+  uint64_t idle = 0;
+  uint64_t iowait = 0;
+  uint64_t irq = 0;
+  uint64_t softirq = 0;
+  uint64_t steal = 0;
 };
 
+struct CPUSample {
+  CPUTicks total;
+  std::vector<CPUTicks> cores;
+};
+
+// Share of CPU time between two samples, in percent
+struct CPUUsage {
+  double busy = 0.0;
+  double user = 0.0;    // user + nice
+  double system = 0.0;  // system + irq + softirq
+  double iowait = 0.0;
+  double steal = 0.0;
+  std::vector<double> cores;  // busy percent per logical CPU
+};
+
+// Physical memory in bytes. used is total minus what the platform counts as
+// available, so percent matches Activity Monitor or free(1). The breakdown
+// fields overlap and need not add up to total.
 struct MemInfo {
-  uint64_t total;
-  uint64_t used;
-  double percent;
+  uint64_t total = 0;
+  uint64_t used = 0;
+  double percent = 0.0;
+  uint64_t available = 0;
+  uint64_t wired = 0;        // cannot be paged out or reclaimed
+  uint64_t active = 0;
+  uint64_t inactive = 0;
+  uint64_t compressed = 0;   // held by the compressor (zswap on Linux)
+  uint64_t purgeable = 0;    // dropped on demand without writing anything
+  uint64_t file_backed = 0;  // page cache of files
+  uint64_t swap_total = 0;
+  uint64_t swap_used = 0;
+  double pressure = -1.0;    // kernel's memory pressure in percent, -1 if it has none
+};
+
+// Pressure Stall Information for one resource: the share of wall time in
+// which some, or all, runnable tasks were stalled waiting for it, averaged
+// by the kernel over 10 s, 60 s and 300 s
+struct StallAverages {
+  bool present = false;
+  double some[3] = {};
+  double full[3] = {};
+};
+
+struct PressureInfo {
+  StallAverages cpu;
+  StallAverages memory;
+  StallAverages io;
+};
+
+// Limits and usage of the cgroup v2 the report runs in, as a container sees
+// them. The root of the hierarchy has no limits and does not count.
+struct CgroupInfo {
+  bool present = false;
+  std::string path;  // relative to the cgroup2 mount
+  double cpu_limit = -1.0;  // cores allowed by cpu.max, -1 when unlimited
+  uint64_t cpu_usage_usec = 0;
+  uint64_t cpu_periods = 0;  // quota periods, and those that ran out of quota
+  uint64_t cpu_throttled_periods = 0;
+  uint64_t cpu_throttled_usec = 0;
+  uint64_t memory_current = 0;
+  uint64_t memory_max = 0;  // 0 when unlimited
+  uint64_t io_read_bytes = 0;  // summed over devices
+  uint64_t io_write_bytes = 0;
+  uint64_t io_read_ops = 0;
+  uint64_t io_write_ops = 0;
+  PressureInfo pressure;  // stalls of the cgroup's own tasks
 };
 
+// One mounted volume
 struct DiskInfo {
-  uint64_t total;
-  uint64_t used;
-  double percent;
+  std::string mount;
+  std::string fstype;
+  uint64_t total = 0;
+  uint64_t used = 0;
+  double percent = 0.0;
+};
+
+// Interfaces beyond this many are left out of the network section
+constexpr size_t MAX_INTERFACES = 128;
+
+// Addresses of one interface: the first IPv4 address and the first IPv6
+// address, global scope preferred over link-local
+struct InterfaceAddress {
+  char name[IFNAMSIZ] = {};
+  char ipv4[INET_ADDRSTRLEN] = {};
+  char ipv6[INET6_ADDRSTRLEN] = {};
+  bool ipv6_global = false;
+  bool loopback = false;
+};
+
+struct NetAddresses {
+  InterfaceAddress interfaces[MAX_INTERFACES];
+  size_t count = 0;
+};
+
+// Traffic counters of one interface since it came up, and the rates since
+// the previous sample (-1 until there is one)
+struct InterfaceCounters {
+  char name[IFNAMSIZ] = {};
+  uint64_t rx_bytes = 0;
+  uint64_t tx_bytes = 0;
+  uint64_t rx_packets = 0;
+  uint64_t tx_packets = 0;
+  uint64_t rx_errors = 0;
+  uint64_t tx_errors = 0;
+  double rx_rate = -1.0;  // bytes per second
+  double tx_rate = -1.0;
+};
+
+// Fixed-size so that sampling, which runs every watch or daemon tick, never
+// touches the heap
+struct NetSample {
+  InterfaceCounters interfaces[MAX_INTERFACES];
+  size_t count = 0;
+  int64_t taken_ns = 0;  // steady clock, 0 before the first sample
+};
+
+// Whole block devices beyond this many are left out of the disk I/O rows
+constexpr size_t MAX_BLOCK_DEVICES = 512;
+
+// I/O counters of one whole block device since boot, and the rates since
+// the previous sample (-1 until there is one). Devices that never did any
+// I/O are not sampled.
+struct BlockDeviceCounters {
+  char name[32] = {};
+  uint64_t reads = 0;  // completed requests
+  uint64_t writes = 0;
+  uint64_t read_bytes = 0;
+  uint64_t write_bytes = 0;
+  uint64_t read_us = 0;  // time requests spent queued and in service
+  uint64_t write_us = 0;
+  uint64_t busy_us = 0;  // time with a request in flight, where known
+  bool busy_known = false;
+  double read_iops = -1.0;
+  double write_iops = -1.0;
+  double read_rate = -1.0;  // bytes per second
+  double write_rate = -1.0;
+  double await_ms = -1.0;  // per request, reads and writes together
+  double utilization = -1.0;  // percent of the interval busy
+};
+
+// Fixed-size like NetSample, so sampling never touches the heap
+struct DiskIOSample {
+  BlockDeviceCounters devices[MAX_BLOCK_DEVICES];
+  size_t count = 0;
+  int64_t taken_ns = 0;  // steady clock, 0 before the first sample
+};
+
+// Counters of one process from a scan of the process table
+struct ProcessSample {
+  int pid;
+  uint64_t start;   // start time, tells a reused pid from its previous owner
+  uint64_t cpu_ns;  // user + system time
+  uint64_t rss;     // bytes
+  char name[16];
+};
+
+// One row of the process section
+struct ProcessInfo {
+  int pid = 0;
+  char name[16] = {};
+  double cpu_percent = -1.0;  // of one core since the previous scan, -1 before there is one
+  uint64_t rss = 0;
+};
+
+struct TopProcesses {
+  size_t wanted = 0;  // rows per list; 0 leaves the process table alone
+  std::vector<ProcessInfo> by_cpu;
+  std::vector<ProcessInfo> by_rss;
+};
+
+// What the machine runs on, as the hypervisor and the firmware identify it
+struct PlatformInfo {
+  std::string hypervisor;  // "kvm", "hyper-v", ...; empty on bare metal
+  std::string cloud;       // "aws", "gcp", ...; empty outside a known cloud
+  std::string instance;    // instance type, where the firmware names it
 };
 
 struct LoginInfo {
+  std::string user;
+  std::string tty;
+  time_t timestamp = 0;
   std::string time;
   std::string ip;
-  bool ip_present;
-  std::string uptime;
+  bool ip_present = false;
 };
 
-inline std::string getOSName() {
-  std::string product_name = execCommand("sw_vers -productName");
-  std::string product_version = execCommand("sw_vers -productVersion");
-  if (!product_name.empty() && !product_version.empty()) {
-    return product_name + " " + product_version;
-  }
+// Vendor signatures of the CPUID hypervisor leaf, as a NUL-padded string
+struct HypervisorSignature {
+  const char* signature;
+  const char* name;
+};
 
-  size_t size = 0;
-  sysctlbyname("kern.ostype", nullptr, &size, nullptr, 0);
-  std::string os_type = "macOS";
-  if (size > 1) {
-    std::vector<char> buffer(size);
-    sysctlbyname("kern.ostype", buffer.data(), &size, nullptr, 0);
-    if (size > 0 && buffer[size - 1] == '\0') {
-      os_type = std::string(buffer.data());
-    }
-  }
+constexpr HypervisorSignature HYPERVISOR_SIGNATURES[] = {
+    {"KVMKVMKVM", "kvm"},          {"Linux KVM Hv", "kvm"},    {"TCGTCGTCGTCG", "qemu"},
+    {"VMwareVMware", "vmware"},    {"Microsoft Hv", "hyper-v"}, {"XenVMMXenVMM", "xen"},
+    {"VBoxVBoxVBox", "virtualbox"}, {" lrpepyh  vr", "parallels"},
+    {"prl hyperv  ", "parallels"}, {"bhyve bhyve ", "bhyve"},  {"ACRNACRNACRN", "acrn"},
+    {"QNXQVMBSQG", "qnx"},         {"EVMMEVMMEVMM", "intel-evmm"},
+};
 
-  size = 0;
-  sysctlbyname("kern.osrelease", nullptr, &size, nullptr, 0);
-  std::string os_release = "";
-  if (size > 1) {
-    std::vector<char> buffer(size);
-    sysctlbyname("kern.osrelease", buffer.data(), &size, nullptr, 0);
-    if (size > 0 && buffer[size - 1] == '\0') {
-      os_release = std::string(buffer.data());
+// Hypervisor named by CPUID leaf 0x40000000, "" on bare metal and off x86.
+// A hypervisor that also offers Hyper-V's interface to Windows guests puts
+// the Hyper-V signature first and its own at 0x40000100.
+inline std::string cpuidHypervisor() {
+#if defined(__x86_64__) || defined(__i386__)
+  unsigned int eax, ebx, ecx, edx;
+  if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) == 0 || (ecx & (1u << 31)) == 0) {
+    return "";
+  }
+  const auto vendor = [](unsigned int leaf) -> const char* {
+    unsigned int regs[4];
+    __cpuid(leaf, regs[0], regs[1], regs[2], regs[3]);
+    char signature[13];
+    memcpy(signature, &regs[1], 4);
+    memcpy(signature + 4, &regs[2], 4);
+    memcpy(signature + 8, &regs[3], 4);
+    signature[12] = '\0';
+    for (const HypervisorSignature& known : HYPERVISOR_SIGNATURES) {
+      if (strcmp(signature, known.signature) == 0) return known.name;
     }
+    return nullptr;
+  };
+  const char* name = vendor(0x40000000);
+  if (name != nullptr && strcmp(name, "hyper-v") == 0) {
+    const char* own = vendor(0x40000100);
+    if (own != nullptr) name = own;
   }
-  return os_type + " " + os_release;
-}
-
-inline std::string getKernelVersion() {
-  size_t size = 0;
-  sysctlbyname("kern.version", nullptr, &size, nullptr, 0);
-  if (size > 1) {
-    std::vector<char> buffer(size);
-    sysctlbyname("kern.version", buffer.data(), &size, nullptr, 0);
-    if (size > 0) {
-      std::string version(buffer.data());
-      size_t newline = version.find('\n');
-      if (newline != std::string::npos) {
-        version = version.substr(0, newline);
-      }
-      return version;
-    }
-  }
-  return "unknown";
+  return name != nullptr ? name : "unknown";
+#else
+  return "";
+#endif
 }
 
 inline std::string getHostname() {
@@ -401,27 +1326,71 @@ inline std::string getHostname() {
   return "unknown";
 }
 
-inline std::string getMachineIP() {
-  struct ifaddrs *ifaddrs_ptr;
+inline const InterfaceAddress* findAddress(const NetAddresses& addresses, const char* name) {
+  for (size_t i = 0; i < addresses.count; ++i) {
+    if (strcmp(addresses.interfaces[i].name, name) == 0) {
+      return &addresses.interfaces[i];
+    }
+  }
+  return nullptr;
+}
+
+// Entry for name, added if it is not there yet; null when the table is full
+inline InterfaceAddress* addressEntry(NetAddresses& addresses, const char* name) {
+  if (const InterfaceAddress* entry = findAddress(addresses, name)) {
+    return const_cast<InterfaceAddress*>(entry);
+  }
+  if (addresses.count == MAX_INTERFACES) {
+    return nullptr;
+  }
+  InterfaceAddress& entry = addresses.interfaces[addresses.count++];
+  entry = InterfaceAddress{};
+  snprintf(entry.name, sizeof(entry.name), "%s", name);
+  return &entry;
+}
+
+// IPv4 and IPv6 addresses of every interface that is up, from one walk over
+// getifaddrs(), in the order the kernel lists them
+inline void getInterfaceAddresses(NetAddresses& addresses) {
+  addresses.count = 0;
+  struct ifaddrs* ifaddrs_ptr;
   if (getifaddrs(&ifaddrs_ptr) != 0) {
-    return "unknown";
+    return;
   }
+  for (struct ifaddrs* ifa = ifaddrs_ptr; ifa != nullptr; ifa = ifa->ifa_next) {
+    if (ifa->ifa_addr == nullptr || (ifa->ifa_flags & IFF_UP) == 0) continue;
+    const int family = ifa->ifa_addr->sa_family;
+    if (family != AF_INET && family != AF_INET6) continue;
+    InterfaceAddress* entry = addressEntry(addresses, ifa->ifa_name);
+    if (entry == nullptr) continue;
+    entry->loopback = (ifa->ifa_flags & IFF_LOOPBACK) != 0;
 
-  std::string ip;
-  for (struct ifaddrs *ifa = ifaddrs_ptr; ifa != nullptr; ifa = ifa->ifa_next) {
-    if (ifa->ifa_addr == nullptr) continue;
-    if (ifa->ifa_addr->sa_family != AF_INET) continue;
-    if (std::string(ifa->ifa_name).find("lo") == 0) continue;
-
-    struct sockaddr_in *sin = (struct sockaddr_in *)ifa->ifa_addr;
-    char ip_str[INET_ADDRSTRLEN];
-    if (inet_ntop(AF_INET, &sin->sin_addr, ip_str, INET_ADDRSTRLEN) != nullptr) {
-      ip = std::string(ip_str);
-      break;
+    if (family == AF_INET) {
+      if (entry->ipv4[0] == '\0') {
+        const auto* sin = reinterpret_cast<const struct sockaddr_in*>(ifa->ifa_addr);
+        inet_ntop(AF_INET, &sin->sin_addr, entry->ipv4, sizeof(entry->ipv4));
+      }
+    } else {
+      const auto* sin6 = reinterpret_cast<const struct sockaddr_in6*>(ifa->ifa_addr);
+      const bool global = !IN6_IS_ADDR_LINKLOCAL(&sin6->sin6_addr);
+      if (entry->ipv6[0] == '\0' || (global && !entry->ipv6_global)) {
+        inet_ntop(AF_INET6, &sin6->sin6_addr, entry->ipv6, sizeof(entry->ipv6));
+        entry->ipv6_global = global;
+      }
     }
   }
   freeifaddrs(ifaddrs_ptr);
-  return ip.empty() ? "unknown" : ip;
+}
+
+// The first IPv4 address not on a loopback interface
+inline std::string getMachineIP(const NetAddresses& addresses) {
+  for (size_t i = 0; i < addresses.count; ++i) {
+    const InterfaceAddress& entry = addresses.interfaces[i];
+    if (!entry.loopback && entry.ipv4[0] != '\0') {
+      return entry.ipv4;
+    }
+  }
+  return "unknown";
 }
 
 inline std::string getClientIP() {
@@ -437,22 +1406,123 @@ inline std::string getClientIP() {
   return "N/A";
 }
 
-inline std::vector<std::string> getDNS() {
-  std::vector<std::string> dns_servers;
-  std::string output = execCommand("scutil --dns | grep 'nameserver\\[0\\]' | head -3");
-  if (!output.empty()) {
-    std::istringstream iss(output);
-    std::string line;
-    while (std::getline(iss, line)) {
-      size_t colon = line.find(':');
-      if (colon != std::string::npos) {
-        std::string ip = line.substr(colon + 1);
-        while (!ip.empty() && ip[0] == ' ') ip.erase(0, 1);
-        if (!ip.empty()) {
-          dns_servers.push_back(ip);
+inline std::string getUserName(uid_t uid) {
+  struct passwd *pw = getpwuid(uid);
+  if (pw != nullptr && pw->pw_name != nullptr) {
+    return std::string(pw->pw_name);
+  }
+  return "unknown";
+}
+
+inline std::string getCurrentUser() {
+  return getUserName(getuid());
+}
+
+// Reads a whole (small) file into buf with raw open/read and NUL-terminates
+// it. Returns the number of bytes read, or -1 if the file could not be opened.
+inline ssize_t readFile(const char* path, char* buf, size_t cap) {
+  const int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return -1;
+  }
+  size_t len = 0;
+  while (len + 1 < cap) {
+    const ssize_t n = read(fd, buf + len, cap - 1 - len);
+    if (n <= 0) {
+      break;
+    }
+    len += static_cast<size_t>(n);
+  }
+  close(fd);
+  buf[len] = '\0';
+  return static_cast<ssize_t>(len);
+}
+
+// Streams a file line by line through a fixed stack buffer, for files such as
+// /proc/cpuinfo that grow with the machine. Lines longer than the buffer are
+// returned in buffer-sized pieces.
+struct LineReader {
+  explicit LineReader(const char* path) : fd(open(path, O_RDONLY | O_CLOEXEC)) {}
+  ~LineReader() {
+    if (fd >= 0) close(fd);
+  }
+  LineReader(const LineReader&) = delete;
+  LineReader& operator=(const LineReader&) = delete;
+
+  // Returns the next line without its newline, NUL-terminated in place
+  bool next(char*& line, size_t& len) {
+    while (fd >= 0) {
+      char* nl = static_cast<char*>(memchr(buf + start, '\n', end - start));
+      if (nl != nullptr || eof || (start == 0 && end == sizeof(buf) - 1)) {
+        if (nl == nullptr && start == end) {
+          return false;
         }
+        char* stop = nl != nullptr ? nl : buf + end;
+        *stop = '\0';
+        line = buf + start;
+        len = static_cast<size_t>(stop - line);
+        start = nl != nullptr ? static_cast<size_t>(nl - buf) + 1 : end;
+        return true;
+      }
+      memmove(buf, buf + start, end - start);
+      end -= start;
+      start = 0;
+      const ssize_t n = read(fd, buf + end, sizeof(buf) - 1 - end);
+      if (n <= 0) {
+        eof = true;
+      } else {
+        end += static_cast<size_t>(n);
       }
     }
+    return false;
+  }
+
+  int fd;
+  char buf[4096];
+  size_t start = 0;
+  size_t end = 0;
+  bool eof = false;
+};
+
+inline bool startsWith(const char* str, const char* prefix) {
+  return strncmp(str, prefix, strlen(prefix)) == 0;
+}
+
+// Value part of a "key : value" line as found in /proc/cpuinfo
+inline const char* procValue(const char* line) {
+  const char* colon = strchr(line, ':');
+  if (colon == nullptr) {
+    return "";
+  }
+  ++colon;
+  while (*colon == ' ' || *colon == '\t') ++colon;
+  return colon;
+}
+
+// The resolver library only ever uses the first three
+constexpr size_t MAX_NAMESERVERS = 3;
+
+// First three resolvers from resolv.conf, which macOS keeps in sync with the
+// primary configuration that `scutil --dns` reports
+inline std::vector<std::string> getDNS() {
+  std::vector<std::string> dns_servers;
+  const char* path = "/etc/resolv.conf";
+#if defined(MACHINE_REPORT_TEST_HOOKS)
+  // Test builds only: MACHINE_REPORT_RESOLV_CONF names another file
+  if (const char* test_path = getenv("MACHINE_REPORT_RESOLV_CONF")) path = test_path;
+#endif
+  LineReader reader(path);
+  char* line;
+  size_t len;
+  while (dns_servers.size() < MAX_NAMESERVERS && reader.next(line, len)) {
+    if (!startsWith(line, "nameserver")) continue;
+    char* ip = line + 10;
+    while (*ip == ' ' || *ip == '\t') ++ip;
+    char* stop = ip;
+    while (*stop != '\0' && *stop != ' ' && *stop != '\t') ++stop;
+    if (stop != ip) {
+      dns_servers.emplace_back(ip, stop);
+    }
   }
   if (dns_servers.empty()) {
     dns_servers.push_back("N/A");
@@ -460,14 +1530,483 @@ inline std::vector<std::string> getDNS() {
   return dns_servers;
 }
 
-inline std::string getCurrentUser() {
-  struct passwd *pw = getpwuid(getuid());
-  if (pw != nullptr && pw->pw_name != nullptr) {
-    return std::string(pw->pw_name);
+enum class ResolverStatus : uint8_t {
+  Ok,           // answered within DNS_SLOW_MS
+  Slow,         // answered, but later than that
+  Error,        // answered with an error code such as SERVFAIL or REFUSED
+  Unreachable,  // the host or port refused the query
+  Dead,         // no answer before the deadline
+  Invalid,      // the nameserver line holds no address
+};
+
+inline const char* resolverStatusName(ResolverStatus status) {
+  switch (status) {
+    case ResolverStatus::Ok: return "ok";
+    case ResolverStatus::Slow: return "slow";
+    case ResolverStatus::Error: return "error";
+    case ResolverStatus::Unreachable: return "unreachable";
+    case ResolverStatus::Dead: return "dead";
+    case ResolverStatus::Invalid: return "invalid";
+  }
+  return "invalid";
+}
+
+struct ResolverProbe {
+  std::string server;
+  ResolverStatus status = ResolverStatus::Dead;
+  double rtt_ms = -1.0;  // -1 without an answer
+};
+
+constexpr double DNS_SLOW_MS = 100.0;
+constexpr int DNS_PROBE_MAX_MS = 1000;
+
+// Asks every nameserver for the root zone's NS records at once, from one
+// thread: one non-blocking UDP socket per server, connected so the kernel
+// drops datagrams from anyone else and reports ICMP unreachables, and a
+// poll() loop until each has answered or deadline_ms has passed. The query
+// for "." is a 17-byte packet any recursive resolver answers from its cache,
+// so the round trip measures the resolver rather than the DNS behind it.
+// The port is a parameter so a stub server on a high port can stand in.
+inline void probeNameservers(const std::vector<std::string>& servers, int deadline_ms,
+                             const char* port, std::vector<ResolverProbe>& results) {
+  using Clock = std::chrono::steady_clock;
+  results.clear();
+  struct pollfd fds[MAX_NAMESERVERS];
+  size_t slot_of[MAX_NAMESERVERS];  // fds index to results index
+  uint16_t ids[MAX_NAMESERVERS];
+  Clock::time_point sent[MAX_NAMESERVERS];
+  size_t pending = 0;
+
+  const Clock::time_point start = Clock::now();
+  const Clock::time_point deadline = start + std::chrono::milliseconds(deadline_ms);
+  uint16_t id = static_cast<uint16_t>(start.time_since_epoch().count() ^ getpid());
+  for (const std::string& server : servers) {
+    if (results.size() == MAX_NAMESERVERS || server == "N/A") continue;
+    results.push_back(ResolverProbe{server, ResolverStatus::Invalid, -1.0});
+
+    // Numeric only, so no lookup can happen; keeps any %scope of an IPv6
+    // link-local address
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = AI_NUMERICHOST | AI_NUMERICSERV;
+    struct addrinfo* address = nullptr;
+    if (getaddrinfo(server.c_str(), port, &hints, &address) != 0) continue;
+    const int fd = socket(address->ai_family, SOCK_DGRAM, 0);
+    if (fd >= 0) {
+      fcntl(fd, F_SETFD, FD_CLOEXEC);
+      fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+    const bool connected = fd >= 0 && connect(fd, address->ai_addr, address->ai_addrlen) == 0;
+    freeaddrinfo(address);
+
+    id = static_cast<uint16_t>(id * 31421u + 6927u);
+    const unsigned char query[17] = {
+        static_cast<unsigned char>(id >> 8), static_cast<unsigned char>(id),
+        0x01, 0x00,              // recursion desired
+        0x00, 0x01, 0x00, 0x00,  // one question
+        0x00, 0x00, 0x00, 0x00,
+        0x00,                    // root name
+        0x00, 0x02, 0x00, 0x01,  // NS, IN
+    };
+    sent[pending] = Clock::now();
+    if (!connected || send(fd, query, sizeof(query), 0) != static_cast<ssize_t>(sizeof(query))) {
+      results.back().status = connected ? ResolverStatus::Unreachable : ResolverStatus::Invalid;
+      if (fd >= 0) close(fd);
+      continue;
+    }
+    results.back().status = ResolverStatus::Dead;
+    fds[pending] = {fd, POLLIN, 0};
+    slot_of[pending] = results.size() - 1;
+    ids[pending] = id;
+    ++pending;
+  }
+
+  const size_t opened = pending;
+  while (pending > 0) {
+    // Rounded down, so the probe never outlasts its deadline
+    const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now());
+    if (left.count() <= 0) break;
+    const int ready = poll(fds, static_cast<nfds_t>(opened), static_cast<int>(left.count()));
+    if (ready < 0 && errno != EINTR) break;
+    const Clock::time_point now = Clock::now();
+    for (size_t i = 0; i < opened && ready > 0; ++i) {
+      if (fds[i].fd < 0 || fds[i].revents == 0) continue;
+      ResolverProbe& probe = results[slot_of[i]];
+      unsigned char reply[512];
+      const ssize_t n = recv(fds[i].fd, reply, sizeof(reply), 0);
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) continue;
+      if (n < 0) {
+        probe.status = ResolverStatus::Unreachable;
+      } else if (n < 12 || (reply[0] << 8 | reply[1]) != ids[i] || (reply[2] & 0x80) == 0) {
+        continue;  // not the answer to this query; keep waiting
+      } else {
+        probe.rtt_ms = std::chrono::duration<double, std::milli>(now - sent[i]).count();
+        const int rcode = reply[3] & 0x0f;
+        probe.status = rcode != 0 ? ResolverStatus::Error
+                       : probe.rtt_ms > DNS_SLOW_MS ? ResolverStatus::Slow
+                                                    : ResolverStatus::Ok;
+      }
+      close(fds[i].fd);
+      fds[i].fd = -1;  // poll() skips negative descriptors
+      --pending;
+    }
+  }
+  for (size_t i = 0; i < opened; ++i) {
+    if (fds[i].fd >= 0) close(fds[i].fd);
+  }
+}
+
+// Port the probe queries. Test builds take MACHINE_REPORT_DNS_PORT, so that
+// a stub server on a high port can stand in for real nameservers.
+inline const char* dnsProbePort() {
+#if defined(MACHINE_REPORT_TEST_HOOKS)
+  if (const char* port = getenv("MACHINE_REPORT_DNS_PORT")) return port;
+#endif
+  return "53";
+}
+
+// Matches the first field of uptime(1): "3 days", "4:07" or "12 mins"
+inline std::string formatUptime(long seconds) {
+  const long days = seconds / 86400;
+  const long hours = (seconds % 86400) / 3600;
+  const long mins = (seconds % 3600) / 60;
+  char buf[32];
+  if (days > 0) {
+    snprintf(buf, sizeof(buf), "%ld day%s", days, days == 1 ? "" : "s");
+  } else if (hours > 0) {
+    snprintf(buf, sizeof(buf), "%ld:%02ld", hours, mins);
+  } else {
+    snprintf(buf, sizeof(buf), "%ld min%s", mins, mins == 1 ? "" : "s");
+  }
+  return buf;
+}
+
+// "Wed 10:34 PM", built by hand so the output does not depend on the locale
+inline std::string formatLoginTime(time_t when) {
+  static constexpr const char* DAYS[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+  struct tm tm_buf;
+  if (localtime_r(&when, &tm_buf) == nullptr) {
+    return "N/A";
+  }
+  int hour = tm_buf.tm_hour % 12;
+  if (hour == 0) {
+    hour = 12;
+  }
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%s %d:%02d %s", DAYS[tm_buf.tm_wday], hour, tm_buf.tm_min,
+           tm_buf.tm_hour < 12 ? "AM" : "PM");
+  return buf;
+}
+
+// True if item is one of the entries of a comma-separated list
+inline bool listContains(const char* list, const char* item, size_t len) {
+  const char* p = list;
+  while (true) {
+    const char* comma = strchr(p, ',');
+    const size_t entry = comma != nullptr ? static_cast<size_t>(comma - p) : strlen(p);
+    if (entry == len && memcmp(p, item, len) == 0) {
+      return true;
+    }
+    if (comma == nullptr) {
+      return false;
+    }
+    p = comma + 1;
+  }
+}
+
+// A mount that passed the filters, before it is measured
+struct VolumeCandidate {
+  uint64_t device;
+  std::string mount;
+  std::string fstype;
+};
+
+// Keeps one mount per device: bind mounts, and the volumes of one APFS
+// container, all report the same space, so the shortest mount point stands
+// in for the others. A mount stacked on an earlier one at the same path
+// hides it and takes its place.
+inline void addVolume(std::vector<VolumeCandidate>& volumes, uint64_t device, const char* mount,
+                      const char* fstype) {
+  for (VolumeCandidate& volume : volumes) {
+    if (volume.mount == mount) {
+      volume.device = device;
+      volume.fstype = fstype;
+      return;
+    }
+    if (volume.device == device) {
+      if (strlen(mount) < volume.mount.size()) {
+        volume.mount = mount;
+      }
+      return;
+    }
+  }
+  volumes.push_back({device, mount, fstype});
+}
+
+// Sizes from statfs/statvfs block counts; space reserved for root counts as
+// used, as it always has for the root volume
+inline bool measureVolume(DiskInfo& info, uint64_t blocks, uint64_t avail, uint64_t block_size) {
+  if (blocks == 0) {
+    return false;
+  }
+  info.total = blocks * block_size;
+  info.used = (blocks - std::min(avail, blocks)) * block_size;
+  info.percent = (static_cast<double>(info.used) / static_cast<double>(info.total)) * 100.0;
+  return true;
+}
+
+// Copies the fixed-width, possibly unterminated fields of a login record
+inline void fillLoginInfo(const struct utmpx& entry, LoginInfo& info) {
+  info.user.assign(entry.ut_user, strnlen(entry.ut_user, sizeof(entry.ut_user)));
+  info.tty.assign(entry.ut_line, strnlen(entry.ut_line, sizeof(entry.ut_line)));
+  info.timestamp = entry.ut_tv.tv_sec;
+  info.time = formatLoginTime(info.timestamp);
+  info.ip.assign(entry.ut_host, strnlen(entry.ut_host, sizeof(entry.ut_host)));
+  info.ip_present = !info.ip.empty();
+}
+
+inline uint64_t ticksDelta(uint64_t before, uint64_t after) {
+  return after > before ? after - before : 0;
+}
+
+inline void ticksUsage(const CPUTicks& before, const CPUTicks& after, double& busy,
+                       double* user = nullptr, double* system = nullptr,
+                       double* iowait = nullptr, double* steal = nullptr) {
+  const uint64_t d_user = ticksDelta(before.user, after.user) + ticksDelta(before.nice, after.nice);
+  const uint64_t d_system = ticksDelta(before.system, after.system) +
+                            ticksDelta(before.irq, after.irq) +
+                            ticksDelta(before.softirq, after.softirq);
+  const uint64_t d_idle = ticksDelta(before.idle, after.idle);
+  const uint64_t d_iowait = ticksDelta(before.iowait, after.iowait);
+  const uint64_t d_steal = ticksDelta(before.steal, after.steal);
+  const uint64_t d_total = d_user + d_system + d_idle + d_iowait + d_steal;
+  const double scale = d_total > 0 ? 100.0 / static_cast<double>(d_total) : 0.0;
+  busy = static_cast<double>(d_user + d_system + d_steal) * scale;
+  if (user) *user = static_cast<double>(d_user) * scale;
+  if (system) *system = static_cast<double>(d_system) * scale;
+  if (iowait) *iowait = static_cast<double>(d_iowait) * scale;
+  if (steal) *steal = static_cast<double>(d_steal) * scale;
+}
+
+// Utilization between two tick snapshots. Against an empty `before` this is
+// the average since boot.
+inline CPUUsage computeCPUUsage(const CPUSample& before, const CPUSample& after) {
+  CPUUsage usage;
+  ticksUsage(before.total, after.total, usage.busy, &usage.user, &usage.system, &usage.iowait,
+             &usage.steal);
+  usage.cores.resize(after.cores.size());
+  for (size_t i = 0; i < after.cores.size(); ++i) {
+    const CPUTicks& prev = i < before.cores.size() ? before.cores[i] : CPUTicks{};
+    ticksUsage(prev, after.cores[i], usage.cores[i]);
+  }
+  return usage;
+}
+
+#if defined(MACHINE_REPORT_TEST_HOOKS)
+// Test builds only (-DMACHINE_REPORT_TEST_HOOKS): MACHINE_REPORT_STALL set to
+// "<name>:<ms>,..." makes the named collectors sleep on their worker before
+// collecting, standing in for a hung file system or directory service.
+// Cheap collectors run inline and are never stalled. The name "statvfs"
+// stalls the measuring of every network mount instead, and "process_scan"
+// every chunk of a parallel process scan that a pool worker claims.
+inline void stallForTest(const char* name) {
+  const char* list = getenv("MACHINE_REPORT_STALL");
+  const size_t name_len = strlen(name);
+  for (const char* p = list; p != nullptr && *p != '\0';) {
+    const char* colon = strchr(p, ':');
+    if (colon == nullptr) break;
+    if (static_cast<size_t>(colon - p) == name_len && strncmp(p, name, name_len) == 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(strtol(colon + 1, nullptr, 10)));
+      return;
+    }
+    p = strchr(colon, ',');
+    if (p != nullptr) ++p;
+  }
+}
+#endif
+
+// Platform collectors. Each backend below implements the same set of
+// functions, so everything from main() down is platform independent:
+//
+//   std::string getOSName();
+//   std::string getKernelVersion();
+//   CPUInfo getCPUInfo();                 model, core counts and topology
+//   PlatformInfo getPlatformInfo();       hypervisor and cloud, from CPUID
+//                                         and firmware strings
+//   void getLoadAverages(CPUInfo& info);
+//   bool getCPUTicks(CPUSample& sample);   per-CPU tick counters
+//   MemInfo getMemInfo();
+//   void getResourcePressure(PressureInfo& host, CgroupInfo& cgroup);
+//                                         stall averages and container limits,
+//                                         left absent where unsupported
+//   std::vector<DiskInfo> getDisks(const char* fs_types);
+//                                         writable volumes of the listed types
+//   DEFAULT_FS_TYPES                      the list used without --fs-types
+//   LoginInfo getLastLogin();
+//   bool getInterfaceCounters(NetSample& sample);
+//                                         traffic counters, loopback excluded
+//   bool getBlockDeviceCounters(DiskIOSample& sample);
+//                                         I/O counters of whole devices
+//   bool listProcesses(std::vector<int>& pids);
+//                                         every pid, ascending
+//   bool readProcess(int pid, int& fd, ProcessSample& sample);
+//                                         false once the process has exited
+//                                         or may not be inspected; fd is a
+//                                         descriptor kept for pid from one
+//                                         scan to the next, -1 for none
+//   void closeProcessFd(int& fd);         releases a kept descriptor
+//   long getUptimeSeconds();
+//   bool getBootID(char* buf, size_t cap); differs on every boot
+//   bool getPeerUID(int fd, uid_t& uid);  owner of a connected Unix socket
+//   long getSyscallCount();               for --profile, -1 if unavailable
+//   SYSCALL_PROBE_CALLS                   calls one getSyscallCount() adds
+
+#if defined(__APPLE__)
+
+// ---- macOS backend: sysctl, Mach host statistics and system plists ----
+
+// Value of <key>name</key><string>value</string> in an XML property list
+inline std::string plistString(const char* plist, const char* name) {
+  char key[64];
+  snprintf(key, sizeof(key), "<key>%s</key>", name);
+  const char* p = strstr(plist, key);
+  if (p == nullptr) {
+    return "";
+  }
+  p = strstr(p + strlen(key), "<string>");
+  if (p == nullptr) {
+    return "";
+  }
+  p += 8;
+  const char* end = strstr(p, "</string>");
+  return end != nullptr ? std::string(p, end) : "";
+}
+
+inline std::string getOSName() {
+  // Same source sw_vers reads, without forking it twice
+  char plist[4096];
+  if (readFile("/System/Library/CoreServices/SystemVersion.plist", plist, sizeof(plist)) > 0) {
+    std::string product_name = plistString(plist, "ProductName");
+    std::string product_version = plistString(plist, "ProductVersion");
+    if (!product_name.empty() && !product_version.empty()) {
+      return product_name + " " + product_version;
+    }
+  }
+
+  size_t size = 0;
+  sysctlbyname("kern.ostype", nullptr, &size, nullptr, 0);
+  std::string os_type = "macOS";
+  if (size > 1) {
+    std::vector<char> buffer(size);
+    sysctlbyname("kern.ostype", buffer.data(), &size, nullptr, 0);
+    if (size > 0 && buffer[size - 1] == '\0') {
+      os_type = std::string(buffer.data());
+    }
+  }
+
+  size = 0;
+  sysctlbyname("kern.osrelease", nullptr, &size, nullptr, 0);
+  std::string os_release = "";
+  if (size > 1) {
+    std::vector<char> buffer(size);
+    sysctlbyname("kern.osrelease", buffer.data(), &size, nullptr, 0);
+    if (size > 0 && buffer[size - 1] == '\0') {
+      os_release = std::string(buffer.data());
+    }
+  }
+  return os_type + " " + os_release;
+}
+
+inline std::string getKernelVersion() {
+  size_t size = 0;
+  sysctlbyname("kern.version", nullptr, &size, nullptr, 0);
+  if (size > 1) {
+    std::vector<char> buffer(size);
+    sysctlbyname("kern.version", buffer.data(), &size, nullptr, 0);
+    if (size > 0) {
+      std::string version(buffer.data());
+      size_t newline = version.find('\n');
+      if (newline != std::string::npos) {
+        version = version.substr(0, newline);
+      }
+      return version;
+    }
   }
   return "unknown";
 }
 
+// Integer sysctl of either width, 0 when it does not exist
+inline uint64_t sysctlNumber(const char* name) {
+  uint64_t value = 0;
+  size_t size = sizeof(value);
+  if (sysctlbyname(name, &value, &size, nullptr, 0) != 0) {
+    return 0;
+  }
+  return size == sizeof(uint32_t) ? static_cast<uint32_t>(value) : value;
+}
+
+// Apple Silicon describes each cluster type as a performance level,
+// hw.perflevel0 being the fastest; Intel Macs have one level and the
+// hw.*cachesize sysctls with sharing in hw.cacheconfig. Macs have no NUMA.
+inline CPUTopology getCPUTopology(const CPUInfo& info) {
+  CPUTopology topology;
+  topology.threads_per_core =
+      info.cores_physical > 0 ? std::max(1, info.cores_logical / info.cores_physical) : 1;
+  const auto cache = [&topology](int level, char kind, uint64_t size, int shared_by, int cpus) {
+    if (size == 0) return;
+    shared_by = std::max(shared_by, 1);
+    addCache(topology.caches, CacheInfo{level, kind, size, shared_by,
+                                        std::max(1, cpus / shared_by)});
+  };
+
+  const int levels = static_cast<int>(sysctlNumber("hw.nperflevels"));
+  if (levels == 0) {
+    uint64_t sharing[10] = {};
+    size_t size = sizeof(sharing);
+    sysctlbyname("hw.cacheconfig", sharing, &size, nullptr, 0);
+    const int cpus = info.cores_logical;
+    cache(1, 'd', sysctlNumber("hw.l1dcachesize"), static_cast<int>(sharing[1]), cpus);
+    cache(1, 'i', sysctlNumber("hw.l1icachesize"), static_cast<int>(sharing[1]), cpus);
+    cache(2, 'u', sysctlNumber("hw.l2cachesize"), static_cast<int>(sharing[2]), cpus);
+    cache(3, 'u', sysctlNumber("hw.l3cachesize"), static_cast<int>(sharing[3]), cpus);
+    return topology;
+  }
+  for (int level = 0; level < levels; ++level) {
+    char name[64];
+    const auto number = [&name, level](const char* key) {
+      snprintf(name, sizeof(name), "hw.perflevel%d.%s", level, key);
+      return static_cast<int>(sysctlNumber(name));
+    };
+    const auto bytes = [&name, level](const char* key) {
+      snprintf(name, sizeof(name), "hw.perflevel%d.%s", level, key);
+      return sysctlNumber(name);
+    };
+    CoreClass core_class;
+    core_class.physical = number("physicalcpu");
+    core_class.logical = number("logicalcpu");
+    char label[32] = {};
+    size_t size = sizeof(label) - 1;
+    snprintf(name, sizeof(name), "hw.perflevel%d.name", level);
+    if (sysctlbyname(name, label, &size, nullptr, 0) == 0) {
+      core_class.name = toLower(label);
+    } else {
+      core_class.name = level == 0 ? "performance" : "efficiency";
+    }
+    // L1 belongs to each core
+    const int threads = std::max(1, core_class.logical / std::max(1, core_class.physical));
+    cache(1, 'd', bytes("l1dcachesize"), threads, core_class.logical);
+    cache(1, 'i', bytes("l1icachesize"), threads, core_class.logical);
+    cache(2, 'u', bytes("l2cachesize"), number("cpusperl2"), core_class.logical);
+    cache(3, 'u', bytes("l3cachesize"), number("cpusperl3"), core_class.logical);
+    topology.classes.push_back(std::move(core_class));
+  }
+  if (topology.classes.size() < 2) {
+    topology.classes.clear();
+  }
+  return topology;
+}
+
 inline CPUInfo getCPUInfo() {
   CPUInfo info;
 
@@ -489,9 +2028,39 @@ inline CPUInfo getCPUInfo() {
   sysctlbyname("hw.physicalcpu", &info.cores_physical, &size, nullptr, 0);
   sysctlbyname("hw.logicalcpu", &info.cores_logical, &size, nullptr, 0);
   sysctlbyname("hw.packages", &info.sockets, &size, nullptr, 0);
+  info.topology = getCPUTopology(info);
+
+  info.load_1 = info.load_5 = info.load_15 = 0.0;
+  return info;
+}
+
+// Intel Macs answer CPUID. On Apple silicon, kern.hv_vmm_present only says
+// whether there is a hypervisor, so it is named after the model it presents.
+// Macs in a cloud run on bare metal and cannot tell.
+inline PlatformInfo getPlatformInfo() {
+  PlatformInfo info;
+  info.hypervisor = cpuidHypervisor();
+  if (!info.hypervisor.empty() || sysctlNumber("kern.hv_vmm_present") == 0) {
+    return info;
+  }
+  char model[64] = {};
+  size_t size = sizeof(model) - 1;
+  sysctlbyname("hw.model", model, &size, nullptr, 0);
+  if (strncmp(model, "VirtualMac", 10) == 0) {
+    info.hypervisor = "apple";
+  } else if (strncmp(model, "Parallels", 9) == 0) {
+    info.hypervisor = "parallels";
+  } else if (strncmp(model, "VMware", 6) == 0) {
+    info.hypervisor = "vmware";
+  } else {
+    info.hypervisor = "unknown";
+  }
+  return info;
+}
 
+inline void getLoadAverages(CPUInfo& info) {
   struct loadavg load;
-  size = sizeof(load);
+  size_t size = sizeof(load);
   if (sysctlbyname("vm.loadavg", &load, &size, nullptr, 0) == 0) {
     info.load_1 = static_cast<double>(load.ldavg[0]) / static_cast<double>(load.fscale);
     info.load_5 = static_cast<double>(load.ldavg[1]) / static_cast<double>(load.fscale);
@@ -499,10 +2068,40 @@ inline CPUInfo getCPUInfo() {
   } else {
     info.load_1 = info.load_5 = info.load_15 = 0.0;
   }
+}
 
-  return info;
+inline bool getCPUTicks(CPUSample& sample) {
+  natural_t cpu_count = 0;
+  processor_info_array_t info_array;
+  mach_msg_type_number_t info_count;
+  if (host_processor_info(mach_host_self(), PROCESSOR_CPU_LOAD_INFO, &cpu_count, &info_array,
+                          &info_count) != KERN_SUCCESS) {
+    return false;
+  }
+  const processor_cpu_load_info_t loads = reinterpret_cast<processor_cpu_load_info_t>(info_array);
+  sample.total = CPUTicks{};
+  sample.cores.resize(cpu_count);
+  for (natural_t i = 0; i < cpu_count; ++i) {
+    CPUTicks& core = sample.cores[i];
+    core = CPUTicks{};
+    core.user = loads[i].cpu_ticks[CPU_STATE_USER];
+    core.nice = loads[i].cpu_ticks[CPU_STATE_NICE];
+    core.system = loads[i].cpu_ticks[CPU_STATE_SYSTEM];
+    core.idle = loads[i].cpu_ticks[CPU_STATE_IDLE];
+    sample.total.user += core.user;
+    sample.total.nice += core.nice;
+    sample.total.system += core.system;
+    sample.total.idle += core.idle;
+  }
+  vm_deallocate(mach_task_self(), reinterpret_cast<vm_address_t>(info_array),
+                info_count * sizeof(integer_t));
+  return true;
 }
 
+// Counts as Activity Monitor does: used memory is app memory (anonymous
+// pages that are not purgeable) plus wired plus what the compressor
+// occupies; cached files and purgeable pages count as available. Page
+// counts are 32-bit, so every product is taken in 64 bits.
 inline MemInfo getMemInfo() {
   MemInfo info;
   vm_size_t page_size;
@@ -510,210 +2109,4675 @@ inline MemInfo getMemInfo() {
   mach_msg_type_number_t host_size = sizeof(vm_statistics64_data_t) / sizeof(natural_t);
 
   host_page_size(mach_host_self(), &page_size);
-
-  if (host_statistics64(mach_host_self(), HOST_VM_INFO64, (host_info64_t)&vm_stat, &host_size) == KERN_SUCCESS) {
-    uint64_t total_mem;
-    size_t size = sizeof(total_mem);
-    sysctlbyname("hw.memsize", &total_mem, &size, nullptr, 0);
-
-    uint64_t used_mem = (vm_stat.active_count + vm_stat.wire_count) * page_size;
-    info.total = total_mem;
-    info.used = used_mem;
-    info.percent = (static_cast<double>(used_mem) / static_cast<double>(total_mem)) * 100.0;
-  } else {
-    info.total = info.used = 0;
-    info.percent = 0.0;
+  size_t size = sizeof(info.total);
+  if (sysctlbyname("hw.memsize", &info.total, &size, nullptr, 0) != 0 || info.total == 0 ||
+      host_statistics64(mach_host_self(), HOST_VM_INFO64, (host_info64_t)&vm_stat, &host_size) !=
+          KERN_SUCCESS) {
+    return MemInfo{};
   }
+  const auto bytes = [page_size](natural_t pages) {
+    return static_cast<uint64_t>(pages) * static_cast<uint64_t>(page_size);
+  };
+  info.wired = bytes(vm_stat.wire_count);
+  info.active = bytes(vm_stat.active_count);
+  info.inactive = bytes(vm_stat.inactive_count);
+  info.compressed = bytes(vm_stat.compressor_page_count);
+  info.purgeable = bytes(vm_stat.purgeable_count);
+  info.file_backed = bytes(vm_stat.external_page_count);
+  const uint64_t app = bytes(vm_stat.internal_page_count) -
+                       std::min(info.purgeable, bytes(vm_stat.internal_page_count));
+  info.used = std::min(app + info.wired + info.compressed, info.total);
+  info.available = info.total - info.used;
+  info.percent = static_cast<double>(info.used) / static_cast<double>(info.total) * 100.0;
 
+  struct xsw_usage swap;
+  size = sizeof(swap);
+  if (sysctlbyname("vm.swapusage", &swap, &size, nullptr, 0) == 0) {
+    info.swap_total = swap.xsu_total;
+    info.swap_used = swap.xsu_used;
+  }
+  // Share of memory the kernel considers free, from 100 down
+  int level;
+  size = sizeof(level);
+  if (sysctlbyname("kern.memorystatus_level", &level, &size, nullptr, 0) == 0 && level >= 0 &&
+      level <= 100) {
+    info.pressure = 100.0 - level;
+  }
   return info;
 }
 
-inline DiskInfo getDiskInfo() {
-  DiskInfo info;
-  struct statfs fs;
-  if (statfs("/", &fs) == 0) {
-    uint64_t total_bytes = fs.f_blocks * fs.f_bsize;
-    uint64_t free_bytes = fs.f_bavail * fs.f_bsize;
-    uint64_t used_bytes = total_bytes - free_bytes;
+// macOS has neither PSI nor cgroups
+inline void getResourcePressure(PressureInfo& host, CgroupInfo& cgroup) {
+  host = PressureInfo{};
+  cgroup = CgroupInfo{};
+}
+
+constexpr const char* DEFAULT_FS_TYPES = "apfs,hfs,exfat,msdos,ntfs,nfs,smbfs,afpfs";
 
-    info.total = total_bytes;
-    info.used = used_bytes;
-    info.percent = (static_cast<double>(used_bytes) / static_cast<double>(total_bytes)) * 100.0;
-  } else {
-    info.total = info.used = 0;
-    info.percent = 0.0;
+// Volumes of one APFS container share its free space, so they are grouped
+// by the container's disk: /dev/disk3s5 and /dev/disk3s1s1 both key to 3.
+// Everything else is keyed by its filesystem ID.
+inline uint64_t volumeDevice(const struct statfs& fs) {
+  unsigned container;
+  if (strcmp(fs.f_fstypename, "apfs") == 0 &&
+      sscanf(fs.f_mntfromname, "/dev/disk%u", &container) == 1) {
+    return (1ull << 32) | container;
   }
-
-  return info;
+  return static_cast<uint32_t>(fs.f_fsid.val[0]);
 }
 
-inline LoginInfo getLastLogin() {
-  LoginInfo info;
-  std::string last_cmd = execCommand("last -1 -t console | head -1");
-  if (!last_cmd.empty()) {
-    std::istringstream iss(last_cmd);
-    std::string token;
-    std::vector<std::string> tokens;
-    while (iss >> token) {
-      tokens.push_back(token);
-    }
-    if (tokens.size() >= 6) {
-      std::string day = tokens[2];
-      std::string time_str;
-      for (size_t i = 3; i < tokens.size(); ++i) {
-        size_t colon_pos = tokens[i].find(':');
-        if (colon_pos != std::string::npos && colon_pos == 2) {
-          time_str = tokens[i];
-          break;
-        }
-      }
-      if (!time_str.empty()) {
-        size_t colon_pos = time_str.find(':');
-        int hour = std::stoi(time_str.substr(0, colon_pos));
-        std::string minute = time_str.substr(colon_pos + 1);
-        if (minute.length() > 2) {
-          minute = minute.substr(0, 2);
-        }
-        std::string period = (hour < 12) ? "AM" : "PM";
-        if (hour == 0) {
-          hour = 12;
-        } else if (hour > 12) {
-          hour -= 12;
-        }
-        std::stringstream ss;
-        ss << day << " " << hour << ":" << minute << " " << period;
-        info.time = ss.str();
-      } else {
-        info.time = day;
-      }
-      info.ip_present = false;
-    } else if (tokens.size() >= 3) {
-      info.time = tokens[2];
-      info.ip_present = false;
-    } else {
-      info.time = "N/A";
-      info.ip_present = false;
+// Every writable local or network volume whose type is in fs_types, from a
+// single getfsstat() snapshot. MNT_NOWAIT returns the cached sizes instead of
+// asking each filesystem, so a dead network mount cannot stall the report.
+inline std::vector<DiskInfo> getDisks(const char* fs_types) {
+  std::vector<struct statfs> mounts(64);
+  int count;
+  while (true) {
+    const int size = static_cast<int>(mounts.size() * sizeof(struct statfs));
+    count = getfsstat(mounts.data(), size, MNT_NOWAIT);
+    if (count < static_cast<int>(mounts.size())) {
+      break;
     }
-  } else {
-    info.time = "N/A";
-    info.ip_present = false;
+    mounts.resize(mounts.size() * 2);
   }
 
-  std::string uptime_cmd = execCommand("uptime | sed 's/.*up \\([^,]*\\).*/\\1/'");
-  if (!uptime_cmd.empty()) {
-    info.uptime = uptime_cmd;
-  } else {
-    info.uptime = "N/A";
+  std::vector<VolumeCandidate> volumes;
+  for (int i = 0; i < count; ++i) {
+    const struct statfs& fs = mounts[i];
+    if ((fs.f_flags & MNT_RDONLY) != 0 ||
+        !listContains(fs_types, fs.f_fstypename, strlen(fs.f_fstypename))) {
+      continue;
+    }
+#ifdef MNT_SNAPSHOT
+    if ((fs.f_flags & MNT_SNAPSHOT) != 0) {
+      continue;
+    }
+#endif
+    // The sealed system snapshot at / is read-only; the writable half of the
+    // root filesystem is firmlinked in from the data volume
+    const char* mount = strcmp(fs.f_mntonname, "/System/Volumes/Data") == 0 ? "/" : fs.f_mntonname;
+    addVolume(volumes, volumeDevice(fs), mount, fs.f_fstypename);
   }
 
-  return info;
+  std::vector<DiskInfo> disks;
+  for (VolumeCandidate& volume : volumes) {
+    const auto fs = std::find_if(mounts.begin(), mounts.begin() + count,
+                                 [&volume](const struct statfs& m) {
+                                   return volumeDevice(m) == volume.device;
+                                 });
+    DiskInfo info;
+    if (measureVolume(info, fs->f_blocks, fs->f_bavail, fs->f_bsize)) {
+      info.mount = std::move(volume.mount);
+      info.fstype = std::move(volume.fstype);
+      disks.push_back(std::move(info));
+    }
+  }
+  if (disks.empty()) {
+    struct statfs fs;
+    DiskInfo info;
+    if (statfs("/", &fs) == 0 && measureVolume(info, fs.f_blocks, fs.f_bavail, fs.f_bsize)) {
+      info.mount = "/";
+      info.fstype = fs.f_fstypename;
+      disks.push_back(std::move(info));
+    }
+  }
+  return disks;
 }
 
-int main() {
-  auto future_dns = std::async(std::launch::async, getDNS);
-  auto future_client_ip = std::async(std::launch::async, getClientIP);
-  auto future_login = std::async(std::launch::async, getLastLogin);
+inline LoginInfo getLastLogin() {
+  LoginInfo info;
+  info.timestamp = 0;
+  info.time = "N/A";
+  info.ip_present = false;
 
-  std::string os_name = toLower(getOSName());
-  std::string os_kernel = toLower(getKernelVersion());
-  std::string net_hostname = toLower(getHostname());
-  std::string net_machine_ip = getMachineIP();
-  std::string net_current_user = toLower(getCurrentUser());
+  // Equivalent of `last -1 -t console`. macOS keeps no fixed-record wtmp
+  // file to map: utmpx history lives in the ASL store, and
+  // setutxent_wtmp(0) searches it newest first, so this is already the
+  // reverse scan readLastLogin does on Linux and stops at the first
+  // console login.
+  setutxent_wtmp(0);
+  while (const struct utmpx* entry = getutxent_wtmp()) {
+    if (entry->ut_type == USER_PROCESS && strncmp(entry->ut_line, "console", sizeof(entry->ut_line)) == 0) {
+      fillLoginInfo(*entry, info);
+      break;
+    }
+  }
+  endutxent_wtmp();
 
-  const CPUInfo cpu = getCPUInfo();
-  const MemInfo mem = getMemInfo();
-  const DiskInfo disk = getDiskInfo();
+  return info;
+}
 
-  const std::vector<std::string> net_dns_ip = future_dns.get();
-  const std::string net_client_ip = future_client_ip.get();
-  const LoginInfo login = future_login.get();
+inline bool listProcesses(std::vector<int>& pids) {
+  const int estimate = proc_listallpids(nullptr, 0);
+  if (estimate <= 0) {
+    pids.clear();
+    return false;
+  }
+  // Room for processes started between the two calls
+  pids.resize(static_cast<size_t>(estimate) + estimate / 8 + 16);
+  const int count = proc_listallpids(pids.data(), static_cast<int>(pids.size() * sizeof(int)));
+  pids.resize(count > 0 ? static_cast<size_t>(count) : 0);
+  std::sort(pids.begin(), pids.end());
+  return count > 0;
+}
 
-  const std::string cpu_cores_str = std::to_string(cpu.cores_physical) + " cores";
+// CPU time, resident size, name and start time from one
+// proc_pidinfo(PROC_PIDTASKALLINFO) call. Without root, other users'
+// processes refuse it and are left out. No descriptor is involved, so fd
+// stays -1.
+inline bool readProcess(int pid, int& /*fd*/, ProcessSample& sample) {
+  // Task times are in Mach absolute time units
+  static const mach_timebase_info_data_t timebase = [] {
+    mach_timebase_info_data_t info;
+    mach_timebase_info(&info);
+    return info;
+  }();
+  struct proc_taskallinfo info;
+  if (pid == 0 || proc_pidinfo(pid, PROC_PIDTASKALLINFO, 0, &info, sizeof(info)) != sizeof(info)) {
+    return false;
+  }
+  sample.pid = pid;
+  sample.start = info.pbsd.pbi_start_tvsec * 1000000ull + info.pbsd.pbi_start_tvusec;
+  const uint64_t ticks = info.ptinfo.pti_total_user + info.ptinfo.pti_total_system;
+  sample.cpu_ns = ticks * timebase.numer / timebase.denom;
+  sample.rss = info.ptinfo.pti_resident_size;
+  snprintf(sample.name, sizeof(sample.name), "%s", info.pbsd.pbi_comm);
+  return true;
+}
 
-  const double usage_percent = (cpu.load_1 / cpu.cores_logical) * 100.0;
-  std::stringstream usage_ss;
-  usage_ss << static_cast<int>(usage_percent + 0.5) << "%";
-  const std::string cpu_usage_str = usage_ss.str();
+inline void closeProcessFd(int& fd) {
+  fd = -1;
+}
 
-  std::stringstream mem_str_ss;
-  mem_str_ss << formatGiB(mem.used) << "/" << formatGiB(mem.total) << " gib ["
-             << static_cast<int>(mem.percent + 0.5) << "%]";
-  const std::string mem_usage_str = mem_str_ss.str();
+// Counters of every interface except loopback from one NET_RT_IFLIST2
+// sysctl, whose if_data64 counters do not wrap at 4 GiB like the if_data
+// attached to getifaddrs() entries. The buffer is kept and only grows, so
+// steady-state sampling does not allocate.
+inline bool getInterfaceCounters(NetSample& sample) {
+  sample.count = 0;
+  static thread_local std::vector<char> buf;
+  int mib[] = {CTL_NET, PF_ROUTE, 0, 0, NET_RT_IFLIST2, 0};
+  size_t size = 0;
+  if (sysctl(mib, 6, nullptr, &size, nullptr, 0) != 0) {
+    return false;
+  }
+  size += size / 8;  // interfaces may appear between the two calls
+  if (buf.size() < size) {
+    buf.resize(size);
+  }
+  size = buf.size();
+  if (sysctl(mib, 6, buf.data(), &size, nullptr, 0) != 0) {
+    return false;
+  }
 
-  std::stringstream disk_str_ss;
-  disk_str_ss << formatBytes(disk.used) << "/" << formatBytes(disk.total)
-              << " gb [" << static_cast<int>(disk.percent + 0.5) << "%]";
-  const std::string disk_usage_str = disk_str_ss.str();
+  for (size_t offset = 0; offset + sizeof(struct if_msghdr) <= size;) {
+    const auto* header = reinterpret_cast<const struct if_msghdr*>(buf.data() + offset);
+    if (header->ifm_msglen == 0) break;
+    offset += header->ifm_msglen;
+    if (header->ifm_type != RTM_IFINFO2 || (header->ifm_flags & IFF_LOOPBACK) != 0) continue;
 
-  std::string cpu_model_with_japanese = std::string(JAPANESE_CPU) + " " + toLower(cpu.model);
-  std::string disk_usage_with_japanese = std::string(JAPANESE_DISK) + " " + disk_usage_str;
-  std::string mem_usage_with_japanese = std::string(JAPANESE_MEM) + " " + mem_usage_str;
-  std::string login_time_with_japanese = std::string(JAPANESE_TIME) + " " + toLower(login.time);
+    // The interface's link-level address, which carries its name, follows
+    const auto* info = reinterpret_cast<const struct if_msghdr2*>(header);
+    const auto* link = reinterpret_cast<const struct sockaddr_dl*>(info + 1);
+    if (link->sdl_family != AF_LINK || sample.count == MAX_INTERFACES) continue;
 
-  std::vector<std::string> all_strings = {
-      REPORT_TITLE,   os_name,       os_kernel,        net_hostname,
-      net_machine_ip, net_client_ip, net_current_user, cpu_model_with_japanese,
-      cpu_cores_str,  "Bare Metal",  cpu_usage_str,    mem_usage_with_japanese,
-      disk_usage_with_japanese, login_time_with_japanese, login.ip, login.uptime};
+    InterfaceCounters& counters = sample.interfaces[sample.count++];
+    const size_t name_len = std::min<size_t>(link->sdl_nlen, sizeof(counters.name) - 1);
+    memcpy(counters.name, link->sdl_data, name_len);
+    counters.name[name_len] = '\0';
+    counters.rx_bytes = info->ifm_data.ifi_ibytes;
+    counters.tx_bytes = info->ifm_data.ifi_obytes;
+    counters.rx_packets = info->ifm_data.ifi_ipackets;
+    counters.tx_packets = info->ifm_data.ifi_opackets;
+    counters.rx_errors = info->ifm_data.ifi_ierrors;
+    counters.tx_errors = info->ifm_data.ifi_oerrors;
+  }
+  return true;
+}
 
+// Statistics of every IOBlockStorageDriver, named after the whole-disk
+// IOMedia below it, as iostat reads them. IOKit has no busy time, so
+// utilization stays unknown.
+inline bool getBlockDeviceCounters(DiskIOSample& sample) {
+  sample.count = 0;
+  io_iterator_t drivers;
+  // Port 0 is the default main port on every macOS version
+  if (IOServiceGetMatchingServices(0, IOServiceMatching(kIOBlockStorageDriverClass), &drivers) !=
+      KERN_SUCCESS) {
+    return false;
+  }
+  while (io_registry_entry_t driver = IOIteratorNext(drivers)) {
+    io_registry_entry_t media = 0;
+    CFTypeRef name = nullptr;
+    CFTypeRef stats = nullptr;
+    if (sample.count < MAX_BLOCK_DEVICES &&
+        IORegistryEntryGetChildEntry(driver, kIOServicePlane, &media) == KERN_SUCCESS) {
+      name = IORegistryEntryCreateCFProperty(media, CFSTR(kIOBSDNameKey), kCFAllocatorDefault, 0);
+      stats = IORegistryEntryCreateCFProperty(driver, CFSTR(kIOBlockStorageDriverStatisticsKey),
+                                              kCFAllocatorDefault, 0);
+    }
+    if (name != nullptr && stats != nullptr && CFGetTypeID(name) == CFStringGetTypeID() &&
+        CFGetTypeID(stats) == CFDictionaryGetTypeID()) {
+      const auto dict = static_cast<CFDictionaryRef>(stats);
+      const auto number = [dict](CFStringRef key) {
+        int64_t value = 0;
+        const void* entry = CFDictionaryGetValue(dict, key);
+        if (entry != nullptr && CFGetTypeID(entry) == CFNumberGetTypeID()) {
+          CFNumberGetValue(static_cast<CFNumberRef>(entry), kCFNumberSInt64Type, &value);
+        }
+        return static_cast<uint64_t>(value);
+      };
+      BlockDeviceCounters& device = sample.devices[sample.count];
+      device = BlockDeviceCounters{};
+      CFStringGetCString(static_cast<CFStringRef>(name), device.name, sizeof(device.name),
+                         kCFStringEncodingUTF8);
+      device.reads = number(CFSTR(kIOBlockStorageDriverStatisticsReadsKey));
+      device.writes = number(CFSTR(kIOBlockStorageDriverStatisticsWritesKey));
+      device.read_bytes = number(CFSTR(kIOBlockStorageDriverStatisticsBytesReadKey));
+      device.write_bytes = number(CFSTR(kIOBlockStorageDriverStatisticsBytesWrittenKey));
+      device.read_us = number(CFSTR(kIOBlockStorageDriverStatisticsTotalReadTimeKey)) / 1000;
+      device.write_us = number(CFSTR(kIOBlockStorageDriverStatisticsTotalWriteTimeKey)) / 1000;
+      if (device.reads + device.writes > 0) {
+        ++sample.count;
+      }
+    }
+    if (name != nullptr) CFRelease(name);
+    if (stats != nullptr) CFRelease(stats);
+    if (media != 0) IOObjectRelease(media);
+    IOObjectRelease(driver);
+  }
+  IOObjectRelease(drivers);
+  return true;
+}
+
+inline long getUptimeSeconds() {
+  struct timeval boottime;
+  size_t size = sizeof(boottime);
+  if (sysctlbyname("kern.boottime", &boottime, &size, nullptr, 0) == 0 && boottime.tv_sec > 0) {
+    return static_cast<long>(time(nullptr) - boottime.tv_sec);
+  }
+  return -1;
+}
+
+// The boot time to the microsecond
+inline bool getBootID(char* buf, size_t cap) {
+  struct timeval boottime;
+  size_t size = sizeof(boottime);
+  if (sysctlbyname("kern.boottime", &boottime, &size, nullptr, 0) != 0 || boottime.tv_sec <= 0) {
+    return false;
+  }
+  snprintf(buf, cap, "%ld.%06d", static_cast<long>(boottime.tv_sec),
+           static_cast<int>(boottime.tv_usec));
+  return true;
+}
+
+inline bool getPeerUID(int fd, uid_t& uid) {
+  gid_t gid;
+  return getpeereid(fd, &uid, &gid) == 0;
+}
+
+// BSD plus Mach calls made by the whole task; macOS has no per-thread count
+constexpr long SYSCALL_PROBE_CALLS = 1;
+
+inline long getSyscallCount() {
+  task_events_info_data_t events;
+  mach_msg_type_number_t count = TASK_EVENTS_INFO_COUNT;
+  if (task_info(mach_task_self(), TASK_EVENTS_INFO, reinterpret_cast<task_info_t>(&events),
+                &count) != KERN_SUCCESS) {
+    return -1;
+  }
+  return static_cast<long>(events.syscalls_unix) + static_cast<long>(events.syscalls_mach);
+}
+
+#elif defined(__linux__)
+
+// ---- Linux backend: /proc, sysfs and statvfs, no child processes ----
+
+// Counts CPUs in a sysfs list such as "0-3,8-11"
+inline int countCPUList(const char* list) {
+  int count = 0;
+  const char* p = list;
+  while (*p >= '0' && *p <= '9') {
+    char* next;
+    const long first = strtol(p, &next, 10);
+    long last = first;
+    if (*next == '-') {
+      last = strtol(next + 1, &next, 10);
+    }
+    count += static_cast<int>(last - first + 1);
+    p = *next == ',' ? next + 1 : next;
+  }
+  return count;
+}
+
+// Expands a sysfs CPU list into CPU numbers
+inline void parseCPUList(const char* list, std::vector<int>& cpus) {
+  cpus.clear();
+  const char* p = list;
+  while (*p >= '0' && *p <= '9') {
+    char* next;
+    const long first = strtol(p, &next, 10);
+    long last = first;
+    if (*next == '-') {
+      last = strtol(next + 1, &next, 10);
+    }
+    for (long cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(static_cast<int>(cpu));
+    }
+    p = *next == ',' ? next + 1 : next;
+  }
+}
+
+// "48K" or "2048K" from a sysfs cache size file
+inline uint64_t parseCacheSize(const char* text) {
+  char* unit;
+  const uint64_t value = strtoull(text, &unit, 10);
+  return *unit == 'K' ? value << 10 : *unit == 'M' ? value << 20 : *unit == 'G' ? value << 30 : value;
+}
+
+// Core classes, caches and NUMA nodes from sysfs under root (normally
+// /sys/devices). core_of_cpu maps each logical CPU to its physical core, as
+// read from /proc/cpuinfo.
+//
+// Intel hybrid parts list their cores under cpu_core and cpu_atom; ARM
+// big.LITTLE systems rank cores by cpu_capacity instead. Caches are read
+// from the first CPU of each class only, and a cache shared across classes
+// (an L3 on a hybrid part) is told apart by its shared_cpu_list.
+inline CPUTopology readCPUTopology(const char* root, const std::vector<int>& online,
+                                   const std::vector<uint32_t>& core_of_cpu) {
+  CPUTopology topology;
+  char path[PATH_MAX];
+  char buf[4096];
+  const auto read = [&path, &buf](const char* format, auto... args) {
+    snprintf(path, sizeof(path), format, args...);
+    return readFile(path, buf, sizeof(buf)) > 0;
+  };
+  const auto distinctCores = [&core_of_cpu](const std::vector<int>& cpus) {
+    std::vector<uint32_t> cores;
+    for (const int cpu : cpus) {
+      cores.push_back(static_cast<size_t>(cpu) < core_of_cpu.size() ? core_of_cpu[cpu]
+                                                                   : 0x80000000u | cpu);
+    }
+    std::sort(cores.begin(), cores.end());
+    return static_cast<int>(std::unique(cores.begin(), cores.end()) - cores.begin());
+  };
+
+  // CPUs of each class, fastest first
+  std::vector<std::vector<int>> class_cpus;
+  std::vector<int> cpus;
+  if (read("%s/cpu_core/cpus", root)) {
+    parseCPUList(buf, cpus);
+    class_cpus.push_back(cpus);
+    if (read("%s/cpu_atom/cpus", root)) {
+      parseCPUList(buf, cpus);
+      class_cpus.push_back(cpus);
+      topology.classes = {{"performance", 0, 0}, {"efficiency", 0, 0}};
+    }
+  } else if (!online.empty() && read("%s/system/cpu/cpu%d/cpu_capacity", root, online[0])) {
+    std::vector<std::pair<long, int>> capacities;  // (capacity, cpu)
+    for (const int cpu : online) {
+      if (read("%s/system/cpu/cpu%d/cpu_capacity", root, cpu)) {
+        capacities.emplace_back(-strtol(buf, nullptr, 10), cpu);
+      }
+    }
+    std::sort(capacities.begin(), capacities.end());
+    for (size_t i = 0; i < capacities.size(); ++i) {
+      if (i == 0 || capacities[i].first != capacities[i - 1].first) class_cpus.emplace_back();
+      class_cpus.back().push_back(capacities[i].second);
+    }
+    if (class_cpus.size() > 1) {
+      for (size_t i = 0; i < class_cpus.size(); ++i) {
+        const char* name = i == 0 ? "performance"
+                           : i + 1 == class_cpus.size() ? "efficiency"
+                                                       : "balanced";
+        topology.classes.push_back({name, 0, 0});
+      }
+    }
+  }
+  if (topology.classes.empty()) {
+    class_cpus.assign(1, online);
+  }
+  for (size_t i = 0; i < topology.classes.size(); ++i) {
+    topology.classes[i].logical = static_cast<int>(class_cpus[i].size());
+    topology.classes[i].physical = distinctCores(class_cpus[i]);
+  }
+  // Hybrid parts may have SMT on one class only, so count the widest core
+  std::vector<uint32_t> cores;
+  for (const int cpu : online) {
+    if (static_cast<size_t>(cpu) < core_of_cpu.size()) cores.push_back(core_of_cpu[cpu]);
+  }
+  std::sort(cores.begin(), cores.end());
+  for (size_t i = 0, run = 1; i < cores.size(); ++i, ++run) {
+    if (i > 0 && cores[i] != cores[i - 1]) run = 1;
+    topology.threads_per_core = std::max(topology.threads_per_core, static_cast<int>(run));
+  }
+
+  std::vector<std::string> seen;  // shared_cpu_list of every cache instance counted
+  for (const std::vector<int>& members : class_cpus) {
+    if (members.empty()) continue;
+    const int cpu = members[0];
+    for (int index = 0; index < 16; ++index) {
+      CacheInfo cache;
+      if (!read("%s/system/cpu/cpu%d/cache/index%d/level", root, cpu, index)) break;
+      cache.level = atoi(buf);
+      if (read("%s/system/cpu/cpu%d/cache/index%d/type", root, cpu, index)) {
+        cache.kind = buf[0] == 'D' ? 'd' : buf[0] == 'I' ? 'i' : 'u';
+      }
+      if (!read("%s/system/cpu/cpu%d/cache/index%d/size", root, cpu, index)) continue;
+      cache.size = parseCacheSize(buf);
+      if (!read("%s/system/cpu/cpu%d/cache/index%d/shared_cpu_list", root, cpu, index)) continue;
+      buf[strcspn(buf, "\n")] = '\0';
+      const std::string shared = std::to_string(cache.level) + cache.kind + buf;
+      if (std::find(seen.begin(), seen.end(), shared) != seen.end()) continue;
+      seen.push_back(shared);
+      cache.shared_by = std::max(1, countCPUList(buf));
+      cache.instances = std::max<int>(1, (static_cast<int>(members.size()) + cache.shared_by - 1) /
+                                             cache.shared_by);
+      addCache(topology.caches, cache);
+    }
+  }
+
+  snprintf(path, sizeof(path), "%s/system/node", root);
+  if (DIR* dir = opendir(path)) {
+    while (const struct dirent* entry = readdir(dir)) {
+      if (!startsWith(entry->d_name, "node") || entry->d_name[4] < '0' || entry->d_name[4] > '9') {
+        continue;
+      }
+      NumaNode node;
+      node.id = atoi(entry->d_name + 4);
+      if (read("%s/system/node/%s/cpulist", root, entry->d_name)) {
+        buf[strcspn(buf, "\n")] = '\0';
+        node.cpus = buf;
+      }
+      topology.numa.push_back(std::move(node));
+    }
+    closedir(dir);
+    std::sort(topology.numa.begin(), topology.numa.end(),
+              [](const NumaNode& a, const NumaNode& b) { return a.id < b.id; });
+  }
+  return topology;
+}
+
+inline std::string getOSName() {
+  char buf[4096];
+  if (readFile("/etc/os-release", buf, sizeof(buf)) > 0 ||
+      readFile("/usr/lib/os-release", buf, sizeof(buf)) > 0) {
+    char* save;
+    for (char* line = strtok_r(buf, "\n", &save); line; line = strtok_r(nullptr, "\n", &save)) {
+      if (startsWith(line, "PRETTY_NAME=")) {
+        std::string name(line + 12);
+        if (name.size() >= 2 && (name.front() == '"' || name.front() == '\'')) {
+          name = name.substr(1, name.size() - 2);
+        }
+        if (!name.empty()) {
+          return name;
+        }
+      }
+    }
+  }
+  return "Linux";
+}
+
+inline std::string getKernelVersion() {
+  struct utsname uts;
+  if (uname(&uts) == 0) {
+    return std::string(uts.sysname) + " " + uts.release;
+  }
+  return "unknown";
+}
+
+inline CPUInfo getCPUInfo() {
+  CPUInfo info;
+  info.model = "Unknown CPU";
+
+  // Physical cores are the distinct (physical id, core id) pairs; ARM kernels
+  // omit both, in which case every logical CPU counts as a core.
+  std::vector<uint32_t> cores;
+  std::vector<uint32_t> packages;
+  std::vector<uint32_t> core_of_cpu;  // by processor number, for the topology
+  bool have_model = false;
+  long processor = -1;
+  long physical_id = -1;
+  {
+    LineReader reader("/proc/cpuinfo");
+    char* line;
+    size_t len;
+    while (reader.next(line, len)) {
+      if (!have_model && (startsWith(line, "model name") || startsWith(line, "Hardware"))) {
+        const char* value = procValue(line);
+        if (*value != '\0') {
+          info.model = value;
+          have_model = true;
+        }
+      } else if (startsWith(line, "processor")) {
+        processor = strtol(procValue(line), nullptr, 10);
+      } else if (startsWith(line, "physical id")) {
+        physical_id = strtol(procValue(line), nullptr, 10);
+        packages.push_back(static_cast<uint32_t>(physical_id));
+      } else if (startsWith(line, "core id") && physical_id >= 0) {
+        const long core_id = strtol(procValue(line), nullptr, 10);
+        cores.push_back(static_cast<uint32_t>(physical_id << 16 | core_id));
+        if (processor >= 0 && processor < 65536) {
+          core_of_cpu.resize(std::max<size_t>(core_of_cpu.size(), processor + 1), 0xffffffffu);
+          core_of_cpu[processor] = cores.back();
+        }
+      }
+    }
+  }
+  std::sort(cores.begin(), cores.end());
+  std::sort(packages.begin(), packages.end());
+
+  char buf[256];
+  std::vector<int> online;
+  if (readFile("/sys/devices/system/cpu/online", buf, sizeof(buf)) > 0) {
+    info.cores_logical = countCPUList(buf);
+    parseCPUList(buf, online);
+  } else {
+    info.cores_logical = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+    for (int cpu = 0; cpu < info.cores_logical; ++cpu) online.push_back(cpu);
+  }
+  info.cores_physical = cores.empty()
+      ? info.cores_logical
+      : static_cast<int>(std::unique(cores.begin(), cores.end()) - cores.begin());
+  info.sockets = packages.empty()
+      ? 1
+      : static_cast<int>(std::unique(packages.begin(), packages.end()) - packages.begin());
+  // Without core ids every CPU is its own core
+  for (size_t cpu = 0; cpu < core_of_cpu.size(); ++cpu) {
+    if (core_of_cpu[cpu] == 0xffffffffu) core_of_cpu[cpu] = 0x80000000u | static_cast<uint32_t>(cpu);
+  }
+  info.topology = readCPUTopology("/sys/devices", online, core_of_cpu);
+
+  info.load_1 = info.load_5 = info.load_15 = 0.0;
+  return info;
+}
+
+// SMBIOS strings the kernel exports to unprivileged readers, the same ones
+// dmidecode would print
+enum class DMIField : uint8_t { SysVendor, ProductName, BiosVendor, BiosVersion, ChassisAssetTag, Count };
+
+constexpr const char* DMI_FILES[] = {"sys_vendor", "product_name", "bios_vendor", "bios_version",
+                                     "chassis_asset_tag"};
+
+// Firmware strings that give the platform away. The first rule that matches
+// and names a cloud names it; the first that names a hypervisor stands in
+// for CPUID where there is none.
+struct PlatformRule {
+  DMIField field;
+  const char* match;       // substring of the field
+  const char* hypervisor;
+  const char* cloud;       // "" for a hypervisor on its own
+  bool names_instance;     // product_name is the instance type
+};
+
+constexpr PlatformRule PLATFORM_RULES[] = {
+    {DMIField::SysVendor, "Amazon EC2", "kvm", "aws", true},
+    {DMIField::BiosVersion, "amazon", "xen", "aws", false},
+    {DMIField::ProductName, "Google Compute Engine", "kvm", "gcp", false},
+    {DMIField::ChassisAssetTag, "7783-7084-3265-9085-8269-3286-77", "hyper-v", "azure", false},
+    {DMIField::ChassisAssetTag, "OracleCloud.com", "kvm", "oci", false},
+    {DMIField::SysVendor, "DigitalOcean", "kvm", "digitalocean", false},
+    {DMIField::SysVendor, "Hetzner", "kvm", "hetzner", false},
+    {DMIField::SysVendor, "Alibaba Cloud", "kvm", "alibaba", false},
+    {DMIField::SysVendor, "Tencent Cloud", "kvm", "tencent", false},
+    {DMIField::SysVendor, "Linode", "kvm", "linode", false},
+    {DMIField::SysVendor, "Vultr", "kvm", "vultr", false},
+    {DMIField::SysVendor, "Scaleway", "kvm", "scaleway", false},
+    {DMIField::ProductName, "OpenStack", "kvm", "openstack", false},
+    {DMIField::SysVendor, "QEMU", "qemu", "", false},
+    {DMIField::ProductName, "KVM", "kvm", "", false},
+    {DMIField::SysVendor, "VMware", "vmware", "", false},
+    {DMIField::SysVendor, "innotek GmbH", "virtualbox", "", false},
+    {DMIField::SysVendor, "Xen", "xen", "", false},
+    {DMIField::ProductName, "Virtual Machine", "hyper-v", "", false},
+    {DMIField::SysVendor, "Parallels", "parallels", "", false},
+    {DMIField::BiosVendor, "BHYVE", "bhyve", "", false},
+    {DMIField::ProductName, "Apple Virtualization", "apple", "", false},
+};
+
+// Names the platform from a CPUID hypervisor name (nullptr on CPUs without
+// the leaf), the DMI strings in dmi_dir and the Xen type in hypervisor_dir.
+// Takes the directories so fixtures can stand in for them. CPUID is trusted
+// over the firmware, which clouds also fill in on their bare-metal hosts.
+inline PlatformInfo detectPlatform(const char* cpuid_hypervisor, const char* dmi_dir,
+                                   const char* hypervisor_dir) {
+  constexpr size_t FIELDS = static_cast<size_t>(DMIField::Count);
+  char fields[FIELDS][128];
+  char path[256];
+  for (size_t i = 0; i < FIELDS; ++i) {
+    snprintf(path, sizeof(path), "%s/%s", dmi_dir, DMI_FILES[i]);
+    ssize_t len = readFile(path, fields[i], sizeof(fields[i]));
+    if (len < 0) len = 0;
+    while (len > 0 && static_cast<unsigned char>(fields[i][len - 1]) <= ' ') --len;
+    fields[i][len] = '\0';
+  }
+
+  PlatformInfo info;
+  const char* firmware_hypervisor = "";
+  for (const PlatformRule& rule : PLATFORM_RULES) {
+    const char* field = fields[static_cast<size_t>(rule.field)];
+    if (strstr(field, rule.match) == nullptr) continue;
+    if (*firmware_hypervisor == '\0') firmware_hypervisor = rule.hypervisor;
+    if (info.cloud.empty() && *rule.cloud != '\0') {
+      info.cloud = rule.cloud;
+      if (rule.names_instance) info.instance = fields[static_cast<size_t>(DMIField::ProductName)];
+    }
+  }
+
+  // EC2 names its bare-metal instance types "<family>.metal"
+  const bool metal = info.instance.size() > 6 &&
+                     info.instance.compare(info.instance.size() - 6, 6, ".metal") == 0;
+  if (cpuid_hypervisor != nullptr) {
+    info.hypervisor = cpuid_hypervisor;
+  } else if (!metal) {
+    info.hypervisor = firmware_hypervisor;
+  }
+  // Xen paravirtualized guests may not see the CPUID leaf
+  if (info.hypervisor.empty()) {
+    char type[16];
+    snprintf(path, sizeof(path), "%s/type", hypervisor_dir);
+    if (readFile(path, type, sizeof(type)) > 0 && startsWith(type, "xen")) {
+      info.hypervisor = "xen";
+    }
+  }
+  return info;
+}
+
+inline PlatformInfo getPlatformInfo() {
+#if defined(MACHINE_REPORT_TEST_HOOKS)
+  // Test builds only: MACHINE_REPORT_SYSFS_ROOT=<dir> stands in for /sys,
+  // with <dir>/cpuid_hypervisor holding the CPUID name (absent: no leaf)
+  if (const char* root = getenv("MACHINE_REPORT_SYSFS_ROOT")) {
+    const std::string dir = root;
+    char cpuid[32];
+    ssize_t len = readFile((dir + "/cpuid_hypervisor").c_str(), cpuid, sizeof(cpuid));
+    while (len > 0 && static_cast<unsigned char>(cpuid[len - 1]) <= ' ') cpuid[--len] = '\0';
+    return detectPlatform(len >= 0 ? cpuid : nullptr, (dir + "/class/dmi/id").c_str(),
+                          (dir + "/hypervisor").c_str());
+  }
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+  const std::string cpuid = cpuidHypervisor();
+  return detectPlatform(cpuid.c_str(), "/sys/class/dmi/id", "/sys/hypervisor");
+#else
+  return detectPlatform(nullptr, "/sys/class/dmi/id", "/sys/hypervisor");
+#endif
+}
+
+inline void getLoadAverages(CPUInfo& info) {
+  char buf[128];
+  if (readFile("/proc/loadavg", buf, sizeof(buf)) > 0) {
+    char* p = buf;
+    info.load_1 = strtod(p, &p);
+    info.load_5 = strtod(p, &p);
+    info.load_15 = strtod(p, &p);
+  } else {
+    info.load_1 = info.load_5 = info.load_15 = 0.0;
+  }
+}
+
+// Parses the "cpu" and "cpuN" lines of /proc/stat. Guest time is already
+// included in user and nice, so it is not added again.
+inline bool getCPUTicks(CPUSample& sample) {
+  LineReader reader("/proc/stat");
+  char* line;
+  size_t len;
+  size_t count = 0;
+  bool have_total = false;
+  while (reader.next(line, len) && startsWith(line, "cpu")) {
+    char* p = line + 3;
+    const bool is_total = *p == ' ';
+    if (!is_total) {
+      strtoul(p, &p, 10);  // skip the CPU number
+    }
+    CPUTicks ticks;
+    ticks.user = strtoull(p, &p, 10);
+    ticks.nice = strtoull(p, &p, 10);
+    ticks.system = strtoull(p, &p, 10);
+    ticks.idle = strtoull(p, &p, 10);
+    ticks.iowait = strtoull(p, &p, 10);
+    ticks.irq = strtoull(p, &p, 10);
+    ticks.softirq = strtoull(p, &p, 10);
+    ticks.steal = strtoull(p, &p, 10);
+    if (is_total) {
+      sample.total = ticks;
+      have_total = true;
+    } else {
+      if (count == sample.cores.size()) sample.cores.emplace_back();
+      sample.cores[count++] = ticks;
+    }
+  }
+  sample.cores.resize(count);
+  return have_total;
+}
+
+// Counts as free(1) does: used is MemTotal minus MemAvailable, the kernel's
+// estimate of what can be handed out without swapping. Linux has no wired
+// count; the nearest is memory that can neither be reclaimed nor swapped:
+// unevictable pages plus unreclaimable slab, kernel stacks and page tables.
+// Memory pressure lives in PSI, reported by the pressure collector.
+inline MemInfo getMemInfo() {
+  MemInfo info;
+  char buf[4096];
+  if (readFile("/proc/meminfo", buf, sizeof(buf)) <= 0) {
+    return info;
+  }
+  enum Field {
+    Total, Free, Available, Buffers, Cached, Active, Inactive, ActiveFile, InactiveFile,
+    Unevictable, SwapTotal, SwapFree, Zswap, KReclaimable, SUnreclaim, KernelStack, PageTables,
+    FieldCount
+  };
+  static constexpr const char* KEYS[FieldCount] = {
+      "MemTotal:", "MemFree:", "MemAvailable:", "Buffers:", "Cached:", "Active:", "Inactive:",
+      "Active(file):", "Inactive(file):", "Unevictable:", "SwapTotal:", "SwapFree:", "Zswap:",
+      "KReclaimable:", "SUnreclaim:", "KernelStack:", "PageTables:"};
+  uint64_t kb[FieldCount] = {};
+  bool have_available = false;
+  char* save;
+  for (char* line = strtok_r(buf, "\n", &save); line; line = strtok_r(nullptr, "\n", &save)) {
+    for (int field = 0; field < FieldCount; ++field) {
+      const size_t key_len = strlen(KEYS[field]);
+      if (strncmp(line, KEYS[field], key_len) == 0) {
+        kb[field] = strtoull(line + key_len, nullptr, 10);
+        have_available |= field == Available;
+        break;
+      }
+    }
+  }
+  if (kb[Total] == 0) {
+    return info;
+  }
+  // Kernels before 3.14 have no MemAvailable
+  const uint64_t available_kb =
+      have_available ? kb[Available] : kb[Free] + kb[Buffers] + kb[Cached];
+  info.total = kb[Total] * 1024;
+  info.available = std::min(available_kb, kb[Total]) * 1024;
+  info.used = info.total - info.available;
+  info.percent = static_cast<double>(info.used) / static_cast<double>(info.total) * 100.0;
+  info.wired = (kb[Unevictable] + kb[SUnreclaim] + kb[KernelStack] + kb[PageTables]) * 1024;
+  info.active = kb[Active] * 1024;
+  info.inactive = kb[Inactive] * 1024;
+  info.compressed = kb[Zswap] * 1024;
+  info.purgeable = kb[KReclaimable] * 1024;
+  info.file_backed = (kb[ActiveFile] + kb[InactiveFile]) * 1024;
+  info.swap_total = kb[SwapTotal] * 1024;
+  info.swap_used = (kb[SwapTotal] - std::min(kb[SwapFree], kb[SwapTotal])) * 1024;
+  return info;
+}
+
+// One PSI file, /proc/pressure/<resource> or <cgroup>/<resource>.pressure:
+//   some avg10=0.12 avg60=0.05 avg300=0.01 total=123456
+//   full avg10=0.00 avg60=0.00 avg300=0.00 total=0
+// Kernels before 5.13 have no "full" line for cpu.
+inline bool readStallAverages(const char* path, StallAverages& stall) {
+  stall = StallAverages{};
+  char buf[256];
+  if (readFile(path, buf, sizeof(buf)) <= 0) {
+    return false;
+  }
+  char* save;
+  for (char* line = strtok_r(buf, "\n", &save); line; line = strtok_r(nullptr, "\n", &save)) {
+    double* averages = startsWith(line, "some ") ? stall.some
+                       : startsWith(line, "full ") ? stall.full
+                                                   : nullptr;
+    if (averages == nullptr) continue;
+    char* p = line;
+    for (int i = 0; i < 3; ++i) {
+      p = strchr(p, '=');
+      if (p == nullptr) break;
+      averages[i] = strtod(p + 1, &p);
+    }
+  }
+  stall.present = true;
+  return true;
+}
+
+// Reads the controller files of one cgroup v2 directory. A controller that
+// is not enabled for the cgroup has no files and leaves its fields unset.
+inline bool readCgroup(const char* dir, CgroupInfo& info) {
+  char path[PATH_MAX];
+  char buf[512];
+  const auto read = [&](const char* file) {
+    snprintf(path, sizeof(path), "%s/%s", dir, file);
+    return readFile(path, buf, sizeof(buf)) > 0;
+  };
+
+  // cpu.max and memory.max exist in every cgroup but the root
+  bool limited = false;
+  if (read("cpu.max")) {  // "<quota> <period>" or "max <period>"
+    limited = true;
+    char* end;
+    const double quota = strtod(buf, &end);
+    const double period = end != buf ? strtod(end, nullptr) : 0.0;
+    info.cpu_limit = end != buf && period > 0.0 ? quota / period : -1.0;
+  }
+  if (read("memory.max")) {
+    limited = true;
+    info.memory_max = strtoull(buf, nullptr, 10);  // "max" reads as 0
+  }
+  if (!limited) {
+    return false;
+  }
+  if (read("memory.current")) {
+    info.memory_current = strtoull(buf, nullptr, 10);
+  }
+  if (read("cpu.stat")) {
+    char* save;
+    for (char* line = strtok_r(buf, "\n", &save); line; line = strtok_r(nullptr, "\n", &save)) {
+      char* value = strchr(line, ' ');
+      if (value == nullptr) continue;
+      *value++ = '\0';
+      if (strcmp(line, "usage_usec") == 0) {
+        info.cpu_usage_usec = strtoull(value, nullptr, 10);
+      } else if (strcmp(line, "nr_periods") == 0) {
+        info.cpu_periods = strtoull(value, nullptr, 10);
+      } else if (strcmp(line, "nr_throttled") == 0) {
+        info.cpu_throttled_periods = strtoull(value, nullptr, 10);
+      } else if (strcmp(line, "throttled_usec") == 0) {
+        info.cpu_throttled_usec = strtoull(value, nullptr, 10);
+      }
+    }
+  }
+
+  // io.stat has one line per device, so it is streamed:
+  //   259:0 rbytes=4096 wbytes=0 rios=1 wios=0 dbytes=0 dios=0
+  snprintf(path, sizeof(path), "%s/io.stat", dir);
+  LineReader reader(path);
+  char* line;
+  size_t len;
+  while (reader.next(line, len)) {
+    for (char* field = strchr(line, ' '); field != nullptr; field = strchr(field, ' ')) {
+      ++field;
+      const char* equals = strchr(field, '=');
+      if (equals == nullptr) break;
+      const uint64_t value = strtoull(equals + 1, nullptr, 10);
+      if (startsWith(field, "rbytes=")) {
+        info.io_read_bytes += value;
+      } else if (startsWith(field, "wbytes=")) {
+        info.io_write_bytes += value;
+      } else if (startsWith(field, "rios=")) {
+        info.io_read_ops += value;
+      } else if (startsWith(field, "wios=")) {
+        info.io_write_ops += value;
+      }
+    }
+  }
+
+  snprintf(path, sizeof(path), "%s/cpu.pressure", dir);
+  readStallAverages(path, info.pressure.cpu);
+  snprintf(path, sizeof(path), "%s/memory.pressure", dir);
+  readStallAverages(path, info.pressure.memory);
+  snprintf(path, sizeof(path), "%s/io.pressure", dir);
+  readStallAverages(path, info.pressure.io);
+  info.present = true;
+  return true;
+}
+
+// Host stalls from /proc/pressure, plus the cgroup v2 this process belongs
+// to ("0::<path>" in /proc/self/cgroup). The hierarchy is mounted at
+// /sys/fs/cgroup, or at /sys/fs/cgroup/unified next to the v1 controllers.
+// Inside a container's cgroup namespace the path is "/" and the mount shows
+// the container's own cgroup, whose limit files then make it count.
+inline void getResourcePressure(PressureInfo& host, CgroupInfo& cgroup) {
+  readStallAverages("/proc/pressure/cpu", host.cpu);
+  readStallAverages("/proc/pressure/memory", host.memory);
+  readStallAverages("/proc/pressure/io", host.io);
+
+  cgroup = CgroupInfo{};
+  char buf[1024];
+  if (readFile("/proc/self/cgroup", buf, sizeof(buf)) <= 0) {
+    return;
+  }
+  char* save;
+  for (char* line = strtok_r(buf, "\n", &save); line; line = strtok_r(nullptr, "\n", &save)) {
+    if (!startsWith(line, "0::")) continue;
+    const char* mount = access("/sys/fs/cgroup/cgroup.controllers", F_OK) == 0
+        ? "/sys/fs/cgroup"
+        : "/sys/fs/cgroup/unified";
+    char dir[PATH_MAX];
+    snprintf(dir, sizeof(dir), "%s%s", mount, line + 3);
+    if (readCgroup(dir, cgroup)) {
+      cgroup.path = line + 3;
+    }
+    break;
+  }
+}
+
+constexpr const char* DEFAULT_FS_TYPES =
+    "ext2,ext3,ext4,xfs,btrfs,zfs,f2fs,bcachefs,jfs,reiserfs,vfat,exfat,ntfs,ntfs3,fuseblk,"
+    "nfs,nfs4,cifs,smb3,ceph";
+
+// Next space-separated field of a mountinfo line, NUL-terminated in place
+inline char* nextField(char*& p) {
+  char* field = p;
+  while (*p != '\0' && *p != ' ') ++p;
+  if (*p == ' ') *p++ = '\0';
+  return field;
+}
+
+// Mount points escape space, tab, newline and backslash as \ooo
+inline void unescapeMountPath(char* path) {
+  char* out = path;
+  for (const char* in = path; *in != '\0'; ++out) {
+    if (in[0] == '\\' && in[1] >= '0' && in[1] <= '3' && in[2] >= '0' && in[2] <= '7' &&
+        in[3] >= '0' && in[3] <= '7') {
+      *out = static_cast<char>((in[1] - '0') << 6 | (in[2] - '0') << 3 | (in[3] - '0'));
+      in += 4;
+    } else {
+      *out = *in++;
+    }
+  }
+  *out = '\0';
+}
+
+// Writable mounts whose type is in fs_types, one per device, in mount order.
+// A line is only split and copied once its type and options have passed, so
+// the hundreds of overlay, tmpfs and cgroup mounts of a container host cost
+// one substring search and a few compares each.
+inline void readMountInfo(const char* path, const char* fs_types,
+                          std::vector<VolumeCandidate>& volumes) {
+  LineReader reader(path);
+  char* line;
+  size_t len;
+  while (reader.next(line, len)) {
+    // id parent major:minor root mount options [optional...] - type source super
+    char* dash = strstr(line, " - ");
+    if (dash == nullptr) continue;
+    char* type = dash + 3;
+    char* type_end = strchr(type, ' ');
+    const size_t type_len = type_end != nullptr ? static_cast<size_t>(type_end - type) : strlen(type);
+    if (!listContains(fs_types, type, type_len)) continue;
+
+    char* p = line;
+    nextField(p);  // mount ID
+    nextField(p);  // parent ID
+    const char* device = nextField(p);
+    nextField(p);  // root of the mount within the filesystem
+    char* mount = nextField(p);
+    const char* options = nextField(p);
+    if (strcmp(options, "ro") == 0 || startsWith(options, "ro,")) continue;
+
+    char* minor;
+    const uint64_t major = strtoull(device, &minor, 10);
+    if (*minor != ':') continue;
+    if (type_end != nullptr) *type_end = '\0';
+    unescapeMountPath(mount);
+    addVolume(volumes, major << 32 | strtoull(minor + 1, nullptr, 10), mount, type);
+  }
+}
+
+// Type of the filesystem mounted last at /, such as overlay in a container
+inline std::string rootFsType(const char* path) {
+  std::string fstype;
+  LineReader reader(path);
+  char* line;
+  size_t len;
+  while (reader.next(line, len)) {
+    char* dash = strstr(line, " - ");
+    if (dash == nullptr) continue;
+    char* p = line;
+    for (int field = 0; field < 4; ++field) nextField(p);
+    if (strcmp(nextField(p), "/") != 0) continue;
+    const char* type = dash + 3;
+    const char* type_end = strchr(type, ' ');
+    fstype.assign(type, type_end != nullptr ? static_cast<size_t>(type_end - type) : strlen(type));
+  }
+  return fstype;
+}
+
+// Filesystems whose statvfs() waits on a server, and how long one report
+// waits for all of them together
+constexpr const char* NETWORK_FS_TYPES = "nfs,nfs4,cifs,smb3,ceph";
+constexpr int NETWORK_STATVFS_MS = 150;
+
+// statvfs() of a network mount on a detached thread. A hung server can keep
+// that thread in the kernel for good; the report drops the mount's row
+// rather than waiting for it, and later reports skip the mount, instead of
+// starting another thread, until the call returns. The thread inherits the
+// collector's blocked stop signals.
+struct NetworkStatvfs {
+  std::mutex mutex;
+  std::condition_variable done;
+  bool finished = false;
+  bool ok = false;
+  struct statvfs fs;
+};
+
+// Starts the call, or returns null while an earlier one for the same mount
+// is still stuck
+inline std::shared_ptr<NetworkStatvfs> startNetworkStatvfs(const std::string& mount) {
+  static std::mutex mutex;
+  static std::vector<std::pair<std::string, std::shared_ptr<NetworkStatvfs>>> calls;
+  auto call = std::make_shared<NetworkStatvfs>();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = std::find_if(calls.begin(), calls.end(),
+                           [&mount](const auto& entry) { return entry.first == mount; });
+    if (it != calls.end()) {
+      std::lock_guard<std::mutex> call_lock(it->second->mutex);
+      if (!it->second->finished) return nullptr;
+      it->second = call;
+    } else {
+      calls.emplace_back(mount, call);
+    }
+  }
+  std::thread([call, mount] {
+#if defined(MACHINE_REPORT_TEST_HOOKS)
+    stallForTest("statvfs");
+#endif
+    struct statvfs fs;
+    const bool ok = statvfs(mount.c_str(), &fs) == 0;
+    std::lock_guard<std::mutex> lock(call->mutex);
+    call->fs = fs;
+    call->ok = ok;
+    call->finished = true;
+    call->done.notify_all();
+  }).detach();
+  return call;
+}
+
+// Every writable volume whose type is in fs_types: one pass over mountinfo,
+// then one statvfs() per distinct device. Network mounts are measured on
+// their own threads, so a hung share loses only its own row.
+inline std::vector<DiskInfo> getDisks(const char* fs_types,
+                                      const char* mountinfo = "/proc/self/mountinfo") {
+  std::vector<VolumeCandidate> volumes;
+  readMountInfo(mountinfo, fs_types, volumes);
+
+  std::vector<std::shared_ptr<NetworkStatvfs>> network(volumes.size());
+  std::vector<bool> skipped(volumes.size());
+  for (size_t i = 0; i < volumes.size(); ++i) {
+    const std::string& type = volumes[i].fstype;
+    if (listContains(NETWORK_FS_TYPES, type.data(), type.size())) {
+      network[i] = startNetworkStatvfs(volumes[i].mount);
+      skipped[i] = network[i] == nullptr;
+    }
+  }
+
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(NETWORK_STATVFS_MS);
+  std::vector<DiskInfo> disks;
+  struct statvfs fs;
+  for (size_t i = 0; i < volumes.size(); ++i) {
+    bool measured = false;
+    if (network[i] != nullptr) {
+      NetworkStatvfs& call = *network[i];
+      std::unique_lock<std::mutex> lock(call.mutex);
+      if (call.done.wait_until(lock, deadline, [&call] { return call.finished; }) && call.ok) {
+        fs = call.fs;
+        measured = true;
+      }
+    } else if (!skipped[i]) {
+      measured = statvfs(volumes[i].mount.c_str(), &fs) == 0;
+    }
+    DiskInfo info;
+    if (measured && measureVolume(info, fs.f_blocks, fs.f_bavail, fs.f_frsize)) {
+      info.mount = std::move(volumes[i].mount);
+      info.fstype = std::move(volumes[i].fstype);
+      disks.push_back(std::move(info));
+    }
+  }
+  // Containers whose root is an overlay still get a row for /
+  if (disks.empty()) {
+    DiskInfo info;
+    if (statvfs("/", &fs) == 0 && measureVolume(info, fs.f_blocks, fs.f_bavail, fs.f_frsize)) {
+      info.mount = "/";
+      info.fstype = rootFsType(mountinfo);
+      disks.push_back(std::move(info));
+    }
+  }
+  return disks;
+}
+
+// Finds the newest login in a wtmp file. wtmp is an array of fixed-size
+// utmpx records appended in time order, so scanning the mapping backwards
+// stops at the first USER_PROCESS, normally within the last few records, no
+// matter how large the file has grown. A torn trailing record is ignored.
+inline bool readLastLogin(const char* path, LoginInfo& info) {
+  const int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(struct utmpx))) {
+    close(fd);
+    return false;
+  }
+  const size_t map_size = static_cast<size_t>(st.st_size);
+  void* map = mmap(nullptr, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    return false;
+  }
+
+  const struct utmpx* records = static_cast<const struct utmpx*>(map);
+  bool found = false;
+  for (size_t i = map_size / sizeof(struct utmpx); i-- > 0;) {
+    const struct utmpx& entry = records[i];
+    if (entry.ut_type != USER_PROCESS || entry.ut_user[0] == '\0') continue;
+    fillLoginInfo(entry, info);
+    // Prefer the binary address over ut_host, which may hold a DNS name
+    const int32_t* addr = entry.ut_addr_v6;
+    char ip_str[INET6_ADDRSTRLEN];
+    if (addr[0] != 0 && addr[1] == 0 && addr[2] == 0 && addr[3] == 0) {
+      if (inet_ntop(AF_INET, addr, ip_str, sizeof(ip_str)) != nullptr) info.ip = ip_str;
+    } else if ((addr[0] | addr[1] | addr[2] | addr[3]) != 0) {
+      if (inet_ntop(AF_INET6, addr, ip_str, sizeof(ip_str)) != nullptr) info.ip = ip_str;
+    }
+    info.ip_present = !info.ip.empty();
+    found = true;
+    break;
+  }
+  munmap(map, map_size);
+  return found;
+}
+
+inline LoginInfo getLastLogin() {
+  LoginInfo info;
+  info.timestamp = 0;
+  info.time = "N/A";
+  info.ip_present = false;
+  readLastLogin("/var/log/wtmp", info);
+  return info;
+}
+
+// Every numeric entry of /proc. readdir walks the pid hash in order, so the
+// list normally comes out ascending already; anything mounted over /proc,
+// such as benchmark.sh's synthetic tree, is sorted.
+inline bool listProcesses(std::vector<int>& pids) {
+  pids.clear();
+  DIR* dir = opendir("/proc");
+  if (dir == nullptr) {
+    return false;
+  }
+  while (const struct dirent* entry = readdir(dir)) {
+    if (entry->d_name[0] >= '1' && entry->d_name[0] <= '9') {
+      pids.push_back(atoi(entry->d_name));
+    }
+  }
+  closedir(dir);
+  if (!std::is_sorted(pids.begin(), pids.end())) {
+    std::sort(pids.begin(), pids.end());
+  }
+  return true;
+}
+
+// Stat descriptors kept open between process scans. The first call raises
+// the soft descriptor limit to the hard one; 256 descriptors are left for
+// everything else, and processes past that are opened on every scan.
+std::atomic<long> g_process_fds{0};
+
+inline bool reserveProcessFd() {
+  static const long budget = [] {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0) {
+      return 0L;
+    }
+    const rlim_t wanted = std::min<rlim_t>(limit.rlim_max, 1 << 20);
+    if (limit.rlim_cur < wanted) {
+      const rlim_t previous = limit.rlim_cur;
+      limit.rlim_cur = wanted;
+      if (setrlimit(RLIMIT_NOFILE, &limit) != 0) limit.rlim_cur = previous;
+    }
+    return static_cast<long>(std::min<rlim_t>(limit.rlim_cur, 1 << 20)) - 256;
+  }();
+  if (g_process_fds.fetch_add(1) < budget) {
+    return true;
+  }
+  g_process_fds.fetch_sub(1);
+  return false;
+}
+
+inline void closeProcessFd(int& fd) {
+  if (fd >= 0) {
+    close(fd);
+    g_process_fds.fetch_sub(1);
+    fd = -1;
+  }
+}
+
+// Reads only the fields the process section needs from /proc/<pid>/stat
+// into a stack buffer. A process seen for the first time costs an openat
+// relative to a /proc descriptor opened once and a read, and its descriptor
+// is kept in fd while the budget lasts, so every later scan is one pread. A
+// kept descriptor stops reading once its process has exited, and is then
+// replaced in case the pid has been reused.
+inline bool readProcess(int pid, int& fd, ProcessSample& sample) {
+  static const int proc_fd = open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  static const uint64_t ns_per_tick = 1000000000ull / static_cast<uint64_t>(sysconf(_SC_CLK_TCK));
+  static const uint64_t page_size = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+  char buf[512];
+  ssize_t n = fd >= 0 ? pread(fd, buf, sizeof(buf) - 1, 0) : -1;
+  if (n <= 0) {
+    closeProcessFd(fd);
+    char path[24];
+    snprintf(path, sizeof(path), "%d/stat", pid);
+    const int opened = openat(proc_fd, path, O_RDONLY | O_CLOEXEC);
+    if (opened < 0) {
+      return false;  // exited since it was listed
+    }
+    n = read(opened, buf, sizeof(buf) - 1);
+    if (n > 0 && reserveProcessFd()) {
+      fd = opened;
+    } else {
+      close(opened);
+    }
+    if (n <= 0) {
+      return false;
+    }
+  }
+  buf[n] = '\0';
+
+  // "pid (name) state ppid ... utime stime cutime ... starttime vsize rss";
+  // the name may itself contain spaces and parentheses
+  const char* open_paren = strchr(buf, '(');
+  const char* close_paren = strrchr(buf, ')');
+  if (open_paren == nullptr || close_paren == nullptr || close_paren < open_paren) {
+    return false;
+  }
+  sample.pid = pid;
+  const size_t name_len = std::min<size_t>(close_paren - open_paren - 1, sizeof(sample.name) - 1);
+  memcpy(sample.name, open_paren + 1, name_len);
+  sample.name[name_len] = '\0';
+
+  const auto skip = [](const char* p, int fields) {
+    for (; fields > 0 && *p != '\0'; --fields) {
+      while (*p != ' ' && *p != '\0') ++p;
+      if (*p == ' ') ++p;
+    }
+    return p;
+  };
+  char* end;
+  const char* p = skip(close_paren + 2, 11);  // state through cmajflt
+  const uint64_t utime = strtoull(p, &end, 10);
+  const uint64_t stime = strtoull(end, &end, 10);
+  p = skip(end + (*end == ' ' ? 1 : 0), 6);  // cutime through itrealvalue
+  sample.start = strtoull(p, &end, 10);
+  strtoull(end, &end, 10);  // vsize
+  sample.rss = strtoull(end, &end, 10) * page_size;
+  sample.cpu_ns = (utime + stime) * ns_per_tick;
+  return true;
+}
+
+// Counters of every interface except loopback from /proc/net/dev, streamed
+// through the stack buffer of a LineReader
+inline bool getInterfaceCounters(NetSample& sample) {
+  sample.count = 0;
+  LineReader reader("/proc/net/dev");
+  if (reader.fd < 0) {
+    return false;
+  }
+  char* line;
+  size_t len;
+  // "  eth0: rx_bytes rx_packets rx_errs drop fifo frame compressed multicast
+  //          tx_bytes tx_packets tx_errs ..." after two header lines
+  while (sample.count < MAX_INTERFACES && reader.next(line, len)) {
+    char* colon = strchr(line, ':');
+    if (colon == nullptr) continue;
+    *colon = '\0';
+    const char* name = line;
+    while (*name == ' ') ++name;
+    if (strcmp(name, "lo") == 0) continue;
+
+    uint64_t fields[11];
+    char* p = colon + 1;
+    for (uint64_t& field : fields) {
+      field = strtoull(p, &p, 10);
+    }
+    InterfaceCounters& counters = sample.interfaces[sample.count++];
+    snprintf(counters.name, sizeof(counters.name), "%s", name);
+    counters.rx_bytes = fields[0];
+    counters.rx_packets = fields[1];
+    counters.rx_errors = fields[2];
+    counters.tx_bytes = fields[8];
+    counters.tx_packets = fields[9];
+    counters.tx_errors = fields[10];
+  }
+  return true;
+}
+
+// Whether name is a partition of disk, by the kernel's partition naming:
+// the disk name and the partition number, with a "p" in between when the
+// disk name ends in a digit (sda1, nvme0n1p1, md0p1)
+inline bool isPartitionOf(const char* name, const char* disk) {
+  const size_t len = strlen(disk);
+  if (len == 0 || strncmp(name, disk, len) != 0) {
+    return false;
+  }
+  const char* suffix = name + len;
+  if (disk[len - 1] >= '0' && disk[len - 1] <= '9') {
+    if (*suffix != 'p') return false;
+    ++suffix;
+  }
+  if (*suffix == '\0') {
+    return false;
+  }
+  for (; *suffix != '\0'; ++suffix) {
+    if (*suffix < '0' || *suffix > '9') return false;
+  }
+  return true;
+}
+
+// Counters of every whole device that did any I/O, streamed from
+// /proc/diskstats through the stack buffer of a LineReader and parsed in
+// place. The kernel lists each disk followed by its partitions, so
+// partitions are told apart by name against the disk before them, without
+// a look at sysfs. Sectors are 512 bytes whatever the device's block size.
+inline bool getBlockDeviceCounters(DiskIOSample& sample) {
+  sample.count = 0;
+  LineReader reader("/proc/diskstats");
+  if (reader.fd < 0) {
+    return false;
+  }
+  char disk[32] = {};
+  char* line;
+  size_t len;
+  //   259  0 nvme0n1 reads merged sectors ms writes merged sectors ms
+  //                  in_flight io_ms weighted_ms [discards ...] [flushes ...]
+  while (reader.next(line, len)) {
+    char* p = line;
+    strtoul(p, &p, 10);  // major
+    strtoul(p, &p, 10);  // minor
+    while (*p == ' ') ++p;
+    char* name = p;
+    while (*p != ' ' && *p != '\0') ++p;
+    if (*p == '\0') continue;
+    *p++ = '\0';
+    if (isPartitionOf(name, disk)) continue;
+    snprintf(disk, sizeof(disk), "%s", name);
+
+    uint64_t fields[10];
+    for (uint64_t& field : fields) {
+      field = strtoull(p, &p, 10);
+    }
+    if (fields[0] + fields[4] == 0 || sample.count == MAX_BLOCK_DEVICES) continue;
+    BlockDeviceCounters& device = sample.devices[sample.count++];
+    memcpy(device.name, disk, sizeof(device.name));
+    device.reads = fields[0];
+    device.read_bytes = fields[2] * 512;
+    device.read_us = fields[3] * 1000;
+    device.writes = fields[4];
+    device.write_bytes = fields[6] * 512;
+    device.write_us = fields[7] * 1000;
+    device.busy_us = fields[9] * 1000;
+    device.busy_known = true;
+  }
+  return true;
+}
+
+inline long getUptimeSeconds() {
+  char buf[128];
+  if (readFile("/proc/uptime", buf, sizeof(buf)) > 0) {
+    return static_cast<long>(strtod(buf, nullptr));
+  }
+  return -1;
+}
+
+// The kernel's random per-boot UUID
+inline bool getBootID(char* buf, size_t cap) {
+  ssize_t len = readFile("/proc/sys/kernel/random/boot_id", buf, cap);
+  while (len > 0 && buf[len - 1] == '\n') buf[--len] = '\0';
+  return len > 0;
+}
+
+inline bool getPeerUID(int fd, uid_t& uid) {
+  struct ucred cred;
+  socklen_t len = sizeof(cred);
+  if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0) {
+    return false;
+  }
+  uid = cred.uid;
+  return true;
+}
+
+// Read- and write-class calls made by the calling thread (syscr + syscw);
+// needs task I/O accounting in the kernel. readFile reads twice, the second
+// time to see end of file.
+constexpr long SYSCALL_PROBE_CALLS = 2;
+
+inline long getSyscallCount() {
+  char buf[512];
+  if (readFile("/proc/thread-self/io", buf, sizeof(buf)) <= 0) {
+    return -1;
+  }
+  long count = 0;
+  char* save;
+  for (char* line = strtok_r(buf, "\n", &save); line; line = strtok_r(nullptr, "\n", &save)) {
+    if (startsWith(line, "syscr:") || startsWith(line, "syscw:")) {
+      count += strtol(line + 6, nullptr, 10);
+    }
+  }
+  return count;
+}
+
+#endif
+
+// ---- Profiling: --profile times every collector and render phase ----
+
+struct ProfileSpan {
+  const char* category;
+  const char* name;
+  int64_t start_ns;  // steady clock, relative to the profiler epoch
+  int64_t end_ns;
+  int64_t cpu_ns;    // CPU time of the recording thread
+  long syscalls;     // see getSyscallCount; -1 when unavailable
+  int thread;        // small sequential id, 0 for the first thread to record
+};
+
+inline int64_t threadCPUNanos() {
+  struct timespec ts;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+    return 0;
+  }
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+struct Profiler {
+  int64_t now() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now() - epoch)
+        .count();
+  }
+
+  int threadIndex() {
+    static thread_local const int index = next_thread++;
+    return index;
+  }
+
+  void record(const ProfileSpan& span) {
+    std::lock_guard<std::mutex> lock(mutex);
+    spans.push_back(span);
+  }
+
+  bool enabled = false;
+  const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+  std::mutex mutex;
+  std::vector<ProfileSpan> spans;
+  std::atomic<int> next_thread{0};
+};
+
+Profiler g_profiler;
+
+// Records the enclosing scope as one span when profiling is enabled, and
+// costs a single branch otherwise. next() closes the current span and opens
+// the following one, for functions that run in consecutive phases.
+struct ProfileScope {
+  ProfileScope(const char* span_category, const char* span_name) {
+    if (g_profiler.enabled) {
+      category = span_category;
+      begin(span_name);
+    }
+  }
+  ~ProfileScope() {
+    if (name != nullptr) end();
+  }
+  ProfileScope(const ProfileScope&) = delete;
+  ProfileScope& operator=(const ProfileScope&) = delete;
+
+  void next(const char* span_name) {
+    if (name != nullptr) {
+      end();
+      begin(span_name);
+    }
+  }
+
+  // Probes run outside the timed region where possible: counters first on
+  // the way in, last on the way out
+  void begin(const char* span_name) {
+    name = span_name;
+    syscalls = getSyscallCount();
+    cpu_ns = threadCPUNanos();
+    start_ns = g_profiler.now();
+  }
+
+  void end() {
+    ProfileSpan span;
+    span.end_ns = g_profiler.now();
+    span.cpu_ns = threadCPUNanos() - cpu_ns;
+    const long syscalls_after = getSyscallCount();
+    span.syscalls = syscalls >= 0 && syscalls_after >= 0
+                        ? syscalls_after - syscalls - SYSCALL_PROBE_CALLS
+                        : -1;
+    span.category = category;
+    span.name = name;
+    span.start_ns = start_ns;
+    span.thread = g_profiler.threadIndex();
+    g_profiler.record(span);
+  }
+
+  const char* category = nullptr;
+  const char* name = nullptr;
+  int64_t start_ns = 0;
+  int64_t cpu_ns = 0;
+  long syscalls = 0;
+};
+
+// Runs one collector inside a "collect" span and passes its result through
+template <typename Collector>
+inline auto profiled(const char* name, Collector&& collector) {
+  ProfileScope scope("collect", name);
+  return collector();
+}
+
+// PrometheusText is the classic text format, which node_exporter's textfile
+// collector parses; Prometheus is OpenMetrics
+enum class OutputFormat { Pretty, Json, Prometheus, PrometheusText };
+
+// A single run reports CPU usage since boot rather than sleep out a window.
+// --watch and --daemon open one before their first frame, and --top needs
+// two scans to rank processes by CPU.
+constexpr int DEFAULT_CPU_WINDOW_MS = 50;
+
+#if defined(__APPLE__)
+constexpr const char* DEFAULT_SOCKET_PATH = "/var/run/machine_report.sock";
+#else
+constexpr const char* DEFAULT_SOCKET_PATH = "/run/machine_report.sock";
+#endif
+
+struct Options {
+  double watch_interval = 0.0;  // seconds; 0 renders once and exits
+  int cpu_window_ms = -1;       // CPU utilization sampling window; 0 = since boot,
+                                // -1 = DEFAULT_CPU_WINDOW_MS when sampling repeats
+  OutputFormat format = OutputFormat::Pretty;
+  const char* textfile = nullptr;  // replace this file instead of printing
+  bool daemon = false;             // serve reports on socket_path
+  bool client = false;             // ask the daemon first, collect directly if absent
+  const char* socket_path = DEFAULT_SOCKET_PATH;
+  double daemon_interval = 5.0;    // seconds between daemon samples
+  const char* profile_path = nullptr;  // Chrome trace output for --profile
+  RenderOptions render;
+  const char* fs_types = DEFAULT_FS_TYPES;  // filesystem types shown as volumes
+  size_t top_processes = 0;  // rows per process list, 0 skips the process scan
+  bool static_cache = true;  // reuse static facts from the previous run this boot
+  int dns_probe_ms = 0;      // deadline of the nameserver probe, 0 skips it
+};
+
+// One bit per collector in the scheduler's table, see COLLECTORS below
+enum class Collector : uint8_t {
+  OsName,
+  Kernel,
+  Hostname,
+  MachineIP,
+  ClientIP,
+  User,
+  DNS,
+  DNSProbe,
+  CPUInfo,
+  Platform,
+  LastLogin,
+  Load,
+  Memory,
+  Pressure,
+  Disk,
+  Uptime,
+  Count
+};
+
+constexpr uint32_t collectorBit(Collector id) {
+  return 1u << static_cast<unsigned>(id);
+}
+
+constexpr uint32_t ALL_COLLECTORS = collectorBit(Collector::Count) - 1;
+constexpr uint32_t DYNAMIC_COLLECTORS = collectorBit(Collector::Load) |
+                                        collectorBit(Collector::Memory) |
+                                        collectorBit(Collector::Pressure) |
+                                        collectorBit(Collector::Disk) |
+                                        collectorBit(Collector::Uptime);
+
+constexpr const char* TIMEOUT_TEXT = "timeout";
+
+// Everything the report shows, as collected (the pretty renderer lowercases).
+// The static fields are collected once per process; collectDynamic refreshes
+// the rest on every watch tick.
+struct Report {
+  std::string os_name;
+  std::string os_kernel;
+  std::string net_hostname;
+  std::string net_machine_ip;
+  std::string net_client_ip;
+  std::string net_current_user;
+  std::vector<std::string> net_dns_ip;
+  std::vector<ResolverProbe> dns_probe;  // empty unless --dns-probe
+  NetAddresses net_addresses;
+  NetSample net_sample;  // latest counters, the baseline for the next rates
+  DiskIOSample disk_io;  // likewise for the block devices
+  TopProcesses processes;
+  CPUInfo cpu;
+  PlatformInfo platform;
+  LoginInfo login;
+  MemInfo mem;
+  PressureInfo pressure;
+  CgroupInfo cgroup;
+  std::vector<DiskInfo> disks;
+  long uptime_seconds = -1;  // -1 when unknown
+  std::string uptime;
+  CPUSample cpu_sample;  // latest tick snapshot, the baseline for the next one
+  CPUUsage cpu_usage;
+  uint32_t timed_out = 0;  // collectors that missed their deadline last time
+
+  bool timedOut(Collector id) const { return (timed_out & collectorBit(id)) != 0; }
+};
+
+// Samples the CPU counters and measures utilization since the previous sample
+inline void sampleCPUUsage(Report& report) {
+  CPUSample sample;
+  if (getCPUTicks(sample)) {
+    report.cpu_usage = computeCPUUsage(report.cpu_sample, sample);
+    report.cpu_sample = std::move(sample);
+  }
+}
+
+// Reads the interface counters and computes each interface's rates over
+// the time since the previous sample. Interfaces are matched by name, since
+// they come and go; a counter that went backwards was reset and counts as
+// idle.
+inline void sampleNetwork(NetSample& sample) {
+  const NetSample previous = sample;
+  if (!getInterfaceCounters(sample)) {
+    sample.taken_ns = 0;
+    return;
+  }
+  sample.taken_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  const double seconds = static_cast<double>(sample.taken_ns - previous.taken_ns) / 1e9;
+  const auto rate = [seconds](uint64_t before, uint64_t after) {
+    return after > before ? static_cast<double>(after - before) / seconds : 0.0;
+  };
+  for (size_t i = 0; i < sample.count; ++i) {
+    InterfaceCounters& counters = sample.interfaces[i];
+    counters.rx_rate = counters.tx_rate = -1.0;
+    if (previous.taken_ns == 0 || seconds <= 0.0) continue;
+    for (size_t j = 0; j < previous.count; ++j) {
+      const InterfaceCounters& before = previous.interfaces[j];
+      if (strcmp(before.name, counters.name) == 0) {
+        counters.rx_rate = rate(before.rx_bytes, counters.rx_bytes);
+        counters.tx_rate = rate(before.tx_bytes, counters.tx_bytes);
+        break;
+      }
+    }
+  }
+}
+
+// Reads the block device counters and computes each device's rates over
+// the time since the previous sample, the way sampleNetwork does. Devices
+// mostly keep their position between samples, so the same index is tried
+// before searching, which keeps hosts with hundreds of devices linear.
+inline void sampleDiskIO(DiskIOSample& sample) {
+  const DiskIOSample previous = sample;
+  if (!getBlockDeviceCounters(sample)) {
+    sample.taken_ns = 0;
+    return;
+  }
+  sample.taken_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  const double seconds = static_cast<double>(sample.taken_ns - previous.taken_ns) / 1e9;
+  const auto delta = [](uint64_t before, uint64_t after) {
+    return after > before ? static_cast<double>(after - before) : 0.0;
+  };
+  for (size_t i = 0; i < sample.count; ++i) {
+    BlockDeviceCounters& device = sample.devices[i];
+    device.read_iops = device.write_iops = device.read_rate = device.write_rate = -1.0;
+    device.await_ms = device.utilization = -1.0;
+    if (previous.taken_ns == 0 || seconds <= 0.0) continue;
+    const BlockDeviceCounters* before = nullptr;
+    if (i < previous.count && strcmp(previous.devices[i].name, device.name) == 0) {
+      before = &previous.devices[i];
+    } else {
+      for (size_t j = 0; j < previous.count; ++j) {
+        if (strcmp(previous.devices[j].name, device.name) == 0) {
+          before = &previous.devices[j];
+          break;
+        }
+      }
+    }
+    if (before == nullptr) continue;
+    const double reads = delta(before->reads, device.reads);
+    const double writes = delta(before->writes, device.writes);
+    device.read_iops = reads / seconds;
+    device.write_iops = writes / seconds;
+    device.read_rate = delta(before->read_bytes, device.read_bytes) / seconds;
+    device.write_rate = delta(before->write_bytes, device.write_bytes) / seconds;
+    device.await_ms = reads + writes > 0.0
+        ? (delta(before->read_us, device.read_us) + delta(before->write_us, device.write_us)) /
+              (reads + writes) / 1000.0
+        : 0.0;
+    if (device.busy_known) {
+      device.utilization =
+          std::min(100.0, delta(before->busy_us, device.busy_us) / (seconds * 1e6) * 100.0);
+    }
+  }
+}
+
+// ---- Collector scheduling ----
+//
+// Every collector fills its own fields of a staging Report. A run starts each
+// collector once its dependencies have finished, the ones that may block
+// first, on a fixed pool of worker threads, and runs the cheap ones on the
+// calling thread meanwhile. A collector still running at its deadline is
+// abandoned and its fields render as "timeout", so one stuck directory
+// service lookup or hung file system cannot hold up the report.
+
+// Cheap collectors cannot block and run inline. IO ones read local files or
+// make calls that can stall on a loaded machine. Blocking ones can wait on
+// something outside the machine, such as an NSS directory service.
+enum class CostClass { Cheap, IO, Blocking };
+
+struct CollectorSpec {
+  Collector id;
+  const char* name;
+  CostClass cost;
+  uint32_t deps;     // collectors whose fields this one reads or overwrites
+  int deadline_ms;   // from the start of the run
+  void (*collect)(Report& report);
+};
+
+constexpr int IO_DEADLINE_MS = 300;
+constexpr int BLOCKING_DEADLINE_MS = 1000;
+
+// Filesystem types the disk collector reports, set from --fs-types before
+// anything is collected
+const char* g_fs_types = DEFAULT_FS_TYPES;
+
+// Deadline of the nameserver probe, set from --dns-probe; the probe only
+// runs when it is above 0
+int g_dns_probe_ms = 0;
+
+constexpr CollectorSpec COLLECTORS[] = {
+    {Collector::OsName, "os_name", CostClass::IO, 0, IO_DEADLINE_MS,
+     [](Report& r) { r.os_name = getOSName(); }},
+    {Collector::Kernel, "kernel", CostClass::Cheap, 0, IO_DEADLINE_MS,
+     [](Report& r) { r.os_kernel = getKernelVersion(); }},
+    {Collector::Hostname, "hostname", CostClass::Cheap, 0, IO_DEADLINE_MS,
+     [](Report& r) { r.net_hostname = getHostname(); }},
+    {Collector::MachineIP, "machine_ip", CostClass::IO, 0, IO_DEADLINE_MS,
+     [](Report& r) {
+       getInterfaceAddresses(r.net_addresses);
+       r.net_machine_ip = getMachineIP(r.net_addresses);
+     }},
+    {Collector::ClientIP, "client_ip", CostClass::Cheap, 0, IO_DEADLINE_MS,
+     [](Report& r) { r.net_client_ip = getClientIP(); }},
+    {Collector::User, "user", CostClass::Blocking, 0, BLOCKING_DEADLINE_MS,
+     [](Report& r) { r.net_current_user = getCurrentUser(); }},
+    {Collector::DNS, "dns", CostClass::IO, 0, IO_DEADLINE_MS,
+     [](Report& r) { r.net_dns_ip = getDNS(); }},
+    {Collector::DNSProbe, "dns_probe", CostClass::Blocking, collectorBit(Collector::DNS),
+     IO_DEADLINE_MS + DNS_PROBE_MAX_MS,
+     [](Report& r) {
+       probeNameservers(r.net_dns_ip, g_dns_probe_ms, dnsProbePort(), r.dns_probe);
+     }},
+    {Collector::CPUInfo, "cpu_info", CostClass::IO, 0, IO_DEADLINE_MS,
+     [](Report& r) { r.cpu = getCPUInfo(); }},
+    {Collector::Platform, "platform", CostClass::IO, 0, IO_DEADLINE_MS,
+     [](Report& r) { r.platform = getPlatformInfo(); }},
+    {Collector::LastLogin, "last_login", CostClass::IO, 0, IO_DEADLINE_MS,
+     [](Report& r) { r.login = getLastLogin(); }},
+    {Collector::Load, "load", CostClass::Cheap, collectorBit(Collector::CPUInfo), IO_DEADLINE_MS,
+     [](Report& r) { getLoadAverages(r.cpu); }},
+    {Collector::Memory, "memory", CostClass::Cheap, 0, IO_DEADLINE_MS,
+     [](Report& r) { r.mem = getMemInfo(); }},
+    {Collector::Pressure, "pressure", CostClass::Cheap, 0, IO_DEADLINE_MS,
+     [](Report& r) { getResourcePressure(r.pressure, r.cgroup); }},
+    {Collector::Disk, "disk", CostClass::IO, 0, IO_DEADLINE_MS,
+     [](Report& r) { r.disks = getDisks(g_fs_types); }},
+    {Collector::Uptime, "uptime", CostClass::Cheap, 0, IO_DEADLINE_MS,
+     [](Report& r) {
+       r.uptime_seconds = getUptimeSeconds();
+       r.uptime = r.uptime_seconds >= 0 ? formatUptime(r.uptime_seconds) : "N/A";
+     }},
+};
+static_assert(sizeof(COLLECTORS) / sizeof(COLLECTORS[0]) ==
+                  static_cast<size_t>(Collector::Count),
+              "every collector needs an entry");
+
+// Keeps SIGINT, SIGTERM and SIGHUP away from helper threads, so that they
+// interrupt the main thread's sleeps and accept() instead
+inline void blockStopSignals(sigset_t* previous) {
+  sigset_t stop_signals;
+  sigemptyset(&stop_signals);
+  sigaddset(&stop_signals, SIGINT);
+  sigaddset(&stop_signals, SIGTERM);
+  sigaddset(&stop_signals, SIGHUP);
+  pthread_sigmask(SIG_BLOCK, &stop_signals, previous);
+}
+
+// Worker threads shared by every run, created on first use and never
+// destroyed: a worker stuck inside a collector keeps its thread, and neither
+// later runs nor process exit wait for it.
+struct CollectorPool {
+  explicit CollectorPool(unsigned threads) {
+    sigset_t previous;
+    blockStopSignals(&previous);
+    for (unsigned i = 0; i < threads; ++i) {
+      std::thread(&CollectorPool::work, this).detach();
+    }
+    pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+  }
+
+  void submit(std::function<void()> task) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      queue.push_back(std::move(task));
+    }
+    ready.notify_one();
+  }
+
+  void work() {
+    for (;;) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        ready.wait(lock, [this] { return !queue.empty(); });
+        task = std::move(queue.front());
+        queue.pop_front();
+      }
+      task();
+    }
+  }
+
+  std::mutex mutex;
+  std::condition_variable ready;
+  std::deque<std::function<void()>> queue;
+};
+
+// One thread per core, and at least two so that a single stuck collector
+// does not queue everything else behind it
+inline CollectorPool& collectorPool() {
+  static CollectorPool* pool =
+      new CollectorPool(std::max(2u, std::thread::hardware_concurrency()));
+  return *pool;
+}
+
+// Process tables at least this large are read by several threads
+constexpr size_t PARALLEL_SCAN_MIN = 4096;
+constexpr size_t SCAN_CHUNK = 512;
+
+// One parallel scan: threads claim chunks of the pid list until none are
+// left. The job owns the arrays, so a pool worker stuck inside a read keeps
+// them alive after the caller has given up on its chunk, and one that only
+// starts after the scan is over finds no chunk to claim.
+struct ProcessScanJob {
+  // Descriptors opened for chunks the caller gave up on are still the job's
+  ~ProcessScanJob() {
+    for (int& fd : fds) closeProcessFd(fd);
+  }
+
+  void run([[maybe_unused]] bool on_pool) {
+    for (;;) {
+      const size_t chunk = next.fetch_add(1);
+      if (chunk >= chunks) {
+        return;
+      }
+#if defined(MACHINE_REPORT_TEST_HOOKS)
+      if (on_pool) stallForTest("process_scan");
+#endif
+      const size_t stop = std::min(pids.size(), (chunk + 1) * SCAN_CHUNK);
+      for (size_t i = chunk * SCAN_CHUNK; i < stop; ++i) {
+        if (!readProcess(pids[i], fds[i], slots[i])) slots[i].pid = 0;
+      }
+      std::lock_guard<std::mutex> lock(mutex);
+      chunk_done[chunk] = true;
+      if (++finished == chunks) done.notify_all();
+    }
+  }
+
+  std::vector<int> pids;
+  std::vector<int> fds;
+  std::vector<ProcessSample> slots;
+  size_t chunks = 0;
+  std::atomic<size_t> next{0};
+  std::mutex mutex;
+  std::condition_variable done;
+  std::vector<bool> chunk_done;
+  size_t finished = 0;
+};
+
+// Reads pids into samples with the collector pool and the calling thread
+// claiming chunks together, so a pool held up by stuck collectors only makes
+// the scan slower. Once the caller runs out of chunks it waits at most
+// IO_DEADLINE_MS for the ones still on pool workers; the processes of a
+// chunk that is not done by then get pid 0 and no kept descriptor.
+inline void scanInParallel(std::vector<int>& pids, std::vector<int>& fds,
+                           std::vector<ProcessSample>& samples, size_t threads) {
+  auto job = std::make_shared<ProcessScanJob>();
+  job->pids.swap(pids);
+  job->fds.swap(fds);
+  job->slots.swap(samples);
+  job->chunks = (job->pids.size() + SCAN_CHUNK - 1) / SCAN_CHUNK;
+  job->chunk_done.assign(job->chunks, false);
+  for (size_t i = 1; i < threads; ++i) {
+    collectorPool().submit([job] { job->run(true); });
+  }
+  job->run(false);
+  std::unique_lock<std::mutex> lock(job->mutex);
+  if (job->done.wait_for(lock, std::chrono::milliseconds(IO_DEADLINE_MS),
+                         [&job] { return job->finished == job->chunks; })) {
+    pids.swap(job->pids);
+    fds.swap(job->fds);
+    samples.swap(job->slots);
+    return;
+  }
+  // Copy out the chunks that are done; the rest stay with the job
+  pids = job->pids;
+  fds.assign(job->fds.size(), -1);
+  samples.resize(job->slots.size());
+  for (size_t chunk = 0; chunk < job->chunks; ++chunk) {
+    const size_t first = chunk * SCAN_CHUNK;
+    const size_t stop = std::min(job->slots.size(), first + SCAN_CHUNK);
+    for (size_t i = first; i < stop; ++i) {
+      if (job->chunk_done[chunk]) {
+        samples[i] = job->slots[i];
+        std::swap(fds[i], job->fds[i]);
+      } else {
+        samples[i].pid = 0;
+      }
+    }
+  }
+}
+
+// Pids of the last scan with the stat descriptor kept for each, and the
+// buffers the next listing is merged in
+struct ProcessTable {
+  std::vector<int> pids;
+  std::vector<int> fds;
+  std::vector<int> listed;
+  std::vector<int> listed_fds;
+};
+
+// Lists the processes and carries the descriptor kept for each pid still
+// listed over to the new table, so only new processes are opened; those of
+// processes that exited are closed. Both lists are ascending, so matching
+// them is one merge pass.
+inline bool listProcessTable(ProcessTable& table) {
+  const bool listed = listProcesses(table.listed);
+  table.listed_fds.assign(table.listed.size(), -1);
+  size_t j = 0;
+  for (size_t i = 0; i < table.pids.size(); ++i) {
+    while (j < table.listed.size() && table.listed[j] < table.pids[i]) ++j;
+    if (j < table.listed.size() && table.listed[j] == table.pids[i]) {
+      table.listed_fds[j] = table.fds[i];
+    } else {
+      closeProcessFd(table.fds[i]);
+    }
+  }
+  table.pids.swap(table.listed);
+  table.fds.swap(table.listed_fds);
+  return listed;
+}
+
+// Reads every listed process into samples, in pid order. Tables of
+// PARALLEL_SCAN_MIN or more are split across threads.
+inline bool scanProcesses(ProcessTable& table, std::vector<ProcessSample>& samples) {
+  if (!listProcessTable(table)) {
+    samples.clear();
+    return false;
+  }
+  samples.resize(table.pids.size());
+  const size_t threads =
+      std::min<size_t>(std::thread::hardware_concurrency(), table.pids.size() / SCAN_CHUNK);
+  if (table.pids.size() < PARALLEL_SCAN_MIN || threads < 2) {
+    for (size_t i = 0; i < table.pids.size(); ++i) {
+      if (!readProcess(table.pids[i], table.fds[i], samples[i])) samples[i].pid = 0;
+    }
+  } else {
+    scanInParallel(table.pids, table.fds, samples, threads);
+  }
+  samples.erase(std::remove_if(samples.begin(), samples.end(),
+                               [](const ProcessSample& sample) { return sample.pid == 0; }),
+                samples.end());
+  return true;
+}
+
+// Scan buffers kept between process samples. The two scans swap roles each
+// time instead of being reallocated.
+struct ProcessSampler {
+  ProcessTable table;
+  std::vector<ProcessSample> current;
+  std::vector<ProcessSample> previous;
+  std::vector<double> cpu_percent;
+  std::vector<uint32_t> order;
+  int64_t previous_ns = 0;
+};
+
+inline ProcessSampler& processSampler() {
+  static ProcessSampler sampler;
+  return sampler;
+}
+
+// Scans the process table and keeps the top rows by CPU over the time since
+// the previous scan and by resident size. Both scans are sorted by pid, so
+// matching them is one merge pass; the rankings are partial sorts of an
+// index array.
+inline void sampleProcesses(TopProcesses& top) {
+  if (top.wanted == 0) {
+    return;
+  }
+  ProcessSampler& sampler = processSampler();
+  std::swap(sampler.current, sampler.previous);
+  if (!scanProcesses(sampler.table, sampler.current)) {
+    sampler.current.clear();
+    sampler.previous_ns = 0;
+    top.by_cpu.clear();
+    top.by_rss.clear();
+    return;
+  }
+  const int64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  std::vector<ProcessSample>& current = sampler.current;
+  const auto by_pid = [](const ProcessSample& a, const ProcessSample& b) { return a.pid < b.pid; };
+  if (!std::is_sorted(current.begin(), current.end(), by_pid)) {
+    std::sort(current.begin(), current.end(), by_pid);
+  }
+
+  // A process missing from the previous scan started since, so all of its
+  // CPU time falls inside the interval
+  const bool have_rates = sampler.previous_ns != 0;
+  const double interval_ns = static_cast<double>(now_ns - sampler.previous_ns);
+  sampler.cpu_percent.resize(current.size());
+  size_t j = 0;
+  for (size_t i = 0; i < current.size(); ++i) {
+    const ProcessSample& now = current[i];
+    while (j < sampler.previous.size() && sampler.previous[j].pid < now.pid) ++j;
+    uint64_t used = now.cpu_ns;
+    if (j < sampler.previous.size() && sampler.previous[j].pid == now.pid &&
+        sampler.previous[j].start == now.start) {
+      used = ticksDelta(sampler.previous[j].cpu_ns, now.cpu_ns);
+    }
+    sampler.cpu_percent[i] = have_rates ? static_cast<double>(used) / interval_ns * 100.0 : -1.0;
+  }
+  sampler.previous_ns = now_ns;
+
+  sampler.order.resize(current.size());
+  for (size_t i = 0; i < current.size(); ++i) {
+    sampler.order[i] = static_cast<uint32_t>(i);
+  }
+  const size_t rows = std::min(top.wanted, current.size());
+  const auto fill = [&](std::vector<ProcessInfo>& list) {
+    list.resize(rows);
+    for (size_t row = 0; row < rows; ++row) {
+      const ProcessSample& sample = current[sampler.order[row]];
+      ProcessInfo& info = list[row];
+      info.pid = sample.pid;
+      memcpy(info.name, sample.name, sizeof(info.name));
+      info.cpu_percent = sampler.cpu_percent[sampler.order[row]];
+      info.rss = sample.rss;
+    }
+  };
+  const auto first = sampler.order.begin();
+  if (have_rates) {
+    std::partial_sort(first, first + rows, sampler.order.end(), [&sampler](uint32_t a, uint32_t b) {
+      return sampler.cpu_percent[a] > sampler.cpu_percent[b];
+    });
+    fill(top.by_cpu);
+    while (!top.by_cpu.empty() && !(top.by_cpu.back().cpu_percent > 0.0)) {
+      top.by_cpu.pop_back();  // idle processes are not worth a row
+    }
+  } else {
+    top.by_cpu.clear();
+  }
+  std::partial_sort(first, first + rows, sampler.order.end(), [&current](uint32_t a, uint32_t b) {
+    return current[a].rss > current[b].rss;
+  });
+  fill(top.by_rss);
+}
+
+// Collectors currently on a worker. One that is still stuck from an earlier
+// run is not started again, it times out straight away.
+std::atomic<uint32_t> g_collectors_in_flight{0};
+
+// Shared with the workers, and kept alive by a collector that is still
+// running when the run gives up on it
+struct CollectionRun {
+  Report staging;
+  std::mutex mutex;
+  std::condition_variable finished;
+  uint32_t done = 0;
+};
+
+// The previous run on this thread, unless a collector it gave up on still
+// holds it. Its staging strings and vectors keep their capacity, so staging
+// a watch or daemon tick does not allocate.
+inline std::shared_ptr<CollectionRun> reuseCollectionRun() {
+  static thread_local std::shared_ptr<CollectionRun> last;
+  if (!last || last.use_count() > 1) {
+    last = std::make_shared<CollectionRun>();
+  }
+  last->done = 0;
+  return last;
+}
+
+// Copies the fields the given collectors own from one report to another
+inline void takeCollected(const Report& from, uint32_t done, Report& to) {
+  const auto has = [done](Collector id) { return (done & collectorBit(id)) != 0; };
+  if (has(Collector::OsName)) to.os_name = from.os_name;
+  if (has(Collector::Kernel)) to.os_kernel = from.os_kernel;
+  if (has(Collector::Hostname)) to.net_hostname = from.net_hostname;
+  if (has(Collector::MachineIP)) {
+    to.net_machine_ip = from.net_machine_ip;
+    to.net_addresses = from.net_addresses;
+  }
+  if (has(Collector::ClientIP)) to.net_client_ip = from.net_client_ip;
+  if (has(Collector::User)) to.net_current_user = from.net_current_user;
+  if (has(Collector::DNS)) to.net_dns_ip = from.net_dns_ip;
+  if (has(Collector::DNSProbe)) to.dns_probe = from.dns_probe;
+  if (has(Collector::CPUInfo)) {
+    to.cpu.model = from.cpu.model;
+    to.cpu.cores_physical = from.cpu.cores_physical;
+    to.cpu.cores_logical = from.cpu.cores_logical;
+    to.cpu.sockets = from.cpu.sockets;
+    to.cpu.topology = from.cpu.topology;
+  }
+  if (has(Collector::Platform)) to.platform = from.platform;
+  if (has(Collector::LastLogin)) to.login = from.login;
+  if (has(Collector::Load)) {
+    to.cpu.load_1 = from.cpu.load_1;
+    to.cpu.load_5 = from.cpu.load_5;
+    to.cpu.load_15 = from.cpu.load_15;
+  }
+  if (has(Collector::Memory)) to.mem = from.mem;
+  if (has(Collector::Pressure)) {
+    to.pressure = from.pressure;
+    to.cgroup = from.cgroup;
+  }
+  if (has(Collector::Disk)) to.disks = from.disks;
+  if (has(Collector::Uptime)) {
+    to.uptime_seconds = from.uptime_seconds;
+    to.uptime = from.uptime;
+  }
+}
+
+// Runs the wanted collectors into report and returns once each one has
+// finished or passed its deadline. A dependency outside the wanted set counts
+// as satisfied by the values already in report, unless it timed out.
+inline void runCollectors(Report& report, uint32_t wanted) {
+  const auto start = std::chrono::steady_clock::now();
+  const auto deadline = [start](const CollectorSpec& spec) {
+    return start + std::chrono::milliseconds(spec.deadline_ms);
+  };
+  const uint32_t stale = report.timed_out & ~wanted;
+  uint32_t started = 0;
+  uint32_t timed_out = 0;
+
+  // Collectors only touch their own fields and their dependencies', so only
+  // those are staged; the samplers' counters and process tables stay put
+  const auto run = reuseCollectionRun();
+  uint32_t staged = wanted;
+  for (const CollectorSpec& spec : COLLECTORS) {
+    if ((wanted & collectorBit(spec.id)) != 0) staged |= spec.deps;
+  }
+  takeCollected(report, staged, run->staging);
+  std::unique_lock<std::mutex> lock(run->mutex);
+  for (;;) {
+    bool ran_inline = false;
+    for (const CostClass cost : {CostClass::Blocking, CostClass::IO, CostClass::Cheap}) {
+      for (const CollectorSpec& spec : COLLECTORS) {
+        const uint32_t bit = collectorBit(spec.id);
+        if (spec.cost != cost || (wanted & bit) == 0 || ((started | timed_out) & bit) != 0) {
+          continue;
+        }
+        if ((spec.deps & (timed_out | stale)) != 0) {
+          timed_out |= bit;  // would read fields that never arrived
+          continue;
+        }
+        if ((spec.deps & wanted & ~run->done) != 0) {
+          continue;
+        }
+        started |= bit;
+        if (cost == CostClass::Cheap) {
+          lock.unlock();
+          {
+            ProfileScope scope("collect", spec.name);
+            spec.collect(run->staging);
+          }
+          lock.lock();
+          run->done |= bit;
+          ran_inline = true;
+        } else if ((g_collectors_in_flight.fetch_or(bit) & bit) != 0) {
+          timed_out |= bit;
+        } else {
+          collectorPool().submit([run, &spec, bit] {
+            {
+              ProfileScope scope("collect", spec.name);
+#if defined(MACHINE_REPORT_TEST_HOOKS)
+              stallForTest(spec.name);
+#endif
+              spec.collect(run->staging);
+            }
+            g_collectors_in_flight.fetch_and(~bit);
+            std::lock_guard<std::mutex> finished_lock(run->mutex);
+            run->done |= bit;
+            run->finished.notify_all();
+          });
+        }
+      }
+    }
+
+    const uint32_t pending = wanted & ~run->done & ~timed_out;
+    if (pending == 0) {
+      break;
+    }
+    if (ran_inline) {
+      continue;  // cheap collectors may have unblocked others
+    }
+    auto wake = std::chrono::steady_clock::time_point::max();
+    for (const CollectorSpec& spec : COLLECTORS) {
+      if ((pending & collectorBit(spec.id)) != 0) {
+        wake = std::min(wake, deadline(spec));
+      }
+    }
+    run->finished.wait_until(lock, wake);
+    const auto now = std::chrono::steady_clock::now();
+    for (const CollectorSpec& spec : COLLECTORS) {
+      const uint32_t bit = collectorBit(spec.id);
+      if ((pending & bit) != 0 && (run->done & bit) == 0 && deadline(spec) <= now) {
+        timed_out |= bit;
+      }
+    }
+  }
+
+  takeCollected(run->staging, run->done & wanted, report);
+  report.timed_out = (report.timed_out & ~wanted) | timed_out;
+}
+
+// CPU utilization since the last call, then the given collectors (by default
+// load, memory, pressure, disk and uptime)
+inline void collectDynamic(Report& report, uint32_t collectors = DYNAMIC_COLLECTORS) {
+  profiled("cpu_usage", [&report] { sampleCPUUsage(report); });
+  profiled("net_usage", [&report] { sampleNetwork(report.net_sample); });
+  profiled("disk_io", [&report] { sampleDiskIO(report.disk_io); });
+  profiled("processes", [&report] { sampleProcesses(report.processes); });
+  runCollectors(report, collectors);
+}
+
+// ---- Static facts cache ----
+//
+// What the static collectors found is kept in one small binary record per
+// user, $XDG_CACHE_HOME/machine_report/static.bin. The record is tied to the
+// boot it was written in, and each collector's entry also to the files that
+// collector reads, by modification time, size and inode. A run maps the
+// record, checks it and takes every entry that still holds, so the
+// collectors behind those entries never start.
+
+// Collectors whose results hold until the next boot, or until one of the
+// files they read changes. The hostname, the addresses and the SSH client
+// can change without either, and cost a system call or two anyway.
+struct CachedCollector {
+  Collector id;
+  const char* sources[2];  // nullptr when unused
+};
+
+#if defined(__APPLE__)
+// Users come from Directory Services, which has no file that tells of a
+// rename; the user name is refreshed by a reboot
+constexpr CachedCollector CACHED_COLLECTORS[] = {
+    {Collector::OsName, {"/System/Library/CoreServices/SystemVersion.plist", nullptr}},
+    {Collector::Kernel, {nullptr, nullptr}},
+    {Collector::User, {nullptr, nullptr}},
+    {Collector::DNS, {"/etc/resolv.conf", nullptr}},
+    {Collector::CPUInfo, {nullptr, nullptr}},
+    {Collector::Platform, {nullptr, nullptr}},
+    {Collector::LastLogin, {"/var/log/utx.log", nullptr}},
+};
+#else
+constexpr CachedCollector CACHED_COLLECTORS[] = {
+    {Collector::OsName, {"/etc/os-release", "/usr/lib/os-release"}},
+    {Collector::Kernel, {nullptr, nullptr}},
+    {Collector::User, {"/etc/passwd", nullptr}},
+    {Collector::DNS, {"/etc/resolv.conf", nullptr}},
+    {Collector::CPUInfo, {"/sys/devices/system/cpu/online", nullptr}},
+    {Collector::Platform, {nullptr, nullptr}},
+    {Collector::LastLogin, {"/var/log/wtmp", nullptr}},
+};
+#endif
+
+constexpr size_t CACHED_COUNT = sizeof(CACHED_COLLECTORS) / sizeof(CACHED_COLLECTORS[0]);
+
+// Bump whenever an entry's layout or a cached struct changes
+constexpr uint32_t STATIC_CACHE_VERSION = 1;
+
+// Identifies one version of a file; all zero when it does not exist
+struct FileStamp {
+  int64_t mtime_ns;
+  uint64_t size;
+  uint64_t inode;
+
+  bool operator==(const FileStamp& other) const {
+    return mtime_ns == other.mtime_ns && size == other.size && inode == other.inode;
+  }
+};
+
+inline uint32_t fnv1a(const char* data, size_t len) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < len; ++i) {
+    hash = (hash ^ static_cast<unsigned char>(data[i])) * 16777619u;
+  }
+  return hash;
+}
+
+// sysfs attributes keep the time they were created and report a page as
+// their size whatever they hold, so those are stamped by their contents
+inline FileStamp stampFile(const char* path) {
+  FileStamp stamp = {0, 0, 0};
+  struct stat st;
+  if (path != nullptr && startsWith(path, "/sys/") && stat(path, &st) == 0) {
+    char contents[4096];
+    const ssize_t len = readFile(path, contents, sizeof(contents));
+    if (len >= 0) {
+      stamp.mtime_ns = fnv1a(contents, static_cast<size_t>(len));
+      stamp.size = static_cast<uint64_t>(len);
+      stamp.inode = static_cast<uint64_t>(st.st_ino);
+    }
+  } else if (path != nullptr && stat(path, &st) == 0) {
+#if defined(__APPLE__)
+    stamp.mtime_ns = st.st_mtimespec.tv_sec * 1000000000ll + st.st_mtimespec.tv_nsec;
+#else
+    stamp.mtime_ns = st.st_mtim.tv_sec * 1000000000ll + st.st_mtim.tv_nsec;
+#endif
+    stamp.size = static_cast<uint64_t>(st.st_size);
+    stamp.inode = static_cast<uint64_t>(st.st_ino);
+  }
+  return stamp;
+}
+
+// Start of the record; the entries follow, each a collector id, the stamps
+// of its sources, a payload length and the payload
+struct StaticCacheHeader {
+  char magic[4];      // "MRSC"
+  uint32_t version;
+  uint32_t size;      // of the whole record
+  uint32_t checksum;  // FNV-1a of everything after the header
+  uint32_t uid;
+  uint32_t entries;
+  char boot_id[40];
+};
+
+// Appends fixed-width values and length-prefixed strings in host byte order;
+// the record never leaves the machine
+struct CacheWriter {
+  std::string out;
+
+  template <typename T>
+  void put(const T& value) {
+    static_assert(std::is_trivially_copyable<T>::value, "raw bytes only");
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+  void put(const std::string& value) {
+    put(static_cast<uint32_t>(value.size()));
+    out.append(value);
+  }
+};
+
+// Reads back what CacheWriter wrote. Running past the end clears ok, so a
+// damaged entry is dropped rather than read out of bounds.
+struct CacheReader {
+  const char* p;
+  const char* end;
+  bool ok = true;
+
+  template <typename T>
+  T get() {
+    T value{};
+    if (static_cast<size_t>(end - p) < sizeof(T)) {
+      ok = false;
+      return value;
+    }
+    memcpy(&value, p, sizeof(T));
+    p += sizeof(T);
+    return value;
+  }
+  std::string getString() {
+    const uint32_t len = get<uint32_t>();
+    if (!ok || static_cast<size_t>(end - p) < len) {
+      ok = false;
+      return "";
+    }
+    p += len;
+    return std::string(p - len, len);
+  }
+  // Element count of a vector, each element taking at least one byte
+  uint32_t getCount() {
+    const uint32_t count = get<uint32_t>();
+    if (static_cast<size_t>(end - p) < count) ok = false;
+    return ok ? count : 0;
+  }
+};
+
+inline void encodeCached(Collector id, const Report& report, CacheWriter& w) {
+  switch (id) {
+    case Collector::OsName:
+      w.put(report.os_name);
+      break;
+    case Collector::Kernel:
+      w.put(report.os_kernel);
+      break;
+    case Collector::User:
+      w.put(report.net_current_user);
+      break;
+    case Collector::DNS:
+      w.put(static_cast<uint32_t>(report.net_dns_ip.size()));
+      for (const std::string& server : report.net_dns_ip) w.put(server);
+      break;
+    case Collector::CPUInfo: {
+      const CPUInfo& cpu = report.cpu;
+      w.put(cpu.model);
+      w.put(static_cast<int32_t>(cpu.cores_physical));
+      w.put(static_cast<int32_t>(cpu.cores_logical));
+      w.put(static_cast<int32_t>(cpu.sockets));
+      const CPUTopology& topology = cpu.topology;
+      w.put(static_cast<int32_t>(topology.threads_per_core));
+      w.put(static_cast<uint32_t>(topology.classes.size()));
+      for (const CoreClass& core_class : topology.classes) {
+        w.put(core_class.name);
+        w.put(static_cast<int32_t>(core_class.physical));
+        w.put(static_cast<int32_t>(core_class.logical));
+      }
+      w.put(static_cast<uint32_t>(topology.caches.size()));
+      for (const CacheInfo& cache : topology.caches) {
+        w.put(static_cast<int32_t>(cache.level));
+        w.put(cache.kind);
+        w.put(cache.size);
+        w.put(static_cast<int32_t>(cache.shared_by));
+        w.put(static_cast<int32_t>(cache.instances));
+      }
+      w.put(static_cast<uint32_t>(topology.numa.size()));
+      for (const NumaNode& node : topology.numa) {
+        w.put(static_cast<int32_t>(node.id));
+        w.put(node.cpus);
+      }
+      break;
+    }
+    case Collector::Platform:
+      w.put(report.platform.hypervisor);
+      w.put(report.platform.cloud);
+      w.put(report.platform.instance);
+      break;
+    case Collector::LastLogin:
+      w.put(report.login.user);
+      w.put(report.login.tty);
+      w.put(static_cast<int64_t>(report.login.timestamp));
+      w.put(report.login.ip);
+      w.put(static_cast<uint8_t>(report.login.ip_present));
+      break;
+    default:
+      break;
+  }
+}
+
+inline void decodeCached(Collector id, CacheReader& r, Report& report) {
+  switch (id) {
+    case Collector::OsName:
+      report.os_name = r.getString();
+      break;
+    case Collector::Kernel:
+      report.os_kernel = r.getString();
+      break;
+    case Collector::User:
+      report.net_current_user = r.getString();
+      break;
+    case Collector::DNS:
+      report.net_dns_ip.resize(r.getCount());
+      for (std::string& server : report.net_dns_ip) server = r.getString();
+      break;
+    case Collector::CPUInfo: {
+      CPUInfo& cpu = report.cpu;
+      cpu.model = r.getString();
+      cpu.cores_physical = r.get<int32_t>();
+      cpu.cores_logical = r.get<int32_t>();
+      cpu.sockets = r.get<int32_t>();
+      CPUTopology& topology = cpu.topology;
+      topology.threads_per_core = r.get<int32_t>();
+      topology.classes.resize(r.getCount());
+      for (CoreClass& core_class : topology.classes) {
+        core_class.name = r.getString();
+        core_class.physical = r.get<int32_t>();
+        core_class.logical = r.get<int32_t>();
+      }
+      topology.caches.resize(r.getCount());
+      for (CacheInfo& cache : topology.caches) {
+        cache.level = r.get<int32_t>();
+        cache.kind = r.get<char>();
+        cache.size = r.get<uint64_t>();
+        cache.shared_by = r.get<int32_t>();
+        cache.instances = r.get<int32_t>();
+      }
+      topology.numa.resize(r.getCount());
+      for (NumaNode& node : topology.numa) {
+        node.id = r.get<int32_t>();
+        node.cpus = r.getString();
+      }
+      break;
+    }
+    case Collector::Platform:
+      report.platform.hypervisor = r.getString();
+      report.platform.cloud = r.getString();
+      report.platform.instance = r.getString();
+      break;
+    case Collector::LastLogin:
+      report.login.user = r.getString();
+      report.login.tty = r.getString();
+      report.login.timestamp = static_cast<time_t>(r.get<int64_t>());
+      report.login.ip = r.getString();
+      report.login.ip_present = r.get<uint8_t>() != 0;
+      // Formatted again, so the time follows a change of time zone
+      report.login.time = report.login.timestamp > 0 ? formatLoginTime(report.login.timestamp)
+                                                     : "N/A";
+      break;
+    default:
+      break;
+  }
+}
+
+// $XDG_CACHE_HOME/machine_report/static.bin, falling back to ~/.cache.
+// With create, the directories are made as needed, but only when
+// $XDG_CACHE_HOME or $HOME belongs to the effective user: under sudo they
+// still name the invoking user's, who could not replace a record owned by
+// root.
+inline bool staticCachePath(char* path, size_t cap, bool create) {
+  const char* xdg = getenv("XDG_CACHE_HOME");
+  const char* home = getenv("HOME");
+  const char* base;
+  char dir[4096];
+  if (xdg != nullptr && xdg[0] == '/') {
+    base = xdg;
+    snprintf(dir, sizeof(dir), "%s", xdg);
+  } else if (home != nullptr && home[0] == '/') {
+    base = home;
+    snprintf(dir, sizeof(dir), "%s/.cache", home);
+  } else {
+    return false;
+  }
+  if (create) {
+    struct stat st;
+    if (stat(base, &st) != 0 || st.st_uid != geteuid()) {
+      return false;
+    }
+    mkdir(dir, 0700);
+  }
+  const int len = snprintf(path, cap, "%s/machine_report", dir);
+  if (len < 0 || static_cast<size_t>(len) + 12 >= cap) {
+    return false;
+  }
+  if (create) {
+    mkdir(path, 0700);
+  }
+  memcpy(path + len, "/static.bin", 12);
+  return true;
+}
+
+// Stamps of the current boot and sources, taken before anything is collected
+// so that a file changing during the run is caught by the next one
+struct StaticCacheState {
+  char boot_id[40] = {};
+  FileStamp stamps[CACHED_COUNT][2];
+  uint32_t loaded = 0;  // collectors filled in from the record
+};
+
+inline void stampSources(StaticCacheState& state) {
+  if (!getBootID(state.boot_id, sizeof(state.boot_id))) {
+    state.boot_id[0] = '\0';
+  }
+  for (size_t i = 0; i < CACHED_COUNT; ++i) {
+    for (size_t s = 0; s < 2; ++s) {
+      state.stamps[i][s] = stampFile(CACHED_COLLECTORS[i].sources[s]);
+    }
+  }
+}
+
+// Fills report with every entry of the record that is still valid and
+// returns the collectors it covered
+inline uint32_t loadStaticCache(Report& report, StaticCacheState& state) {
+  stampSources(state);
+  char path[4096];
+  if (state.boot_id[0] == '\0' || !staticCachePath(path, sizeof(path), false)) {
+    return 0;
+  }
+  const int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return 0;
+  }
+  struct stat st;
+  void* map = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size >= static_cast<off_t>(sizeof(StaticCacheHeader)) &&
+      st.st_size < (1 << 20)) {
+    map = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (map == MAP_FAILED) {
+    return 0;
+  }
+  const size_t size = static_cast<size_t>(st.st_size);
+  const char* data = static_cast<const char*>(map);
+  StaticCacheHeader header;
+  memcpy(&header, data, sizeof(header));
+  const char* body = data + sizeof(header);
+  if (memcmp(header.magic, "MRSC", 4) != 0 || header.version != STATIC_CACHE_VERSION ||
+      header.size != size || header.uid != static_cast<uint32_t>(getuid()) ||
+      strncmp(header.boot_id, state.boot_id, sizeof(header.boot_id)) != 0 ||
+      header.checksum != fnv1a(body, size - sizeof(header))) {
+    munmap(map, size);
+    return 0;
+  }
+
+  CacheReader reader{body, data + size};
+  Report decoded;
+  for (uint32_t e = 0; e < header.entries && reader.ok; ++e) {
+    const auto id = static_cast<Collector>(reader.get<uint8_t>());
+    FileStamp stamps[2];
+    stamps[0] = reader.get<FileStamp>();
+    stamps[1] = reader.get<FileStamp>();
+    const uint32_t len = reader.get<uint32_t>();
+    if (!reader.ok || static_cast<size_t>(reader.end - reader.p) < len) {
+      break;
+    }
+    CacheReader entry{reader.p, reader.p + len};
+    reader.p += len;
+    for (size_t i = 0; i < CACHED_COUNT; ++i) {
+      if (CACHED_COLLECTORS[i].id != id) continue;
+      if (stamps[0] == state.stamps[i][0] && stamps[1] == state.stamps[i][1]) {
+        decodeCached(id, entry, decoded);
+        if (entry.ok && entry.p == entry.end) {
+          takeCollected(decoded, collectorBit(id), report);
+          state.loaded |= collectorBit(id);
+        }
+      }
+      break;
+    }
+  }
+  munmap(map, size);
+  return state.loaded;
+}
+
+// Rewrites the record with every cached collector that did not time out.
+// Failures are silent: the cache only ever saves time.
+inline void storeStaticCache(const Report& report, const StaticCacheState& state) {
+  char path[4096];
+  if (state.boot_id[0] == '\0' || !staticCachePath(path, sizeof(path), true)) {
+    return;
+  }
+  StaticCacheHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, "MRSC", 4);
+  header.version = STATIC_CACHE_VERSION;
+  header.uid = static_cast<uint32_t>(getuid());
+  snprintf(header.boot_id, sizeof(header.boot_id), "%s", state.boot_id);
+
+  CacheWriter body;
+  for (size_t i = 0; i < CACHED_COUNT; ++i) {
+    const Collector id = CACHED_COLLECTORS[i].id;
+    if (report.timedOut(id)) continue;
+    CacheWriter entry;
+    encodeCached(id, report, entry);
+    body.put(static_cast<uint8_t>(id));
+    body.put(state.stamps[i][0]);
+    body.put(state.stamps[i][1]);
+    body.put(entry.out);
+    ++header.entries;
+  }
+  header.size = static_cast<uint32_t>(sizeof(header) + body.out.size());
+  header.checksum = fnv1a(body.out.data(), body.out.size());
+
+  // Written aside and renamed over, so a concurrent reader sees either record
+  char tmp_path[4096 + 32];
+  snprintf(tmp_path, sizeof(tmp_path), "%s.%ld.tmp", path, static_cast<long>(getpid()));
+  const int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  if (fd < 0) {
+    return;
+  }
+  const bool written =
+      write(fd, &header, sizeof(header)) == static_cast<ssize_t>(sizeof(header)) &&
+      write(fd, body.out.data(), body.out.size()) == static_cast<ssize_t>(body.out.size());
+  if (close(fd) != 0 || !written || rename(tmp_path, path) != 0) {
+    unlink(tmp_path);
+  }
+}
+
+constexpr uint32_t cachedCollectorBits() {
+  uint32_t bits = 0;
+  for (const CachedCollector& cached : CACHED_COLLECTORS) bits |= collectorBit(cached.id);
+  return bits;
+}
+
+// The CPU utilization window opens before the collectors run and closes
+// after them, so only the part of the window they did not cover is slept.
+// Network and disk I/O rates and process CPU are measured over the same
+// window. Static
+// facts still valid in the cache are not collected again.
+inline void collectReport(Report& report, const Options& options) {
+  ProfileScope scope("collect", "total");
+  const auto window_start = std::chrono::steady_clock::now();
+  report.cpu_usage = CPUUsage{};
+  report.net_sample.taken_ns = 0;
+  report.disk_io.taken_ns = 0;
+  report.processes.wanted = options.top_processes;
+  if (options.cpu_window_ms > 0) {
+    profiled("cpu_ticks", [&report] { getCPUTicks(report.cpu_sample); });
+    profiled("net_counters", [&report] { sampleNetwork(report.net_sample); });
+    profiled("disk_counters", [&report] { sampleDiskIO(report.disk_io); });
+    profiled("process_scan", [&report] { sampleProcesses(report.processes); });
+  }
+
+  StaticCacheState cache;
+  uint32_t cached = 0;
+  if (options.static_cache) {
+    ProfileScope load("cache", "load");
+    cached = loadStaticCache(report, cache);
+  }
+
+  const uint32_t probe = options.dns_probe_ms > 0 ? collectorBit(Collector::DNSProbe) : 0;
+  runCollectors(report, (ALL_COLLECTORS & ~collectorBit(Collector::DNSProbe) & ~cached) | probe);
+
+  if (options.static_cache && (cachedCollectorBits() & ~cached & ~report.timed_out) != 0) {
+    ProfileScope store("cache", "store");
+    storeStaticCache(report, cache);
+  }
+
+  {
+    ProfileScope window("collect", "cpu_window");
+    std::this_thread::sleep_until(window_start +
+                                  std::chrono::milliseconds(options.cpu_window_ms));
+  }
+  profiled("cpu_usage", [&report] { sampleCPUUsage(report); });
+  profiled("net_usage", [&report] { sampleNetwork(report.net_sample); });
+  profiled("disk_io", [&report] { sampleDiskIO(report.disk_io); });
+  profiled("processes", [&report] { sampleProcesses(report.processes); });
+}
+
+// Label and value of each topology row: core classes on hybrid CPUs, SMT,
+// one row per cache level and kind, and the NUMA nodes when there are
+// several
+inline std::vector<std::pair<std::string, std::string>> topologyRows(const CPUTopology& topology) {
+  std::vector<std::pair<std::string, std::string>> rows;
+  if (!topology.classes.empty()) {
+    std::string classes;
+    for (const CoreClass& core_class : topology.classes) {
+      if (!classes.empty()) classes += " + ";
+      classes += std::to_string(core_class.physical) + core_class.name.substr(0, 1);
+    }
+    rows.emplace_back("core types", classes + " cores");
+  }
+  rows.emplace_back("smt", topology.threads_per_core > 1
+                               ? std::to_string(topology.threads_per_core) + " threads per core"
+                               : "off");
+  for (size_t i = 0; i < topology.caches.size();) {
+    const CacheInfo& first = topology.caches[i];
+    std::string label = "l" + std::to_string(first.level);
+    if (first.kind != 'u') label += first.kind;
+    std::string value;
+    for (; i < topology.caches.size() && topology.caches[i].level == first.level &&
+           topology.caches[i].kind == first.kind;
+         ++i) {
+      if (!value.empty()) value += ", ";
+      value += formatMemory(topology.caches[i].size) + " x" +
+               std::to_string(topology.caches[i].instances);
+    }
+    rows.emplace_back(label + " cache", value);
+  }
+  if (topology.numa.size() > 1) {
+    std::string nodes;
+    for (const NumaNode& node : topology.numa) {
+      nodes += (nodes.empty() ? "" : " ") + node.cpus;
+    }
+    rows.emplace_back("numa nodes", std::to_string(topology.numa.size()) + ": " + nodes);
+  }
+  return rows;
+}
+
+// "some 2.4% full 0.0%", the shares of the last 10 s spent stalled
+inline std::string formatStall(const StallAverages& stall) {
+  char text[48];
+  snprintf(text, sizeof(text), "some %.1f%% full %.1f%%", stall.some[0], stall.full[0]);
+  return text;
+}
+
+// Label and value of each pressure row: host stalls, then the cgroup's
+// limits, usage and own stalls. Rows whose source is missing are left out.
+inline std::vector<std::pair<std::string, std::string>> pressureRows(const Report& report) {
+  std::vector<std::pair<std::string, std::string>> rows;
+  if (report.timedOut(Collector::Pressure)) {
+    rows.emplace_back("pressure", TIMEOUT_TEXT);
+    return rows;
+  }
+  const auto stalls = [&rows](const PressureInfo& pressure, const char* prefix) {
+    const std::pair<const char*, const StallAverages*> resources[] = {
+        {"cpu stall", &pressure.cpu}, {"mem stall", &pressure.memory}, {"io stall", &pressure.io}};
+    for (const auto& resource : resources) {
+      if (resource.second->present) {
+        rows.emplace_back(std::string(prefix) + resource.first, formatStall(*resource.second));
+      }
+    }
+  };
+  stalls(report.pressure, "");
+
+  const CgroupInfo& cgroup = report.cgroup;
+  if (!cgroup.present) {
+    return rows;
+  }
+  rows.emplace_back("cgroup", cgroup.path);
+  char text[64];
+  if (cgroup.cpu_limit > 0.0) {
+    const double throttled = cgroup.cpu_periods > 0
+        ? static_cast<double>(cgroup.cpu_throttled_periods) / cgroup.cpu_periods * 100.0
+        : 0.0;
+    snprintf(text, sizeof(text), "%.1f cores, %.0f%% throttled", cgroup.cpu_limit, throttled);
+    rows.emplace_back("cgroup cpu", text);
+  } else {
+    rows.emplace_back("cgroup cpu", "no limit");
+  }
+  if (cgroup.memory_max > 0) {
+    const double percent =
+        static_cast<double>(cgroup.memory_current) / static_cast<double>(cgroup.memory_max) * 100.0;
+    rows.emplace_back("cgroup memory", formatMemory(cgroup.memory_current) + "/" +
+                                           formatMemory(cgroup.memory_max) + " [" +
+                                           std::to_string(static_cast<int>(percent + 0.5)) + "%]");
+  } else {
+    rows.emplace_back("cgroup memory", formatMemory(cgroup.memory_current) + ", no limit");
+  }
+  rows.emplace_back("cgroup io",
+                    "read " + formatTraffic(static_cast<double>(cgroup.io_read_bytes)) +
+                        " write " + formatTraffic(static_cast<double>(cgroup.io_write_bytes)));
+  stalls(cgroup.pressure, "cg ");
+  return rows;
+}
+
+// Indexes of up to rows interfaces that carried traffic, busiest first: by
+// rate when there are two samples, else by bytes since the interface came up
+inline size_t busiestInterfaces(const NetSample& sample, size_t rows, uint8_t* order) {
+  static_assert(MAX_INTERFACES <= 256, "interface indexes are bytes");
+  const auto traffic = [&sample](size_t i) {
+    const InterfaceCounters& counters = sample.interfaces[i];
+    return counters.rx_rate >= 0.0
+        ? counters.rx_rate + counters.tx_rate
+        : static_cast<double>(counters.rx_bytes + counters.tx_bytes);
+  };
+  size_t count = 0;
+  for (size_t i = 0; i < sample.count; ++i) {
+    const InterfaceCounters& counters = sample.interfaces[i];
+    if (counters.rx_bytes + counters.tx_bytes > 0) {
+      order[count++] = static_cast<uint8_t>(i);
+    }
+  }
+  rows = std::min(rows, count);
+  std::partial_sort(order, order + rows, order + count, [&](uint8_t a, uint8_t b) {
+    const double traffic_a = traffic(a);
+    const double traffic_b = traffic(b);
+    if (traffic_a != traffic_b) return traffic_a > traffic_b;
+    return strcmp(sample.interfaces[a].name, sample.interfaces[b].name) < 0;
+  });
+  return rows;
+}
+
+// Indexes of up to rows block devices, most saturated first: by utilization
+// and then throughput when there are two samples, else by bytes since boot
+inline size_t busiestDevices(const DiskIOSample& sample, size_t rows, uint16_t* order) {
+  static_assert(MAX_BLOCK_DEVICES <= 65536, "device indexes are 16 bits");
+  const auto busy = [&sample](size_t i) {
+    return std::max(sample.devices[i].utilization, 0.0);
+  };
+  const auto traffic = [&sample](size_t i) {
+    const BlockDeviceCounters& device = sample.devices[i];
+    return device.read_rate >= 0.0
+        ? device.read_rate + device.write_rate
+        : static_cast<double>(device.read_bytes + device.write_bytes);
+  };
+  for (size_t i = 0; i < sample.count; ++i) {
+    order[i] = static_cast<uint16_t>(i);
+  }
+  rows = std::min(rows, sample.count);
+  std::partial_sort(order, order + rows, order + sample.count, [&](uint16_t a, uint16_t b) {
+    if (busy(a) != busy(b)) return busy(a) > busy(b);
+    const double traffic_a = traffic(a);
+    const double traffic_b = traffic(b);
+    if (traffic_a != traffic_b) return traffic_a > traffic_b;
+    return strcmp(sample.devices[a].name, sample.devices[b].name) < 0;
+  });
+  return rows;
+}
+
+// "r 4.2 mb/s w 1.1 mb/s", or totals since boot when there is no rate yet
+inline std::string deviceTraffic(const BlockDeviceCounters& device) {
+  if (device.read_rate >= 0.0) {
+    return "r " + formatTraffic(device.read_rate, "/s") + " w " +
+           formatTraffic(device.write_rate, "/s");
+  }
+  return "r " + formatTraffic(static_cast<double>(device.read_bytes)) + " w " +
+         formatTraffic(static_cast<double>(device.write_bytes));
+}
+
+// "r 120 w 30 await 0.8 ms", empty when there is no rate yet
+inline std::string deviceOperations(const BlockDeviceCounters& device) {
+  if (device.read_iops < 0.0) {
+    return "";
+  }
+  char text[64];
+  snprintf(text, sizeof(text), device.await_ms < 10.0 ? "r %.0f w %.0f await %.1f ms"
+                                                      : "r %.0f w %.0f await %.0f ms",
+           device.read_iops, device.write_iops, device.await_ms);
+  return text;
+}
+
+// Address row of an interface: IPv4 if it has one, else IPv6
+inline std::string interfaceAddress(const NetAddresses& addresses, const char* name) {
+  const InterfaceAddress* entry = findAddress(addresses, name);
+  if (entry == nullptr) {
+    return "no address";
+  }
+  return entry->ipv4[0] != '\0' ? entry->ipv4 : entry->ipv6[0] != '\0' ? entry->ipv6 : "no address";
+}
+
+// "rx 1.2 mb/s tx 310 kb/s", or totals when there is no rate yet, with the
+// error count when there are any
+inline std::string interfaceTraffic(const InterfaceCounters& counters) {
+  std::string text;
+  if (counters.rx_rate >= 0.0) {
+    text = "rx " + formatTraffic(counters.rx_rate, "/s") + " tx " + formatTraffic(counters.tx_rate, "/s");
+  } else {
+    text = "rx " + formatTraffic(static_cast<double>(counters.rx_bytes)) + " tx " +
+           formatTraffic(static_cast<double>(counters.tx_bytes));
+  }
+  const uint64_t errors = counters.rx_errors + counters.tx_errors;
+  if (errors > 0) {
+    text += " err " + std::to_string(errors);
+  }
+  return text;
+}
+
+// "12 ms", "slow 340 ms", "dead"
+inline std::string resolverHealth(const ResolverProbe& probe) {
+  char text[32];
+  const char* format = probe.rtt_ms < 10.0 ? "%.1f ms" : "%.0f ms";
+  switch (probe.status) {
+    case ResolverStatus::Ok:
+      snprintf(text, sizeof(text), format, probe.rtt_ms);
+      return text;
+    case ResolverStatus::Slow:
+    case ResolverStatus::Error: {
+      char rtt[24];
+      snprintf(rtt, sizeof(rtt), format, probe.rtt_ms);
+      snprintf(text, sizeof(text), "%s %s", probe.status == ResolverStatus::Slow ? "slow" : "error",
+               rtt);
+      return text;
+    }
+    case ResolverStatus::Unreachable:
+    case ResolverStatus::Dead:
+    case ResolverStatus::Invalid:
+      break;
+  }
+  return resolverStatusName(probe.status);
+}
+
+inline void renderReport(const Report& report, const RenderOptions& style, Frame& frame) {
+  ProfileScope phase("render", "strings");
+  // Fields whose collector missed its deadline read "timeout"
+  const auto shown = [&report](Collector id, std::string value) {
+    return report.timedOut(id) ? std::string(TIMEOUT_TEXT) : value;
+  };
+  const std::string os_name = shown(Collector::OsName, toLower(report.os_name));
+  const std::string os_kernel = shown(Collector::Kernel, toLower(report.os_kernel));
+  const std::string net_hostname = shown(Collector::Hostname, toLower(report.net_hostname));
+  const std::string net_machine_ip = shown(Collector::MachineIP, report.net_machine_ip);
+  const std::string net_client_ip = shown(Collector::ClientIP, report.net_client_ip);
+  const std::string net_current_user = shown(Collector::User, toLower(report.net_current_user));
+  const std::string cpu_model = shown(Collector::CPUInfo, toLower(report.cpu.model));
+  const std::string cpu_cores_str =
+      shown(Collector::CPUInfo, std::to_string(report.cpu.cores_physical) + " cores");
+  const PlatformInfo& platform = report.platform;
+  const std::string hypervisor_str =
+      shown(Collector::Platform, platform.hypervisor.empty() ? "bare metal" : platform.hypervisor);
+  const std::string cloud_str = report.timedOut(Collector::Platform) || platform.cloud.empty()
+      ? ""
+      : toLower(platform.instance.empty() ? platform.cloud
+                                          : platform.cloud + " " + platform.instance);
+
+  const CPUUsage& usage = report.cpu_usage;
+  char text[96];
+  snprintf(text, sizeof(text), "%d%%", static_cast<int>(usage.busy + 0.5));
+  const std::string cpu_usage_str = text;
+
+  snprintf(text, sizeof(text), "usr %d%% sys %d%% io %d%% st %d%%",
+           static_cast<int>(usage.user + 0.5), static_cast<int>(usage.system + 0.5),
+           static_cast<int>(usage.iowait + 0.5), static_cast<int>(usage.steal + 0.5));
+  const std::string cpu_split_str = text;
+
+  const std::string mem_usage_str = shown(Collector::Memory,
+      formatGiB(report.mem.used) + "/" + formatGiB(report.mem.total) +
+      " gib [" + std::to_string(static_cast<int>(report.mem.percent + 0.5)) + "%]");
+
+  // Shares of total in the order and colours of the usage bar
+  const auto share = [&report](uint64_t bytes) {
+    return report.mem.total > 0
+        ? static_cast<int>(static_cast<double>(bytes) / static_cast<double>(report.mem.total) *
+                               100.0 + 0.5)
+        : 0;
+  };
+  const uint64_t mem_wired = std::min(report.mem.wired, report.mem.used);
+  const uint64_t mem_compressed = std::min(report.mem.compressed, report.mem.used - mem_wired);
+  snprintf(text, sizeof(text), "wired %d%% app %d%% cache %d%%", share(mem_wired),
+           share(report.mem.used - mem_wired - mem_compressed),
+           share(std::min(report.mem.file_backed, report.mem.total - report.mem.used)));
+  const std::string mem_split_str = shown(Collector::Memory, text);
+  const std::string compressed_str =
+      formatMemory(report.mem.compressed) + " [" + std::to_string(share(mem_compressed)) + "%]";
+  std::string swap_str;
+  if (report.mem.swap_total > 0) {
+    swap_str = formatMemory(report.mem.swap_used) + "/" + formatMemory(report.mem.swap_total) +
+               " [" +
+               std::to_string(static_cast<int>(static_cast<double>(report.mem.swap_used) /
+                                                   static_cast<double>(report.mem.swap_total) *
+                                                   100.0 + 0.5)) +
+               "%]";
+  }
+
+  std::vector<std::string> disk_usage_strs;
+  if (report.timedOut(Collector::Disk)) {
+    disk_usage_strs.push_back(TIMEOUT_TEXT);
+  } else {
+    for (const DiskInfo& disk : report.disks) {
+      disk_usage_strs.push_back(formatBytes(disk.used) + "/" + formatBytes(disk.total) + " gb [" +
+                                std::to_string(static_cast<int>(disk.percent + 0.5)) + "%]");
+    }
+  }
+
+  const std::string login_time = shown(Collector::LastLogin, toLower(report.login.time));
+  const bool login_ip_shown = report.login.ip_present && !report.timedOut(Collector::LastLogin);
+  const std::string uptime = shown(Collector::Uptime, toLower(report.uptime));
+
+  std::string cpu_model_with_japanese = std::string(JAPANESE_CPU) + " " + cpu_model;
+  std::string mem_usage_with_japanese = std::string(JAPANESE_MEM) + " " + mem_usage_str;
+  std::string login_time_with_japanese = std::string(JAPANESE_TIME) + " " + login_time;
+
+  uint8_t interface_order[MAX_INTERFACES];
+  const size_t interface_rows =
+      busiestInterfaces(report.net_sample, style.interface_rows, interface_order);
+  std::vector<std::string> interface_strs;
+  for (size_t row = 0; row < interface_rows; ++row) {
+    const InterfaceCounters& counters = report.net_sample.interfaces[interface_order[row]];
+    interface_strs.push_back(report.timedOut(Collector::MachineIP)
+                                 ? std::string(TIMEOUT_TEXT)
+                                 : interfaceAddress(report.net_addresses, counters.name));
+    interface_strs.push_back(interfaceTraffic(counters));
+  }
+
+  // Throughput and operations of the most saturated block devices
+  uint16_t device_order[MAX_BLOCK_DEVICES];
+  const size_t device_rows = busiestDevices(report.disk_io, style.io_device_rows, device_order);
+  std::vector<std::string> device_strs;
+  for (size_t row = 0; row < device_rows; ++row) {
+    const BlockDeviceCounters& device = report.disk_io.devices[device_order[row]];
+    device_strs.push_back(deviceTraffic(device));
+    device_strs.push_back(deviceOperations(device));
+  }
+
+  // Top processes by CPU over the window, then by resident memory
+  std::vector<std::string> process_strs;
+  for (const ProcessInfo& process : report.processes.by_cpu) {
+    char row[48];
+    snprintf(row, sizeof(row), "cpu %.1f%% pid %d", process.cpu_percent, process.pid);
+    process_strs.push_back(row);
+  }
+  for (const ProcessInfo& process : report.processes.by_rss) {
+    process_strs.push_back("rss " + formatMemory(process.rss) + " pid " +
+                           std::to_string(process.pid));
+  }
+
+  // Nameservers, each followed by its probe result with --dns-probe
+  std::vector<std::string> dns_strs;
+  for (const std::string& server : report.net_dns_ip) {
+    std::string row = server;
+    for (const ResolverProbe& probe : report.dns_probe) {
+      if (probe.server == server) {
+        row += " ";
+        row += report.timedOut(Collector::DNSProbe) ? TIMEOUT_TEXT : resolverHealth(probe);
+        break;
+      }
+    }
+    dns_strs.push_back(row);
+  }
+
+  const std::vector<std::pair<std::string, std::string>> pressure_rows = pressureRows(report);
+  const std::vector<std::pair<std::string, std::string>> topology_rows =
+      report.timedOut(Collector::CPUInfo)
+          ? std::vector<std::pair<std::string, std::string>>()
+          : topologyRows(report.cpu.topology);
+
+  std::vector<std::string> all_strings = {
+      REPORT_TITLE,            os_name,                  os_kernel,
+      net_hostname,            net_machine_ip,           net_client_ip,
+      net_current_user,        cpu_model_with_japanese,  cpu_cores_str,
+      hypervisor_str,          cloud_str,                cpu_usage_str,
+      cpu_split_str,
+      mem_usage_with_japanese, mem_split_str,            compressed_str,
+      swap_str,
+      login_time_with_japanese, login_ip_shown ? report.login.ip : "", uptime};
+  for (const std::string& disk_usage : disk_usage_strs) {
+    all_strings.push_back(std::string(JAPANESE_DISK) + " " + disk_usage);
+  }
+  if (!report.timedOut(Collector::DNS)) {
+    all_strings.insert(all_strings.end(), dns_strs.begin(), dns_strs.end());
+  }
+  all_strings.insert(all_strings.end(), interface_strs.begin(), interface_strs.end());
+  all_strings.insert(all_strings.end(), device_strs.begin(), device_strs.end());
+  all_strings.insert(all_strings.end(), process_strs.begin(), process_strs.end());
+  for (const auto& row : pressure_rows) {
+    all_strings.push_back(row.second);
+  }
+  for (const auto& row : topology_rows) {
+    all_strings.push_back(row.second);
+  }
+
+  phase.next("layout");
   const int current_len = maxLength(all_strings);
 
-  int graph_width = current_len;
-  if (graph_width > MAX_DATA_LEN - 3) {
-    graph_width = MAX_DATA_LEN - 3;
+  int graph_width = current_len;
+  if (graph_width > MAX_DATA_LEN - 3) {
+    graph_width = MAX_DATA_LEN - 3;
+  }
+
+  phase.next("graphs");
+  // Load depends on cpu_info, so a timed-out core count never gets here
+  const auto bar = [&report, &style, graph_width](Collector id, double percent) {
+    return report.timedOut(id) ? std::string(TIMEOUT_TEXT)
+                               : drawBarGraph(percent, graph_width, style.bars);
+  };
+  const std::string cpu_1_graph =
+      bar(Collector::Load, (report.cpu.load_1 / report.cpu.cores_logical) * 100.0);
+  const std::string cpu_5_graph =
+      bar(Collector::Load, (report.cpu.load_5 / report.cpu.cores_logical) * 100.0);
+  const std::string cpu_15_graph =
+      bar(Collector::Load, (report.cpu.load_15 / report.cpu.cores_logical) * 100.0);
+
+  const std::string core_graph = drawCoreGraph(usage.cores, graph_width);
+  // Used memory from the least to the most reclaimable, then the file cache
+  // that is counted as available
+  std::string mem_graph;
+  if (report.timedOut(Collector::Memory)) {
+    mem_graph = TIMEOUT_TEXT;
+  } else {
+    const MemInfo& mem = report.mem;
+    const double total = mem.total > 0 ? static_cast<double>(mem.total) : 1.0;
+    const uint64_t wired = std::min(mem.wired, mem.used);
+    const uint64_t compressed = std::min(mem.compressed, mem.used - wired);
+    const BarSegment segments[] = {
+        {static_cast<double>(wired) / total * 100.0, PINK},
+        {static_cast<double>(compressed) / total * 100.0, YELLOW},
+        {static_cast<double>(mem.used - wired - compressed) / total * 100.0, PURPLE},
+        {static_cast<double>(std::min(mem.file_backed, mem.total - mem.used)) / total * 100.0,
+         BLUE},
+    };
+    mem_graph = drawStackedBar(segments, sizeof(segments) / sizeof(segments[0]), graph_width,
+                               style.bars);
+  }
+  std::vector<std::string> disk_graphs;
+  for (const DiskInfo& disk : report.disks) {
+    disk_graphs.push_back(bar(Collector::Disk, disk.percent));
+  }
+  // Sampled outside the collectors, so these never time out
+  std::vector<std::string> device_graphs;
+  for (size_t row = 0; row < device_rows; ++row) {
+    const double utilization = report.disk_io.devices[device_order[row]].utilization;
+    device_graphs.push_back(utilization >= 0.0 ? drawBarGraph(utilization, graph_width, style.bars)
+                                               : std::string());
+  }
+  const CgroupInfo& cgroup = report.cgroup;
+  const bool cgroup_bar = cgroup.present && cgroup.memory_max > 0 &&
+                          !report.timedOut(Collector::Pressure);
+  const std::string cgroup_graph = cgroup_bar
+      ? bar(Collector::Pressure, static_cast<double>(cgroup.memory_current) /
+                                     static_cast<double>(cgroup.memory_max) * 100.0)
+      : std::string();
+
+  phase.next("rows");
+  const BoxLayout& layout = boxLayout(current_len);
+  printBorder(frame, layout, Border::Top);
+  printCenteredData(frame, "✧･ﾟ: *✧･ﾟ:* SYSTEM STATUS REPORT *:･ﾟ✧*:･ﾟ✧", current_len, PINK);
+  printCenteredData(frame, "uwu TR-1000 Machine Report (◕‿◕✿)", current_len, CYAN);
+  printBorder(frame, layout, Border::Divider);
+
+  printData(frame, "os", os_name, current_len, CYAN, "");
+  printData(frame, "kernel", os_kernel, current_len, CYAN, "");
+  printBorder(frame, layout, Border::Divider);
+
+  printData(frame, "hostname", net_hostname, current_len, BLUE, "");
+  printData(frame, "machine ip", net_machine_ip, current_len, BLUE, "");
+  printData(frame, "client ip", toLower(net_client_ip), current_len, BLUE, "");
+  if (report.timedOut(Collector::DNS)) {
+    printData(frame, "dns ip 1", TIMEOUT_TEXT, current_len, BLUE, "");
+  } else {
+    for (size_t i = 0; i < dns_strs.size(); ++i) {
+      printData(frame, "dns ip " + std::to_string(i + 1), dns_strs[i], current_len, BLUE, "");
+    }
+  }
+  printData(frame, "user", net_current_user, current_len, PURPLE, "");
+  printBorder(frame, layout, Border::Divider);
+
+  // Address and traffic of the busiest interfaces
+  if (interface_rows > 0) {
+    for (size_t row = 0; row < interface_rows; ++row) {
+      printData(frame, report.net_sample.interfaces[interface_order[row]].name,
+                interface_strs[row * 2], current_len, BLUE, "");
+      printData(frame, "traffic", interface_strs[row * 2 + 1], current_len, BLUE, "");
+    }
+    printBorder(frame, layout, Border::Divider);
+  }
+
+  printData(frame, "processor", cpu_model, current_len, YELLOW, JAPANESE_CPU);
+  printData(frame, "cores", cpu_cores_str, current_len, YELLOW, "");
+  for (const auto& row : topology_rows) {
+    printData(frame, row.first, row.second, current_len, YELLOW, "");
+  }
+  printData(frame, "hypervisor", hypervisor_str, current_len, YELLOW, "");
+  if (!cloud_str.empty()) {
+    printData(frame, "cloud", cloud_str, current_len, YELLOW, "");
+  }
+  printData(frame, "cpu usage", cpu_usage_str, current_len, YELLOW, "");
+  printData(frame, "cpu split", cpu_split_str, current_len, YELLOW, "");
+  printData(frame, "per core", core_graph, current_len, YELLOW, "");
+  printData(frame, "load 1m", cpu_1_graph, current_len, GREEN, "");
+  printData(frame, "load 5m", cpu_5_graph, current_len, GREEN, "");
+  printData(frame, "load 15m", cpu_15_graph, current_len, GREEN, "");
+  printBorder(frame, layout, Border::Divider);
+
+  // One usage row and bar per volume, named by its mount point
+  if (report.timedOut(Collector::Disk)) {
+    printData(frame, "volume", TIMEOUT_TEXT, current_len, PINK, JAPANESE_DISK);
+  } else {
+    for (size_t i = 0; i < report.disks.size(); ++i) {
+      printData(frame, report.disks[i].mount, disk_usage_strs[i], current_len, PINK,
+                JAPANESE_DISK);
+      printData(frame, "disk usage", disk_graphs[i], current_len, PINK, "");
+    }
+  }
+  for (size_t row = 0; row < device_rows; ++row) {
+    printData(frame, report.disk_io.devices[device_order[row]].name, device_strs[row * 2],
+              current_len, PINK, "");
+    if (!device_strs[row * 2 + 1].empty()) {
+      printData(frame, "iops", device_strs[row * 2 + 1], current_len, PINK, "");
+    }
+    if (!device_graphs[row].empty()) {
+      printData(frame, "disk busy", device_graphs[row], current_len, PINK, "");
+    }
+  }
+  printBorder(frame, layout, Border::Divider);
+
+  printData(frame, "memory", mem_usage_str, current_len, PURPLE, JAPANESE_MEM);
+  printData(frame, "usage", mem_graph, current_len, PURPLE, "");
+  printData(frame, "mem split", mem_split_str, current_len, PURPLE, "");
+  if (report.mem.compressed > 0 && !report.timedOut(Collector::Memory)) {
+    printData(frame, "compressed", compressed_str, current_len, PURPLE, "");
+  }
+  if (!swap_str.empty() && !report.timedOut(Collector::Memory)) {
+    printData(frame, "swap", swap_str, current_len, PURPLE, "");
+  }
+  if (report.mem.pressure >= 0.0 && !report.timedOut(Collector::Memory)) {
+    printData(frame, "mem pressure", std::to_string(static_cast<int>(report.mem.pressure + 0.5)) + "%",
+              current_len, PURPLE, "");
+  }
+  printBorder(frame, layout, Border::Divider);
+
+  // Stalls, and the limits of the container the report runs in
+  if (!pressure_rows.empty()) {
+    for (const auto& row : pressure_rows) {
+      printData(frame, row.first, row.second, current_len, PINK, "");
+      if (cgroup_bar && row.first == "cgroup memory") {
+        printData(frame, "cgroup usage", cgroup_graph, current_len, PINK, "");
+      }
+    }
+    printBorder(frame, layout, Border::Divider);
+  }
+
+  // Rows are named after the process; --top turns the section on
+  if (!process_strs.empty()) {
+    const size_t cpu_rows = report.processes.by_cpu.size();
+    for (size_t row = 0; row < cpu_rows; ++row) {
+      printData(frame, report.processes.by_cpu[row].name, process_strs[row], current_len, YELLOW,
+                "");
+    }
+    for (size_t row = 0; row < report.processes.by_rss.size(); ++row) {
+      printData(frame, report.processes.by_rss[row].name, process_strs[cpu_rows + row],
+                current_len, PURPLE, "");
+    }
+    printBorder(frame, layout, Border::Divider);
+  }
+
+  printData(frame, "last login", login_time, current_len, CYAN, JAPANESE_TIME);
+  if (login_ip_shown) {
+    printData(frame, "login from", report.login.ip, current_len, CYAN, "");
+  }
+  printData(frame, "uptime", uptime, current_len, GREEN, "");
+
+  printBorder(frame, layout, Border::Bottom);
+}
+
+// Raw values for machines: bytes, seconds and unrounded percentages, with
+// none of the layout work the pretty renderer does. Fields whose collector
+// timed out are null and the collector is listed under "timed_out".
+inline void writeJsonReport(const Report& report, RenderBuffer& out) {
+  JsonWriter json(out);
+  const auto text = [&json, &report](const char* key, Collector id, const std::string& value) {
+    if (report.timedOut(id)) {
+      json.null(key);
+    } else {
+      json.field(key, value);
+    }
+  };
+  json.beginObject();
+
+  json.beginObject("os");
+  text("name", Collector::OsName, report.os_name);
+  text("kernel", Collector::Kernel, report.os_kernel);
+  json.endObject();
+
+  json.beginObject("network");
+  text("hostname", Collector::Hostname, report.net_hostname);
+  text("machine_ip", Collector::MachineIP, report.net_machine_ip);
+  text("client_ip", Collector::ClientIP, report.net_client_ip);
+  if (report.timedOut(Collector::DNS)) {
+    json.null("dns");
+  } else {
+    json.beginArray("dns");
+    for (const std::string& server : report.net_dns_ip) {
+      json.field(nullptr, server);
+    }
+    json.endArray();
+  }
+  // Only with --dns-probe
+  if (report.timedOut(Collector::DNSProbe)) {
+    json.null("dns_probe");
+  } else if (!report.dns_probe.empty()) {
+    json.beginArray("dns_probe");
+    for (const ResolverProbe& probe : report.dns_probe) {
+      json.beginObject();
+      json.field("server", probe.server);
+      json.field("status", resolverStatusName(probe.status));
+      if (probe.rtt_ms >= 0.0) {
+        json.field("rtt_ms", probe.rtt_ms);
+      } else {
+        json.null("rtt_ms");
+      }
+      json.endObject();
+    }
+    json.endArray();
   }
+  // Every interface with counters; rates are null until there are two samples
+  json.beginArray("interfaces");
+  for (size_t i = 0; i < report.net_sample.count; ++i) {
+    const InterfaceCounters& counters = report.net_sample.interfaces[i];
+    json.beginObject();
+    json.field("name", counters.name);
+    const InterfaceAddress* address = report.timedOut(Collector::MachineIP)
+        ? nullptr
+        : findAddress(report.net_addresses, counters.name);
+    if (address != nullptr && address->ipv4[0] != '\0') {
+      json.field("ipv4", address->ipv4);
+    } else {
+      json.null("ipv4");
+    }
+    if (address != nullptr && address->ipv6[0] != '\0') {
+      json.field("ipv6", address->ipv6);
+    } else {
+      json.null("ipv6");
+    }
+    json.field("rx_bytes", counters.rx_bytes);
+    json.field("tx_bytes", counters.tx_bytes);
+    json.field("rx_packets", counters.rx_packets);
+    json.field("tx_packets", counters.tx_packets);
+    json.field("rx_errors", counters.rx_errors);
+    json.field("tx_errors", counters.tx_errors);
+    if (counters.rx_rate >= 0.0) {
+      json.field("rx_bytes_per_second", counters.rx_rate);
+      json.field("tx_bytes_per_second", counters.tx_rate);
+    } else {
+      json.null("rx_bytes_per_second");
+      json.null("tx_bytes_per_second");
+    }
+    json.endObject();
+  }
+  json.endArray();
+  json.endObject();
 
-  const std::string cpu_1_graph =
-      drawBarGraph((cpu.load_1 / cpu.cores_logical) * 100.0, graph_width);
-  const std::string cpu_5_graph =
-      drawBarGraph((cpu.load_5 / cpu.cores_logical) * 100.0, graph_width);
-  const std::string cpu_15_graph =
-      drawBarGraph((cpu.load_15 / cpu.cores_logical) * 100.0, graph_width);
+  text("user", Collector::User, report.net_current_user);
+
+  if (report.timedOut(Collector::Platform)) {
+    json.null("platform");
+  } else {
+    const PlatformInfo& platform = report.platform;
+    const auto optional = [&json](const char* key, const std::string& value) {
+      if (value.empty()) {
+        json.null(key);
+      } else {
+        json.field(key, value);
+      }
+    };
+    json.beginObject("platform");
+    optional("hypervisor", platform.hypervisor);
+    optional("cloud", platform.cloud);
+    optional("instance_type", platform.instance);
+    json.endObject();
+  }
+
+  json.beginObject("cpu");
+  if (report.timedOut(Collector::CPUInfo)) {
+    json.null("model");
+    json.null("cores_physical");
+    json.null("cores_logical");
+    json.null("sockets");
+    json.null("topology");
+  } else {
+    json.field("model", report.cpu.model);
+    json.field("cores_physical", report.cpu.cores_physical);
+    json.field("cores_logical", report.cpu.cores_logical);
+    json.field("sockets", report.cpu.sockets);
+    const CPUTopology& topology = report.cpu.topology;
+    json.beginObject("topology");
+    json.field("threads_per_core", topology.threads_per_core);
+    json.beginArray("core_classes");
+    for (const CoreClass& core_class : topology.classes) {
+      json.beginObject();
+      json.field("name", core_class.name);
+      json.field("physical", core_class.physical);
+      json.field("logical", core_class.logical);
+      json.endObject();
+    }
+    json.endArray();
+    json.beginArray("caches");
+    for (const CacheInfo& cache : topology.caches) {
+      json.beginObject();
+      json.field("level", cache.level);
+      json.field("type", cache.kind == 'd' ? "data" : cache.kind == 'i' ? "instruction" : "unified");
+      json.field("size_bytes", cache.size);
+      json.field("shared_by", cache.shared_by);
+      json.field("instances", cache.instances);
+      json.endObject();
+    }
+    json.endArray();
+    json.beginArray("numa_nodes");
+    for (const NumaNode& node : topology.numa) {
+      json.beginObject();
+      json.field("id", node.id);
+      json.field("cpus", node.cpus);
+      json.endObject();
+    }
+    json.endArray();
+    json.endObject();
+  }
+  if (report.timedOut(Collector::Load)) {
+    json.null("load_1");
+    json.null("load_5");
+    json.null("load_15");
+  } else {
+    json.field("load_1", report.cpu.load_1);
+    json.field("load_5", report.cpu.load_5);
+    json.field("load_15", report.cpu.load_15);
+  }
+  json.beginObject("usage");
+  json.field("busy_percent", report.cpu_usage.busy);
+  json.field("user_percent", report.cpu_usage.user);
+  json.field("system_percent", report.cpu_usage.system);
+  json.field("iowait_percent", report.cpu_usage.iowait);
+  json.field("steal_percent", report.cpu_usage.steal);
+  json.beginArray("cores_busy_percent");
+  for (const double core : report.cpu_usage.cores) {
+    json.field(nullptr, core);
+  }
+  json.endArray();
+  json.endObject();
+  json.endObject();
+
+  if (report.timedOut(Collector::Memory)) {
+    json.null("memory");
+  } else {
+    json.beginObject("memory");
+    const MemInfo& mem = report.mem;
+    json.field("total_bytes", mem.total);
+    json.field("used_bytes", mem.used);
+    json.field("used_percent", mem.percent);
+    json.field("available_bytes", mem.available);
+    json.field("wired_bytes", mem.wired);
+    json.field("active_bytes", mem.active);
+    json.field("inactive_bytes", mem.inactive);
+    json.field("compressed_bytes", mem.compressed);
+    json.field("purgeable_bytes", mem.purgeable);
+    json.field("file_backed_bytes", mem.file_backed);
+    json.field("swap_total_bytes", mem.swap_total);
+    json.field("swap_used_bytes", mem.swap_used);
+    if (mem.pressure >= 0.0) {
+      json.field("pressure_percent", mem.pressure);
+    } else {
+      json.null("pressure_percent");
+    }
+    json.endObject();
+  }
+
+  // Each resource is null where the kernel has no PSI, and cgroup is null
+  // outside a limited cgroup v2
+  const auto pressure = [&json](const char* key, const PressureInfo& info) {
+    json.beginObject(key);
+    const std::pair<const char*, const StallAverages*> resources[] = {
+        {"cpu", &info.cpu}, {"memory", &info.memory}, {"io", &info.io}};
+    for (const auto& resource : resources) {
+      const StallAverages& stall = *resource.second;
+      if (!stall.present) {
+        json.null(resource.first);
+        continue;
+      }
+      json.beginObject(resource.first);
+      json.field("some_avg10", stall.some[0]);
+      json.field("some_avg60", stall.some[1]);
+      json.field("some_avg300", stall.some[2]);
+      json.field("full_avg10", stall.full[0]);
+      json.field("full_avg60", stall.full[1]);
+      json.field("full_avg300", stall.full[2]);
+      json.endObject();
+    }
+    json.endObject();
+  };
+  if (report.timedOut(Collector::Pressure)) {
+    json.null("pressure");
+    json.null("cgroup");
+  } else {
+    pressure("pressure", report.pressure);
+    const CgroupInfo& cgroup = report.cgroup;
+    if (cgroup.present) {
+      json.beginObject("cgroup");
+      json.field("path", cgroup.path);
+      if (cgroup.cpu_limit > 0.0) {
+        json.field("cpu_limit_cores", cgroup.cpu_limit);
+      } else {
+        json.null("cpu_limit_cores");
+      }
+      json.field("cpu_usage_usec", cgroup.cpu_usage_usec);
+      json.field("cpu_periods", cgroup.cpu_periods);
+      json.field("cpu_throttled_periods", cgroup.cpu_throttled_periods);
+      json.field("cpu_throttled_usec", cgroup.cpu_throttled_usec);
+      json.field("memory_current_bytes", cgroup.memory_current);
+      if (cgroup.memory_max > 0) {
+        json.field("memory_max_bytes", cgroup.memory_max);
+      } else {
+        json.null("memory_max_bytes");
+      }
+      json.field("io_read_bytes", cgroup.io_read_bytes);
+      json.field("io_write_bytes", cgroup.io_write_bytes);
+      json.field("io_read_ops", cgroup.io_read_ops);
+      json.field("io_write_ops", cgroup.io_write_ops);
+      pressure("pressure", cgroup.pressure);
+      json.endObject();
+    } else {
+      json.null("cgroup");
+    }
+  }
+
+  if (report.timedOut(Collector::Disk)) {
+    json.null("disks");
+  } else {
+    json.beginArray("disks");
+    for (const DiskInfo& disk : report.disks) {
+      json.beginObject();
+      json.field("mount", disk.mount);
+      json.field("fstype", disk.fstype);
+      json.field("total_bytes", disk.total);
+      json.field("used_bytes", disk.used);
+      json.field("used_percent", disk.percent);
+      json.endObject();
+    }
+    json.endArray();
+  }
+
+  // Every whole block device that did I/O; rates are null until there are
+  // two samples, and utilization is null where the platform has no busy time
+  json.beginArray("disk_io");
+  for (size_t i = 0; i < report.disk_io.count; ++i) {
+    const BlockDeviceCounters& device = report.disk_io.devices[i];
+    json.beginObject();
+    json.field("name", device.name);
+    json.field("reads", device.reads);
+    json.field("writes", device.writes);
+    json.field("read_bytes", device.read_bytes);
+    json.field("write_bytes", device.write_bytes);
+    if (device.read_rate >= 0.0) {
+      json.field("reads_per_second", device.read_iops);
+      json.field("writes_per_second", device.write_iops);
+      json.field("read_bytes_per_second", device.read_rate);
+      json.field("write_bytes_per_second", device.write_rate);
+      json.field("await_ms", device.await_ms);
+    } else {
+      json.null("reads_per_second");
+      json.null("writes_per_second");
+      json.null("read_bytes_per_second");
+      json.null("write_bytes_per_second");
+      json.null("await_ms");
+    }
+    if (device.utilization >= 0.0) {
+      json.field("utilization_percent", device.utilization);
+    } else {
+      json.null("utilization_percent");
+    }
+    json.endObject();
+  }
+  json.endArray();
+
+  if (report.timedOut(Collector::LastLogin)) {
+    json.null("login");
+  } else {
+    json.beginObject("login");
+    if (report.login.timestamp > 0) {
+      json.field("user", report.login.user);
+      json.field("tty", report.login.tty);
+      json.field("timestamp", report.login.timestamp);
+    } else {
+      json.null("user");
+      json.null("tty");
+      json.null("timestamp");
+    }
+    if (report.login.ip_present) {
+      json.field("host", report.login.ip);
+    } else {
+      json.null("host");
+    }
+    json.endObject();
+  }
+
+  // Only with --top; by_cpu is empty until there are two scans
+  if (report.processes.wanted > 0) {
+    const auto processes = [&json](const char* key, const std::vector<ProcessInfo>& list) {
+      json.beginArray(key);
+      for (const ProcessInfo& process : list) {
+        json.beginObject();
+        json.field("pid", process.pid);
+        json.field("name", process.name);
+        if (process.cpu_percent >= 0.0) {
+          json.field("cpu_percent", process.cpu_percent);
+        } else {
+          json.null("cpu_percent");
+        }
+        json.field("rss_bytes", process.rss);
+        json.endObject();
+      }
+      json.endArray();
+    };
+    json.beginObject("processes");
+    processes("by_cpu", report.processes.by_cpu);
+    processes("by_rss", report.processes.by_rss);
+    json.endObject();
+  }
+
+  if (report.uptime_seconds >= 0 && !report.timedOut(Collector::Uptime)) {
+    json.field("uptime_seconds", report.uptime_seconds);
+  } else {
+    json.null("uptime_seconds");
+  }
+
+  json.beginArray("timed_out");
+  for (const CollectorSpec& spec : COLLECTORS) {
+    if (report.timedOut(spec.id)) {
+      json.field(nullptr, spec.name);
+    }
+  }
+  json.endArray();
+
+  json.endObject();
+  out.append('\n');
+}
+
+// Label values escape backslash, double quote and newline
+inline void appendLabelValue(RenderBuffer& out, const std::string& value) {
+  for (const char c : value) {
+    if (c == '\\' || c == '"') {
+      out.append('\\');
+      out.append(c);
+    } else if (c == '\n') {
+      out.append("\\n");
+    } else {
+      out.append(c);
+    }
+  }
+}
+
+inline void appendMetricHeader(RenderBuffer& out, const char* name, const char* help,
+                               const char* type = "gauge") {
+  out.append("# HELP ");
+  out.append(name);
+  out.append(' ');
+  out.append(help);
+  out.append("\n# TYPE ");
+  out.append(name);
+  out.append(' ');
+  out.append(type);
+  out.append('\n');
+}
+
+// One sample line; labels is either empty or a preformatted `{k="v",...}`.
+// Whole numbers such as byte counts are printed exactly, not in exponent form.
+inline void appendSample(RenderBuffer& out, const char* name, const char* labels, double value) {
+  char digits[32];
+  const bool whole = value == std::floor(value) && std::fabs(value) < 9007199254740992.0;
+  const int len = snprintf(digits, sizeof(digits), whole ? "%.0f" : "%.10g", value);
+  out.append(name);
+  out.append(labels);
+  out.append(' ');
+  out.append(digits, static_cast<size_t>(len));
+  out.append('\n');
+}
+
+inline void appendGauge(RenderBuffer& out, const char* name, const char* help, double value) {
+  appendMetricHeader(out, name, help);
+  appendSample(out, name, "", value);
+}
+
+// Counter samples carry a _total suffix. OpenMetrics names the family
+// without it; the classic format has no families, and its parser rejects a
+// TYPE line whose name differs from the samples that follow.
+inline void appendCounterHeader(RenderBuffer& out, const char* family, const char* sample,
+                                const char* help, bool classic) {
+  appendMetricHeader(out, classic ? sample : family, help, "counter");
+}
+
+// Text exposition of the collected values: OpenMetrics, or with classic set
+// the classic Prometheus text format for node_exporter's textfile
+// collector. The two differ only in how counters are declared.
+inline void writePrometheusReport(const Report& report, RenderBuffer& out, bool classic = false) {
+  appendMetricHeader(out, "machine_report_info", "Static system facts, value is always 1.");
+  const auto label = [&out, &report](Collector id, const std::string& value) {
+    appendLabelValue(out, report.timedOut(id) ? TIMEOUT_TEXT : value);
+  };
+  out.append("machine_report_info{os=\"");
+  label(Collector::OsName, report.os_name);
+  out.append("\",kernel=\"");
+  label(Collector::Kernel, report.os_kernel);
+  out.append("\",hostname=\"");
+  label(Collector::Hostname, report.net_hostname);
+  out.append("\",cpu_model=\"");
+  label(Collector::CPUInfo, report.cpu.model);
+  out.append("\",hypervisor=\"");
+  label(Collector::Platform,
+        report.platform.hypervisor.empty() ? "none" : report.platform.hypervisor);
+  out.append("\",cloud=\"");
+  label(Collector::Platform, report.platform.cloud);
+  out.append("\"} 1\n");
+
+  // Timed-out values are left out rather than reported as zero
+  if (!report.timedOut(Collector::Load)) {
+    appendGauge(out, "machine_report_load1", "1-minute load average.", report.cpu.load_1);
+    appendGauge(out, "machine_report_load5", "5-minute load average.", report.cpu.load_5);
+    appendGauge(out, "machine_report_load15", "15-minute load average.", report.cpu.load_15);
+  }
+
+  if (!report.timedOut(Collector::CPUInfo)) {
+    appendMetricHeader(out, "machine_report_cpu_cores", "Number of CPU cores.");
+    appendSample(out, "machine_report_cpu_cores", "{type=\"physical\"}", report.cpu.cores_physical);
+    appendSample(out, "machine_report_cpu_cores", "{type=\"logical\"}", report.cpu.cores_logical);
+    appendGauge(out, "machine_report_cpu_sockets", "Number of CPU packages.", report.cpu.sockets);
+  }
+
+  const CPUUsage& usage = report.cpu_usage;
+  appendMetricHeader(out, "machine_report_cpu_usage_ratio",
+                     "Share of CPU time over the sampling window by mode.");
+  appendSample(out, "machine_report_cpu_usage_ratio", "{mode=\"busy\"}", usage.busy / 100.0);
+  appendSample(out, "machine_report_cpu_usage_ratio", "{mode=\"user\"}", usage.user / 100.0);
+  appendSample(out, "machine_report_cpu_usage_ratio", "{mode=\"system\"}", usage.system / 100.0);
+  appendSample(out, "machine_report_cpu_usage_ratio", "{mode=\"iowait\"}", usage.iowait / 100.0);
+  appendSample(out, "machine_report_cpu_usage_ratio", "{mode=\"steal\"}", usage.steal / 100.0);
+
+  if (!report.timedOut(Collector::Memory)) {
+    appendGauge(out, "machine_report_memory_total_bytes", "Physical memory installed.",
+                static_cast<double>(report.mem.total));
+    appendGauge(out, "machine_report_memory_used_bytes", "Physical memory in use.",
+                static_cast<double>(report.mem.used));
+    appendGauge(out, "machine_report_memory_available_bytes",
+                "Memory that can be handed out without swapping.",
+                static_cast<double>(report.mem.available));
+    appendMetricHeader(out, "machine_report_memory_bytes",
+                       "Memory by kernel accounting category; categories overlap.");
+    const std::pair<const char*, uint64_t> categories[] = {
+        {"{category=\"wired\"}", report.mem.wired},
+        {"{category=\"active\"}", report.mem.active},
+        {"{category=\"inactive\"}", report.mem.inactive},
+        {"{category=\"compressed\"}", report.mem.compressed},
+        {"{category=\"purgeable\"}", report.mem.purgeable},
+        {"{category=\"file_backed\"}", report.mem.file_backed}};
+    for (const auto& category : categories) {
+      appendSample(out, "machine_report_memory_bytes", category.first,
+                   static_cast<double>(category.second));
+    }
+    appendGauge(out, "machine_report_swap_total_bytes", "Swap space configured.",
+                static_cast<double>(report.mem.swap_total));
+    appendGauge(out, "machine_report_swap_used_bytes", "Swap space in use.",
+                static_cast<double>(report.mem.swap_used));
+    if (report.mem.pressure >= 0.0) {
+      appendGauge(out, "machine_report_memory_pressure_ratio",
+                  "Memory pressure as the kernel rates it, 0 to 1.", report.mem.pressure / 100.0);
+    }
+  }
+
+  if (!report.timedOut(Collector::Pressure)) {
+    // 10-second averages; scope tells host stalls from the cgroup's own
+    const auto stalls = [&out](const char* name, const char* scope, const PressureInfo& info,
+                               bool full) {
+      const std::pair<const char*, const StallAverages*> resources[] = {
+          {"cpu", &info.cpu}, {"memory", &info.memory}, {"io", &info.io}};
+      for (const auto& resource : resources) {
+        if (!resource.second->present) continue;
+        char labels[64];
+        snprintf(labels, sizeof(labels), "{scope=\"%s\",resource=\"%s\"}", scope,
+                 resource.first);
+        appendSample(out, name, labels,
+                     (full ? resource.second->full[0] : resource.second->some[0]) / 100.0);
+      }
+    };
+    const CgroupInfo& cgroup = report.cgroup;
+    const bool have_pressure = report.pressure.cpu.present || report.pressure.memory.present ||
+                               report.pressure.io.present || cgroup.present;
+    for (const bool full : {false, true}) {
+      if (!have_pressure) break;
+      const char* name =
+          full ? "machine_report_pressure_full_ratio" : "machine_report_pressure_some_ratio";
+      appendMetricHeader(out, name,
+                         full ? "Share of the last 10 s in which all tasks stalled on the resource."
+                              : "Share of the last 10 s in which some task stalled on the resource.");
+      stalls(name, "host", report.pressure, full);
+      if (cgroup.present) {
+        stalls(name, "cgroup", cgroup.pressure, full);
+      }
+    }
+    if (cgroup.present) {
+      if (cgroup.cpu_limit > 0.0) {
+        appendGauge(out, "machine_report_cgroup_cpu_limit_cores", "CPU quota of the cgroup.",
+                    cgroup.cpu_limit);
+      }
+      appendCounterHeader(out, "machine_report_cgroup_cpu_throttled_periods",
+                          "machine_report_cgroup_cpu_throttled_periods_total",
+                          "Quota periods in which the cgroup ran out of CPU.", classic);
+      appendSample(out, "machine_report_cgroup_cpu_throttled_periods_total", "",
+                   static_cast<double>(cgroup.cpu_throttled_periods));
+      appendGauge(out, "machine_report_cgroup_memory_used_bytes", "Memory charged to the cgroup.",
+                  static_cast<double>(cgroup.memory_current));
+      if (cgroup.memory_max > 0) {
+        appendGauge(out, "machine_report_cgroup_memory_limit_bytes", "Memory limit of the cgroup.",
+                    static_cast<double>(cgroup.memory_max));
+      }
+    }
+  }
+
+  if (!report.timedOut(Collector::Disk)) {
+    // Mount points are arbitrary bytes, so the label set is escaped into a
+    // scratch buffer once per volume and shared by both metrics
+    std::vector<std::string> labels;
+    RenderBuffer scratch(256);
+    for (const DiskInfo& disk : report.disks) {
+      scratch.clear();
+      scratch.append("{mountpoint=\"");
+      appendLabelValue(scratch, disk.mount);
+      scratch.append("\",fstype=\"");
+      appendLabelValue(scratch, disk.fstype);
+      scratch.append("\"}");
+      labels.emplace_back(scratch.data(), scratch.size);
+    }
+    appendMetricHeader(out, "machine_report_filesystem_size_bytes", "Filesystem size.");
+    for (size_t i = 0; i < report.disks.size(); ++i) {
+      appendSample(out, "machine_report_filesystem_size_bytes", labels[i].c_str(),
+                   static_cast<double>(report.disks[i].total));
+    }
+    appendMetricHeader(out, "machine_report_filesystem_used_bytes",
+                       "Filesystem space in use, as df reports it.");
+    for (size_t i = 0; i < report.disks.size(); ++i) {
+      appendSample(out, "machine_report_filesystem_used_bytes", labels[i].c_str(),
+                   static_cast<double>(report.disks[i].used));
+    }
+  }
+
+  // Counters only; rates are left to rate() on the scraping side
+  struct InterfaceMetric {
+    const char* name;
+    const char* help;
+    uint64_t InterfaceCounters::*counter;
+  };
+  static constexpr InterfaceMetric INTERFACE_METRICS[] = {
+      {"machine_report_network_receive_bytes", "Bytes received.", &InterfaceCounters::rx_bytes},
+      {"machine_report_network_transmit_bytes", "Bytes sent.", &InterfaceCounters::tx_bytes},
+      {"machine_report_network_receive_packets", "Packets received.",
+       &InterfaceCounters::rx_packets},
+      {"machine_report_network_transmit_packets", "Packets sent.", &InterfaceCounters::tx_packets},
+      {"machine_report_network_receive_errors", "Receive errors.", &InterfaceCounters::rx_errors},
+      {"machine_report_network_transmit_errors", "Transmit errors.",
+       &InterfaceCounters::tx_errors},
+  };
+  const NetSample& net = report.net_sample;
+  std::vector<std::string> device_labels;
+  RenderBuffer scratch(64);
+  for (size_t i = 0; i < net.count; ++i) {
+    scratch.clear();
+    scratch.append("{device=\"");
+    appendLabelValue(scratch, net.interfaces[i].name);
+    scratch.append("\"}");
+    device_labels.emplace_back(scratch.data(), scratch.size);
+  }
+  for (const InterfaceMetric& metric : INTERFACE_METRICS) {
+    if (net.count == 0) break;
+    char sample_name[64];
+    snprintf(sample_name, sizeof(sample_name), "%s_total", metric.name);
+    appendCounterHeader(out, metric.name, sample_name, metric.help, classic);
+    for (size_t i = 0; i < net.count; ++i) {
+      appendSample(out, sample_name, device_labels[i].c_str(),
+                   static_cast<double>(net.interfaces[i].*metric.counter));
+    }
+  }
+
+  struct DeviceMetric {
+    const char* name;
+    const char* help;
+    uint64_t BlockDeviceCounters::*counter;
+    double scale;
+  };
+  static constexpr DeviceMetric DEVICE_METRICS[] = {
+      {"machine_report_disk_reads_completed", "Reads completed.", &BlockDeviceCounters::reads, 1.0},
+      {"machine_report_disk_writes_completed", "Writes completed.", &BlockDeviceCounters::writes,
+       1.0},
+      {"machine_report_disk_read_bytes", "Bytes read.", &BlockDeviceCounters::read_bytes, 1.0},
+      {"machine_report_disk_written_bytes", "Bytes written.", &BlockDeviceCounters::write_bytes,
+       1.0},
+      {"machine_report_disk_read_time_seconds", "Time spent on reads.",
+       &BlockDeviceCounters::read_us, 1e-6},
+      {"machine_report_disk_write_time_seconds", "Time spent on writes.",
+       &BlockDeviceCounters::write_us, 1e-6},
+      {"machine_report_disk_io_time_seconds", "Time with I/O in flight.",
+       &BlockDeviceCounters::busy_us, 1e-6},
+  };
+  const DiskIOSample& io = report.disk_io;
+  device_labels.clear();
+  for (size_t i = 0; i < io.count; ++i) {
+    scratch.clear();
+    scratch.append("{device=\"");
+    appendLabelValue(scratch, io.devices[i].name);
+    scratch.append("\"}");
+    device_labels.emplace_back(scratch.data(), scratch.size);
+  }
+  // Busy time is known for every device or for none
+  const bool busy_known = io.count > 0 && io.devices[0].busy_known;
+  for (const DeviceMetric& metric : DEVICE_METRICS) {
+    if (io.count == 0) break;
+    if (metric.counter == &BlockDeviceCounters::busy_us && !busy_known) continue;
+    char sample_name[64];
+    snprintf(sample_name, sizeof(sample_name), "%s_total", metric.name);
+    appendCounterHeader(out, metric.name, sample_name, metric.help, classic);
+    for (size_t i = 0; i < io.count; ++i) {
+      appendSample(out, sample_name, device_labels[i].c_str(),
+                   static_cast<double>(io.devices[i].*metric.counter) * metric.scale);
+    }
+  }
+
+  if (!report.dns_probe.empty() && !report.timedOut(Collector::DNSProbe)) {
+    std::vector<std::string> server_labels;
+    for (const ResolverProbe& probe : report.dns_probe) {
+      scratch.clear();
+      scratch.append("{server=\"");
+      appendLabelValue(scratch, probe.server);
+      scratch.append("\"}");
+      server_labels.emplace_back(scratch.data(), scratch.size);
+    }
+    appendMetricHeader(out, "machine_report_dns_up",
+                       "1 if the nameserver answered the probe without an error.");
+    for (size_t i = 0; i < report.dns_probe.size(); ++i) {
+      const ResolverStatus status = report.dns_probe[i].status;
+      appendSample(out, "machine_report_dns_up", server_labels[i].c_str(),
+                   status == ResolverStatus::Ok || status == ResolverStatus::Slow ? 1 : 0);
+    }
+    appendMetricHeader(out, "machine_report_dns_rtt_seconds",
+                       "Round trip of the nameserver probe, for servers that answered.");
+    for (size_t i = 0; i < report.dns_probe.size(); ++i) {
+      if (report.dns_probe[i].rtt_ms < 0.0) continue;
+      appendSample(out, "machine_report_dns_rtt_seconds", server_labels[i].c_str(),
+                   report.dns_probe[i].rtt_ms / 1000.0);
+    }
+  }
+
+  if (report.uptime_seconds >= 0 && !report.timedOut(Collector::Uptime)) {
+    appendGauge(out, "machine_report_uptime_seconds", "Time since boot.",
+                static_cast<double>(report.uptime_seconds));
+  }
+
+  appendMetricHeader(out, "machine_report_collector_timeout",
+                     "1 if the collector missed its deadline and its values are missing.");
+  for (const CollectorSpec& spec : COLLECTORS) {
+    char labels[48];
+    snprintf(labels, sizeof(labels), "{collector=\"%s\"}", spec.name);
+    appendSample(out, "machine_report_collector_timeout", labels, report.timedOut(spec.id) ? 1 : 0);
+  }
+  out.append("# EOF\n");
+}
+
+inline void printUsage(FILE* out) {
+  fprintf(out,
+          "usage: machine_report [--json | --prometheus] [--textfile <path>]\n"
+          "                      [--watch <seconds>] [--cpu-window <ms>]\n"
+          "                      [--daemon | --client] [--socket <path>]\n"
+          "                      [--profile <trace.json>]\n"
+          "                      [--bar-thresholds <warn>,<critical>] [--smooth-bars]\n"
+          "                      [--fs-types <type,...>] [--interfaces <n>] [--top <n>]\n"
+          "                      [--io-devices <n>] [--dns-probe <ms>] [--no-cache]\n"
+          "  --json                 print raw values as one JSON object instead of\n"
+          "                         the report (one object per line with --watch)\n"
+          "  --prometheus           print OpenMetrics text exposition\n"
+          "  --textfile <path>      atomically replace <path> with the metrics, for\n"
+          "                         node_exporter's textfile collector, in the\n"
+          "                         classic Prometheus text format (counters are\n"
+          "                         declared by their _total names; rewritten every\n"
+          "                         tick with --watch)\n"
+          "  -w, --watch <seconds>  keep running and refresh load, memory, pressure,\n"
+          "                         disk, uptime and CPU usage every <seconds>\n"
+          "                         (fractions allowed)\n"
+          "  --cpu-window <ms>      CPU utilization sampling window; 0 reports the\n"
+          "                         average since boot (default 0, or %d with\n"
+          "                         --watch, --daemon or --top)\n"
+          "  --daemon               stay resident, sample every --interval seconds\n"
+          "                         and serve reports on the socket\n"
+          "  --client               print the daemon's report, or collect directly\n"
+          "                         when no daemon is listening\n"
+          "  --socket <path>        daemon socket (default %s)\n"
+          "  --interval <seconds>   daemon sampling interval (default 5)\n"
+          "  --profile <path>       time every collector and render phase, print\n"
+          "                         the breakdown to stderr and write a Chrome\n"
+          "                         trace (chrome://tracing, Perfetto) to <path>\n"
+          "  --bar-thresholds <warn>,<critical>\n"
+          "                         percentages where bars turn yellow and pink\n"
+          "                         (default 50,75)\n"
+          "  --smooth-bars          draw bars with solid blocks and eighth-cell\n"
+          "                         precision\n"
+          "  --fs-types <type,...>  filesystem types shown as volumes; read-only\n"
+          "                         mounts are always left out (default\n"
+          "                         %s)\n"
+          "  --interfaces <n>       network interfaces shown, busiest first\n"
+          "                         (default 3, 0 hides them)\n"
+          "  --io-devices <n>       block devices shown with their I/O rates, most\n"
+          "                         saturated first (default 2, 0 hides them)\n"
+          "  --top <n>              list the <n> processes using the most CPU over\n"
+          "                         the sampling window and the most memory\n"
+          "                         (default 0, off); every process is read on\n"
+          "                         each sample, so hosts with many processes\n"
+          "                         take longer\n"
+          "  --dns-probe <ms>       query every nameserver and show its response\n"
+          "                         time, waiting at most <ms> (1-%d; default 0,\n"
+          "                         off)\n"
+          "  --no-cache             collect every static fact afresh and leave the\n"
+          "                         cache in $XDG_CACHE_HOME/machine_report alone\n"
+          "  -h, --help             show this help\n",
+          DEFAULT_CPU_WINDOW_MS, DEFAULT_SOCKET_PATH, DEFAULT_FS_TYPES, DNS_PROBE_MAX_MS);
+}
+
+inline Options parseOptions(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "-h" || arg == "--help") {
+      printUsage(stdout);
+      exit(0);
+    } else if (arg == "-w" || arg == "--watch") {
+      char* end = nullptr;
+      options.watch_interval = i + 1 < argc ? strtod(argv[++i], &end) : 0.0;
+      if (end == nullptr || *end != '\0' || !(options.watch_interval > 0.0)) {
+        fprintf(stderr, "machine_report: --watch needs a positive interval in seconds\n");
+        exit(2);
+      }
+    } else if (arg == "--json") {
+      options.format = OutputFormat::Json;
+    } else if (arg == "--prometheus") {
+      options.format = options.textfile ? OutputFormat::PrometheusText : OutputFormat::Prometheus;
+    } else if (arg == "--textfile") {
+      if (i + 1 >= argc || argv[i + 1][0] == '\0') {
+        fprintf(stderr, "machine_report: --textfile needs a path\n");
+        exit(2);
+      }
+      options.textfile = argv[++i];
+      options.format = OutputFormat::PrometheusText;
+    } else if (arg == "--cpu-window") {
+      char* end = nullptr;
+      const long window = i + 1 < argc ? strtol(argv[++i], &end, 10) : -1;
+      if (end == nullptr || *end != '\0' || window < 0 || window > 10000) {
+        fprintf(stderr, "machine_report: --cpu-window needs 0-10000 milliseconds\n");
+        exit(2);
+      }
+      options.cpu_window_ms = static_cast<int>(window);
+    } else if (arg == "--daemon") {
+      options.daemon = true;
+    } else if (arg == "--client") {
+      options.client = true;
+    } else if (arg == "--socket") {
+      if (i + 1 >= argc || argv[i + 1][0] == '\0') {
+        fprintf(stderr, "machine_report: --socket needs a path\n");
+        exit(2);
+      }
+      options.socket_path = argv[++i];
+    } else if (arg == "--profile") {
+      if (i + 1 >= argc || argv[i + 1][0] == '\0') {
+        fprintf(stderr, "machine_report: --profile needs a trace file path\n");
+        exit(2);
+      }
+      options.profile_path = argv[++i];
+    } else if (arg == "--bar-thresholds") {
+      char* end = nullptr;
+      const char* value = i + 1 < argc ? argv[++i] : "";
+      options.render.bars.warn = strtod(value, &end);
+      const bool have_comma = end != value && *end == ',';
+      if (have_comma) {
+        options.render.bars.critical = strtod(end + 1, &end);
+      }
+      if (!have_comma || *end != '\0' || !(options.render.bars.warn >= 0.0) ||
+          !(options.render.bars.critical >= options.render.bars.warn)) {
+        fprintf(stderr, "machine_report: --bar-thresholds needs <warn>,<critical> percentages "
+                        "with warn <= critical\n");
+        exit(2);
+      }
+    } else if (arg == "--fs-types") {
+      if (i + 1 >= argc || argv[i + 1][0] == '\0') {
+        fprintf(stderr, "machine_report: --fs-types needs a comma-separated list\n");
+        exit(2);
+      }
+      options.fs_types = argv[++i];
+    } else if (arg == "--interfaces") {
+      char* end = nullptr;
+      const long rows = i + 1 < argc ? strtol(argv[++i], &end, 10) : -1;
+      if (end == nullptr || *end != '\0' || rows < 0 || rows > static_cast<long>(MAX_INTERFACES)) {
+        fprintf(stderr, "machine_report: --interfaces needs 0-%zu\n", MAX_INTERFACES);
+        exit(2);
+      }
+      options.render.interface_rows = static_cast<size_t>(rows);
+    } else if (arg == "--io-devices") {
+      char* end = nullptr;
+      const long rows = i + 1 < argc ? strtol(argv[++i], &end, 10) : -1;
+      if (end == nullptr || *end != '\0' || rows < 0 ||
+          rows > static_cast<long>(MAX_BLOCK_DEVICES)) {
+        fprintf(stderr, "machine_report: --io-devices needs 0-%zu\n", MAX_BLOCK_DEVICES);
+        exit(2);
+      }
+      options.render.io_device_rows = static_cast<size_t>(rows);
+    } else if (arg == "--top") {
+      char* end = nullptr;
+      const long rows = i + 1 < argc ? strtol(argv[++i], &end, 10) : -1;
+      if (end == nullptr || *end != '\0' || rows < 0 || rows > 100) {
+        fprintf(stderr, "machine_report: --top needs 0-100\n");
+        exit(2);
+      }
+      options.top_processes = static_cast<size_t>(rows);
+    } else if (arg == "--dns-probe") {
+      char* end = nullptr;
+      const long deadline = i + 1 < argc ? strtol(argv[++i], &end, 10) : -1;
+      if (end == nullptr || *end != '\0' || deadline < 0 || deadline > DNS_PROBE_MAX_MS) {
+        fprintf(stderr, "machine_report: --dns-probe needs 0-%d milliseconds\n", DNS_PROBE_MAX_MS);
+        exit(2);
+      }
+      options.dns_probe_ms = static_cast<int>(deadline);
+    } else if (arg == "--no-cache") {
+      options.static_cache = false;
+    } else if (arg == "--smooth-bars") {
+      options.render.bars.eighths = true;
+    } else if (arg == "--interval") {
+      char* end = nullptr;
+      options.daemon_interval = i + 1 < argc ? strtod(argv[++i], &end) : 0.0;
+      if (end == nullptr || *end != '\0' || !(options.daemon_interval > 0.0)) {
+        fprintf(stderr, "machine_report: --interval needs a positive number of seconds\n");
+        exit(2);
+      }
+    } else {
+      fprintf(stderr, "machine_report: unknown option '%s'\n", argv[i]);
+      printUsage(stderr);
+      exit(2);
+    }
+  }
+  if (options.daemon && (options.client || options.watch_interval > 0.0 || options.textfile)) {
+    fprintf(stderr, "machine_report: --daemon cannot be combined with --client, --watch or "
+                    "--textfile\n");
+    exit(2);
+  }
+  if (options.profile_path && (options.daemon || options.watch_interval > 0.0)) {
+    fprintf(stderr, "machine_report: --profile covers a single run, not --watch or --daemon\n");
+    exit(2);
+  }
+  if (options.client && options.watch_interval > 0.0) {
+    fprintf(stderr, "machine_report: --client cannot be combined with --watch\n");
+    exit(2);
+  }
+  if (options.cpu_window_ms < 0) {
+    const bool repeats = options.daemon || options.watch_interval > 0.0;
+    options.cpu_window_ms = repeats || options.top_processes > 0 ? DEFAULT_CPU_WINDOW_MS : 0;
+  }
+  return options;
+}
+
+volatile sig_atomic_t g_stop = 0;
+
+inline void onStopSignal(int) {
+  g_stop = 1;
+}
+
+// Without SA_RESTART, so a stop signal also interrupts a blocking sleep or
+// accept()
+inline void installStopHandlers() {
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = onStopSignal;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGINT, &action, nullptr);
+  sigaction(SIGTERM, &action, nullptr);
+  sigaction(SIGHUP, &action, nullptr);
+}
+
+// Formats the report in the selected output format
+inline void formatReport(const Report& report, OutputFormat format, const RenderOptions& style,
+                         Frame& frame) {
+  switch (format) {
+    case OutputFormat::Pretty:
+      renderReport(report, style, frame);
+      break;
+    case OutputFormat::Json:
+      writeJsonReport(report, frame.buf);
+      break;
+    case OutputFormat::Prometheus:
+      writePrometheusReport(report, frame.buf);
+      break;
+    case OutputFormat::PrometheusText:
+      writePrometheusReport(report, frame.buf, true);
+      break;
+  }
+}
+
+// Replaces path with the buffer contents by writing a temporary file in the
+// same directory and renaming it over the target, so readers never see a
+// partial file
+inline bool writeFileAtomically(const char* path, const RenderBuffer& out) {
+  char tmp_path[4096];
+  snprintf(tmp_path, sizeof(tmp_path), "%s.%ld.tmp", path, static_cast<long>(getpid()));
+  const int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    fprintf(stderr, "machine_report: cannot create %s: %s\n", tmp_path, strerror(errno));
+    return false;
+  }
+  const bool written = out.flush(fd);
+  if (close(fd) != 0 || !written || rename(tmp_path, path) != 0) {
+    fprintf(stderr, "machine_report: cannot write %s: %s\n", path, strerror(errno));
+    unlink(tmp_path);
+    return false;
+  }
+  return true;
+}
+
+inline bool emitOutput(const Options& options, const RenderBuffer& out) {
+  return options.textfile != nullptr ? writeFileAtomically(options.textfile, out)
+                                     : out.flush(STDOUT_FILENO);
+}
+
+// Sleeps for interval seconds or until a stop signal arrives
+inline void sleepInterval(double interval) {
+  struct timespec remaining;
+  remaining.tv_sec = static_cast<time_t>(interval);
+  remaining.tv_nsec = static_cast<long>((interval - static_cast<double>(remaining.tv_sec)) * 1e9);
+  while (!g_stop && nanosleep(&remaining, &remaining) != 0) {
+  }
+}
+
+// Redraws the report in place every interval. Rows are addressed with cursor
+// positioning and only rows that differ from the previous frame are written;
+// a change in box width (the top border) or row count repaints everything.
+inline int watchReport(Report& report, const Options& options) {
+  installStopHandlers();
+
+  // Machine formats are simply re-emitted whole every tick
+  if (options.format != OutputFormat::Pretty) {
+    Frame frame;
+    while (!g_stop) {
+      frame.clear();
+      formatReport(report, options.format, options.render, frame);
+      emitOutput(options, frame.buf);
+      sleepInterval(options.watch_interval);
+      if (!g_stop) {
+        collectDynamic(report);
+      }
+    }
+    return 0;
+  }
+
+  Frame previous;
+  Frame frame;
+  RenderBuffer out;
+  out.append("\033[?25l");  // hide the cursor while redrawing
+  while (!g_stop) {
+    frame.clear();
+    renderReport(report, options.render, frame);
 
-  const std::string mem_graph = drawBarGraph(mem.percent, graph_width);
-  const std::string disk_graph = drawBarGraph(disk.percent, graph_width);
+    const bool repaint = frame.rows() != previous.rows() || frame.row(0) != previous.row(0);
+    if (repaint) {
+      out.append("\033[H\033[2J");
+    }
+    for (size_t i = 0; i < frame.rows(); ++i) {
+      const std::string_view row = frame.row(i);
+      if (!repaint && row == previous.row(i)) continue;
+      out.append("\033[");
+      out.appendInt(static_cast<long>(i + 1));
+      out.append(";1H");
+      out.append(row.data(), row.size());
+    }
+    out.flush(STDOUT_FILENO);
+    out.clear();
+    std::swap(previous, frame);
+
+    sleepInterval(options.watch_interval);
+    if (!g_stop) {
+      collectDynamic(report);
+    }
+  }
+  out.append("\033[");
+  out.appendInt(static_cast<long>(previous.rows() + 1));
+  out.append(";1H\033[?25h");
+  out.flush(STDOUT_FILENO);
+  return 0;
+}
+
+// ---- Daemon mode: a resident sampler serves reports over a Unix socket ----
+//
+// A client sends one request line, "<format> <client address>\n", where the
+// format is p (pretty), j (JSON), m (OpenMetrics) or t (classic Prometheus
+// text) and the address is the caller's SSH client IP or N/A. The daemon
+// answers with the rendered report and closes the connection. The user is
+// taken from the peer credentials, not from the request.
+
+inline char formatCode(OutputFormat format) {
+  switch (format) {
+    case OutputFormat::Json:
+      return 'j';
+    case OutputFormat::Prometheus:
+      return 'm';
+    case OutputFormat::PrometheusText:
+      return 't';
+    case OutputFormat::Pretty:
+      break;
+  }
+  return 'p';
+}
+
+inline OutputFormat formatFromCode(char code) {
+  switch (code) {
+    case 'j':
+      return OutputFormat::Json;
+    case 'm':
+      return OutputFormat::Prometheus;
+    case 't':
+      return OutputFormat::PrometheusText;
+    default:
+      return OutputFormat::Pretty;
+  }
+}
+
+inline bool fillSocketAddress(const char* path, struct sockaddr_un& addr) {
+  const size_t len = strlen(path);
+  if (len >= sizeof(addr.sun_path)) {
+    return false;
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  memcpy(addr.sun_path, path, len);
+  return true;
+}
+
+// Stream socket to path with both directions bounded by timeout_ms, or -1
+inline int connectSocket(const char* path, int timeout_ms) {
+  struct sockaddr_un addr;
+  if (!fillSocketAddress(path, addr)) {
+    return -1;
+  }
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  fcntl(fd, F_SETFD, FD_CLOEXEC);
+  struct timeval timeout;
+  timeout.tv_sec = timeout_ms / 1000;
+  timeout.tv_usec = (timeout_ms % 1000) * 1000;
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+  if (connect(fd, reinterpret_cast<const struct sockaddr*>(&addr), sizeof(addr)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// The latest published snapshot. The sampler fills a private Report and
+// swaps it in, so the lock is only held for the swap and for rendering.
+struct DaemonState {
+  std::mutex mutex;
+  std::condition_variable wake;
+  bool stopping = false;
+  Report snapshot;
+};
+
+// Refreshes everything that can change while the machine is up: the dynamic
+// values plus addresses, nameservers and their health, and the last login
+inline void runSampler(DaemonState& state, Report report, double interval) {
+  const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      std::chrono::duration<double>(interval));
+  const uint32_t probe = g_dns_probe_ms > 0 ? collectorBit(Collector::DNSProbe) : 0;
+  // Swapped with the snapshot each tick, so the two take turns and copying
+  // into one reuses what it already allocated
+  Report published;
+  std::unique_lock<std::mutex> lock(state.mutex);
+  while (!state.wake.wait_for(lock, period, [&state] { return state.stopping; })) {
+    lock.unlock();
+    collectDynamic(report, DYNAMIC_COLLECTORS | collectorBit(Collector::MachineIP) |
+                               collectorBit(Collector::DNS) | probe |
+                               collectorBit(Collector::LastLogin));
+    published = report;
+    lock.lock();
+    std::swap(state.snapshot, published);
+  }
+}
+
+// Answers one connection from the snapshot. Slow or silent clients are cut
+// off by the socket timeouts so they cannot stall the clients queued behind.
+inline void serveClient(int fd, DaemonState& state, const RenderOptions& style, Frame& frame) {
+  struct timeval timeout = {0, 200000};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+  char request[96];
+  size_t len = 0;
+  while (len < sizeof(request) - 1 && memchr(request, '\n', len) == nullptr) {
+    const ssize_t n = read(fd, request + len, sizeof(request) - 1 - len);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+    len += static_cast<size_t>(n);
+  }
+  request[len] = '\0';
+  char* newline = strchr(request, '\n');
+  if (newline == nullptr || newline == request) {
+    return;
+  }
+  *newline = '\0';
+  const char* client_ip = request[1] == ' ' && request[2] != '\0' ? request + 2 : "N/A";
 
-  printHeader(current_len);
-  printCenteredData("✧･ﾟ: *✧･ﾟ:* SYSTEM STATUS REPORT *:･ﾟ✧*:･ﾟ✧", current_len, PINK);
-  printCenteredData("uwu TR-1000 Machine Report (◕‿◕✿)", current_len, CYAN);
-  printDivider("top", current_len);
+  uid_t uid;
+  std::string user = getPeerUID(fd, uid) ? getUserName(uid) : "unknown";
 
-  printData("os", os_name, current_len, CYAN, "");
-  printData("kernel", os_kernel, current_len, CYAN, "");
-  printDivider("", current_len);
+  frame.clear();
+  {
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.snapshot.net_current_user.swap(user);
+    state.snapshot.net_client_ip = client_ip;
+    state.snapshot.timed_out &= ~(collectorBit(Collector::User) | collectorBit(Collector::ClientIP));
+    formatReport(state.snapshot, formatFromCode(request[0]), style, frame);
+  }
+  frame.buf.flush(fd);
+}
 
-  printData("hostname", net_hostname, current_len, BLUE, "");
-  printData("machine ip", net_machine_ip, current_len, BLUE, "");
-  printData("client ip", toLower(net_client_ip), current_len, BLUE, "");
-  for (size_t i = 0; i < net_dns_ip.size(); ++i) {
-    printData("dns ip " + std::to_string(i + 1), net_dns_ip[i], current_len, BLUE, "");
+inline int runDaemon(const Report& report, const Options& options) {
+  struct sockaddr_un addr;
+  if (!fillSocketAddress(options.socket_path, addr)) {
+    fprintf(stderr, "machine_report: socket path too long: %s\n", options.socket_path);
+    return 1;
   }
-  printData("user", net_current_user, current_len, PURPLE, "");
-  printDivider("", current_len);
+  // A socket file nobody answers on is left over from a previous daemon
+  const int existing = connectSocket(options.socket_path, 100);
+  if (existing >= 0) {
+    close(existing);
+    fprintf(stderr, "machine_report: a daemon is already listening on %s\n", options.socket_path);
+    return 1;
+  }
+  unlink(options.socket_path);
 
-  printData("processor", toLower(cpu.model), current_len, YELLOW, JAPANESE_CPU);
-  printData("cores", cpu_cores_str, current_len, YELLOW, "");
-  printData("hypervisor", "bare metal", current_len, YELLOW, "");
-  printData("cpu usage", cpu_usage_str, current_len, YELLOW, "");
-  printData("load 1m", cpu_1_graph, current_len, GREEN, "");
-  printData("load 5m", cpu_5_graph, current_len, GREEN, "");
-  printData("load 15m", cpu_15_graph, current_len, GREEN, "");
-  printDivider("", current_len);
+  const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0 ||
+      bind(listener, reinterpret_cast<const struct sockaddr*>(&addr), sizeof(addr)) != 0 ||
+      chmod(options.socket_path, 0666) != 0 || listen(listener, SOMAXCONN) != 0) {
+    fprintf(stderr, "machine_report: cannot listen on %s: %s\n", options.socket_path,
+            strerror(errno));
+    return 1;
+  }
+  fcntl(listener, F_SETFD, FD_CLOEXEC);
 
-  printData("volume", disk_usage_str, current_len, PINK, JAPANESE_DISK);
-  printData("disk usage", disk_graph, current_len, PINK, "");
-  printDivider("", current_len);
+  installStopHandlers();
+  signal(SIGPIPE, SIG_IGN);  // a client hanging up mid-reply is not fatal
 
-  printData("memory", mem_usage_str, current_len, PURPLE, JAPANESE_MEM);
-  printData("usage", mem_graph, current_len, PURPLE, "");
-  printDivider("", current_len);
+  DaemonState state;
+  state.snapshot = report;
 
-  printData("last login", toLower(login.time), current_len, CYAN, JAPANESE_TIME);
-  printData("uptime", toLower(login.uptime), current_len, GREEN, "");
+  sigset_t previous;
+  blockStopSignals(&previous);
+  std::thread sampler(runSampler, std::ref(state), report, options.daemon_interval);
+  pthread_sigmask(SIG_SETMASK, &previous, nullptr);
 
-  printDivider("bottom", current_len);
+  Frame frame;
+  while (!g_stop) {
+    const int fd = accept(listener, nullptr, nullptr);
+    if (fd < 0) continue;
+    serveClient(fd, state, options.render, frame);
+    close(fd);
+  }
 
+  {
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.stopping = true;
+  }
+  state.wake.notify_one();
+  sampler.join();
+  close(listener);
+  unlink(options.socket_path);
   return 0;
 }
 
-// Copy all unchanged helpers (getOSName, getDiskInfo, getDNS etc.) below this
+// Asks a running daemon for the report. Returns false when no daemon
+// answers in time, so the caller can fall back to collecting directly.
+inline bool requestFromDaemon(const Options& options, RenderBuffer& out) {
+  const int fd = connectSocket(options.socket_path, 1000);
+  if (fd < 0) {
+    return false;
+  }
+  char request[96];
+  const int len = snprintf(request, sizeof(request), "%c %.80s\n", formatCode(options.format),
+                           getClientIP().c_str());
+  bool ok = write(fd, request, static_cast<size_t>(len)) == len;
+  while (ok) {
+    char chunk[4096];
+    const ssize_t n = read(fd, chunk, sizeof(chunk));
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) {
+      ok = n == 0 && out.size > 0;
+      break;
+    }
+    out.append(chunk, static_cast<size_t>(n));
+  }
+  close(fd);
+  return ok;
+}
+
+// Longest spans first, one line each
+inline void printProfile(FILE* out) {
+  std::vector<ProfileSpan> spans = g_profiler.spans;
+  std::sort(spans.begin(), spans.end(), [](const ProfileSpan& a, const ProfileSpan& b) {
+    return a.end_ns - a.start_ns > b.end_ns - b.start_ns;
+  });
+  fprintf(out, "%-24s %10s %10s %9s %7s\n", "span", "wall ms", "cpu ms", "syscalls", "thread");
+  for (const ProfileSpan& span : spans) {
+    char label[64];
+    snprintf(label, sizeof(label), "%s.%s", span.category, span.name);
+    char syscalls[24] = "-";
+    if (span.syscalls >= 0) {
+      snprintf(syscalls, sizeof(syscalls), "%ld", span.syscalls);
+    }
+    fprintf(out, "%-24s %10.3f %10.3f %9s %7d\n", label,
+            static_cast<double>(span.end_ns - span.start_ns) / 1e6,
+            static_cast<double>(span.cpu_ns) / 1e6, syscalls, span.thread);
+  }
+}
+
+// Trace Event Format "complete" events, loadable in chrome://tracing and
+// Perfetto; timestamps are microseconds since the profiler epoch
+inline bool writeProfileTrace(const char* path) {
+  RenderBuffer out;
+  JsonWriter json(out);
+  json.beginObject();
+  json.beginArray("traceEvents");
+  const long pid = static_cast<long>(getpid());
+  for (const ProfileSpan& span : g_profiler.spans) {
+    json.beginObject();
+    json.field("name", span.name);
+    json.field("cat", span.category);
+    json.field("ph", "X");
+    json.field("ts", span.start_ns / 1000);
+    json.field("dur", (span.end_ns - span.start_ns) / 1000);
+    json.field("pid", pid);
+    json.field("tid", span.thread);
+    json.beginObject("args");
+    json.field("cpu_us", span.cpu_ns / 1000);
+    if (span.syscalls >= 0) {
+      json.field("syscalls", span.syscalls);
+    }
+    json.endObject();
+    json.endObject();
+  }
+  json.endArray();
+  json.field("displayTimeUnit", "ms");
+  json.endObject();
+  out.append('\n');
+  return writeFileAtomically(path, out);
+}
+
+// One report to stdout (or the textfile), from the daemon when asked to and
+// one is listening
+inline int reportOnce(const Options& options) {
+  if (options.client) {
+    RenderBuffer out;
+    ProfileScope scope("client", "request");
+    if (requestFromDaemon(options, out)) {
+      scope.next("write");
+      return emitOutput(options, out) ? 0 : 1;
+    }
+  }
+
+  Report report;
+  collectReport(report, options);
+
+  Frame frame;
+  ProfileScope scope("output", "format");
+  formatReport(report, options.format, options.render, frame);
+  scope.next("write");
+  return emitOutput(options, frame.buf) ? 0 : 1;
+}
+
+// tests/selftest.cpp includes this file and brings its own main
+#if !defined(MACHINE_REPORT_SELFTEST)
+int main(int argc, char** argv) {
+  const Options options = parseOptions(argc, argv);
+  g_fs_types = options.fs_types;
+  g_dns_probe_ms = options.dns_probe_ms;
+
+  if (options.daemon || options.watch_interval > 0.0) {
+    Report report;
+    collectReport(report, options);
+    return options.daemon ? runDaemon(report, options) : watchReport(report, options);
+  }
+
+  g_profiler.enabled = options.profile_path != nullptr;
+  const int status = reportOnce(options);
+  if (g_profiler.enabled) {
+    printProfile(stderr);
+    if (!writeProfileTrace(options.profile_path)) {
+      return 1;
+    }
+  }
+  return status;
+}
+#endif
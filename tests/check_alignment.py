@@ -0,0 +1,66 @@
+#!/usr/bin/env python3
+"""Check that every line of a rendered report is as wide as its top border.
+
+Widths come from Python's unicodedata rather than machine_report's own
+table: 0 for Mn, Me and Cf (except U+00AD) and the Hangul jamo U+1160-U+11FF,
+2 for East Asian Width W and F, 1 otherwise. With --require, each given
+string must appear on some line, so the rows under test are known to be
+there.
+
+Usage: check_alignment.py [--require TEXT]... FILE...
+"""
+
+import re
+import sys
+import unicodedata
+
+CSI = re.compile(r"\x1b\[[0-?]*[ -/]*[@-~]")
+
+
+def char_width(ch):
+    if ch != "\u00ad" and unicodedata.category(ch) in ("Mn", "Me", "Cf"):
+        return 0
+    if "\u1160" <= ch <= "\u11ff":
+        return 0
+    return 2 if unicodedata.east_asian_width(ch) in ("W", "F") else 1
+
+
+def display_width(line):
+    return sum(char_width(ch) for ch in CSI.sub("", line))
+
+
+def main(argv):
+    required = []
+    files = []
+    args = iter(argv)
+    for arg in args:
+        if arg == "--require":
+            required.append(next(args))
+        else:
+            files.append(arg)
+    if not files:
+        print(__doc__.strip().splitlines()[-1], file=sys.stderr)
+        return 2
+
+    failed = False
+    for path in files:
+        with open(path, encoding="utf-8") as f:
+            lines = f.read().splitlines()
+        if not lines:
+            print(f"{path}: empty")
+            failed = True
+            continue
+        width = display_width(lines[0])
+        for number, line in enumerate(lines, 1):
+            if display_width(line) != width:
+                print(f"{path}:{number}: {display_width(line)} columns, border is {width}")
+                failed = True
+        for text in required:
+            if not any(text in line for line in lines):
+                print(f"{path}: no line contains {text!r}")
+                failed = True
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
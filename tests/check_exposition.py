@@ -0,0 +1,82 @@
+#!/usr/bin/env python3
+"""Check that files parse under the classic Prometheus text format rules.
+
+node_exporter's textfile collector reads the classic format, in which a
+HELP or TYPE line names exactly the samples that follow it: a counter
+declared as `foo` whose samples are `foo_total` leaves `foo` without
+samples and `foo_total` untyped. Each metric name may be declared once, its
+samples must be contiguous, and counters and gauges must sample their
+declared name exactly.
+
+Usage: check_exposition.py FILE...
+"""
+
+import re
+import sys
+
+SAMPLE = re.compile(r"^([a-zA-Z_:][a-zA-Z0-9_:]*)(\{.*\})? (\S+)( -?\d+)?$")
+SUFFIXES = {
+    "counter": ("",),
+    "gauge": ("",),
+    "untyped": ("",),
+    "summary": ("", "_sum", "_count"),
+    "histogram": ("_bucket", "_sum", "_count"),
+}
+
+
+def check(path):
+    errors = []
+    declared = {}  # name -> type
+    sampled = set()  # names whose samples are finished or in progress
+    current = None  # name samples are being read for
+    with open(path, encoding="utf-8") as f:
+        lines = f.read().splitlines()
+    for number, line in enumerate(lines, 1):
+        where = f"{path}:{number}"
+        if line.startswith("# HELP ") or line.startswith("# TYPE "):
+            parts = line.split(" ", 3)
+            name = parts[2]
+            if line.startswith("# TYPE "):
+                kind = parts[3] if len(parts) > 3 else ""
+                if kind not in SUFFIXES:
+                    errors.append(f"{where}: unknown type {kind!r}")
+                if name in declared or name in sampled:
+                    errors.append(f"{where}: second TYPE for {name}, or TYPE after its samples")
+                declared[name] = kind
+            current = name
+            continue
+        if line.startswith("#") or not line:
+            continue
+        match = SAMPLE.match(line)
+        if not match:
+            errors.append(f"{where}: not a sample line")
+            continue
+        name = match.group(1)
+        family = None
+        if current is not None:
+            kind = declared.get(current, "untyped")
+            if any(name == current + suffix for suffix in SUFFIXES.get(kind, ("",))):
+                family = current
+        if family is None:
+            if name in sampled or name in declared:
+                errors.append(f"{where}: {name} does not follow its own TYPE line")
+            family = current = name
+        sampled.add(family)
+    for name in declared:
+        if name not in sampled:
+            errors.append(f"{path}: {name} is declared but has no samples")
+    return errors
+
+
+def main(argv):
+    if not argv:
+        print(__doc__.strip().splitlines()[-1], file=sys.stderr)
+        return 2
+    errors = [error for path in argv for error in check(path)]
+    for error in errors[:20]:
+        print(error)
+    return 1 if errors else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
@@ -0,0 +1,64 @@
+#!/usr/bin/env python3
+"""A UDP nameserver stub for the --dns-probe checks in benchmark.sh.
+
+Each argument binds one loopback address, all on the same free port, and
+says how queries to it are treated:
+
+  answer        reply at once with NOERROR
+  delay:<ms>    reply with NOERROR after <ms> milliseconds
+  servfail      reply at once with SERVFAIL
+  drop          never reply
+
+The port is printed on the first line of stdout once every address is
+bound; the stub then serves until it is killed.
+
+Usage: dns_stub.py ADDRESS=BEHAVIOUR...
+"""
+
+import select
+import socket
+import sys
+import threading
+
+NOERROR = 0
+SERVFAIL = 2
+
+
+def reply(query, rcode):
+    # Same id and question; QR and RA set, the RD bit echoed, no records
+    header = query[:2] + bytes([0x80 | (query[2] & 0x01), 0x80 | rcode])
+    return header + query[4:6] + b"\x00\x00\x00\x00\x00\x00" + query[12:]
+
+
+def main(argv):
+    if not argv or any("=" not in arg for arg in argv):
+        print(__doc__.strip().splitlines()[-1], file=sys.stderr)
+        return 2
+    behaviours = {}
+    port = 0
+    for arg in argv:
+        address, behaviour = arg.split("=", 1)
+        sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        sock.bind((address, port))
+        port = sock.getsockname()[1]
+        behaviours[sock] = behaviour
+    print(port, flush=True)
+
+    while True:
+        ready, _, _ = select.select(list(behaviours), [], [])
+        for sock in ready:
+            query, client = sock.recvfrom(512)
+            if len(query) < 12:
+                continue
+            behaviour = behaviours[sock]
+            if behaviour == "answer":
+                sock.sendto(reply(query, NOERROR), client)
+            elif behaviour == "servfail":
+                sock.sendto(reply(query, SERVFAIL), client)
+            elif behaviour.startswith("delay:"):
+                delay = int(behaviour[6:]) / 1000.0
+                threading.Timer(delay, sock.sendto, (reply(query, NOERROR), client)).start()
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
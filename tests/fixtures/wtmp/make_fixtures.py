@@ -0,0 +1,54 @@
+#!/usr/bin/env python3
+# Writes the synthetic wtmp files next to this script, in the glibc utmpx
+# layout of 64-bit Linux (384-byte records). expected.txt holds what
+# `selftest wtmp` reports for each of them.
+
+import ipaddress
+import os
+import struct
+
+RECORD = struct.Struct("<h2xi32s4s32s256shhiii16s20s")
+assert RECORD.size == 384
+
+BOOT_TIME, LOGIN_PROCESS, USER_PROCESS, DEAD_PROCESS, RUN_LVL = 2, 6, 7, 8, 1
+
+
+def record(kind, when, user="", line="", host="", addr=None, pid=1000):
+    packed = ipaddress.ip_address(addr).packed.ljust(16, b"\0") if addr else bytes(16)
+    return RECORD.pack(kind, pid, line.encode(), b"", user.encode(), host.encode(), 0, 0, 0,
+                       when, 0, packed, b"")
+
+
+def write(name, data):
+    with open(os.path.join(os.path.dirname(os.path.abspath(__file__)), name), "wb") as f:
+        f.write(data)
+
+
+write("empty.wtmp", b"")
+
+# Shorter than one record
+write("partial.wtmp", record(USER_PROCESS, 1700000000, "alice", "pts/0")[:100])
+
+# Boot, two sessions and their logouts, then a getty waiting on tty1: the
+# newest login is bob's, whose binary IPv6 address wins over ut_host
+write("logins.wtmp",
+      record(BOOT_TIME, 1699999000, "reboot", "~", "6.1.0") +
+      record(USER_PROCESS, 1700000000, "alice", "pts/0", "10.0.0.5", "10.0.0.5") +
+      record(DEAD_PROCESS, 1700000100, "", "pts/0") +
+      record(USER_PROCESS, 1700000200, "bob", "pts/1", "laptop.example.com", "2001:db8::7") +
+      record(DEAD_PROCESS, 1700000300, "", "pts/1") +
+      record(LOGIN_PROCESS, 1700000400, "LOGIN", "tty1"))
+
+# A record torn off by a crash mid-append follows the last whole login
+write("truncated.wtmp",
+      record(BOOT_TIME, 1699999000, "reboot", "~", "6.1.0") +
+      record(USER_PROCESS, 1700000300, "carol", "tty1") +
+      record(USER_PROCESS, 1700000500, "mallory", "pts/2", "192.0.2.1", "192.0.2.1")[:200])
+
+# Boots, run levels, gettys and logouts, and a USER_PROCESS without a user
+write("no_logins.wtmp",
+      record(BOOT_TIME, 1699999000, "reboot", "~", "6.1.0") +
+      record(RUN_LVL, 1699999001, "runlevel", "~", "6.1.0") +
+      record(LOGIN_PROCESS, 1699999002, "LOGIN", "tty1") +
+      record(DEAD_PROCESS, 1699999003, "", "pts/0") +
+      record(USER_PROCESS, 1699999004, "", "pts/3"))
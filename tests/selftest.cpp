@@ -0,0 +1,561 @@
+// Checks of machine_report internals that cannot be driven through the
+// command line, run by benchmark.sh:
+//
+//   c++ -std=c++17 -O2 -o selftest tests/selftest.cpp -lpthread
+//   ./selftest <check> [args...]
+//
+// Every check prints what it found and exits 0 when it passed, 1 when it
+// failed and 2 on a usage error. Fixtures live in tests/fixtures. The test
+// hooks are compiled in, so MACHINE_REPORT_STALL applies here too.
+
+#define MACHINE_REPORT_SELFTEST
+#define MACHINE_REPORT_TEST_HOOKS
+#include "../machine_report.cpp"
+
+namespace {
+
+// A report with every section filled in and round numbers, so its rendering
+// is the same on every machine
+std::unique_ptr<Report> fixedReport() {
+  auto report = std::make_unique<Report>();
+  Report& r = *report;
+  r.os_name = "Debian GNU/Linux 12 (bookworm)";
+  r.os_kernel = "Linux 6.1.0-18-amd64";
+  r.net_hostname = "Build-Host-07";
+  r.net_machine_ip = "10.0.3.17";
+  r.net_client_ip = "192.0.2.44";
+  r.net_current_user = "Alice";
+  r.net_dns_ip = {"10.0.0.2", "10.0.0.3", "1.1.1.1"};
+  r.dns_probe = {{"10.0.0.2", ResolverStatus::Ok, 0.8},
+                 {"10.0.0.3", ResolverStatus::Slow, 240.0},
+                 {"1.1.1.1", ResolverStatus::Dead, -1.0}};
+
+  const auto name = [](char* dest, size_t size, const char* value) {
+    snprintf(dest, size, "%s", value);
+  };
+  NetAddresses& addresses = r.net_addresses;
+  name(addresses.interfaces[0].name, IFNAMSIZ, "eth0");
+  name(addresses.interfaces[0].ipv4, INET_ADDRSTRLEN, "10.0.3.17");
+  name(addresses.interfaces[1].name, IFNAMSIZ, "wg0");
+  name(addresses.interfaces[1].ipv6, INET6_ADDRSTRLEN, "fd00::17");
+  addresses.count = 2;
+  NetSample& net = r.net_sample;
+  net.interfaces[0] = {"eth0", 9000000000, 3000000000, 0, 0, 0, 2, 1250000.0, 310000.0};
+  net.interfaces[1] = {"wg0", 4000000, 1000000, 0, 0, 0, 0, 12000.0, 800.0};
+  net.interfaces[2] = {"docker0", 0, 0, 0, 0, 0, 0, -1.0, -1.0};
+  net.count = 3;
+  net.taken_ns = 1;
+
+  DiskIOSample& io = r.disk_io;
+  io.devices[0].reads = 1000;
+  name(io.devices[0].name, sizeof(io.devices[0].name), "nvme0n1");
+  io.devices[0].read_iops = 120.0;
+  io.devices[0].write_iops = 30.0;
+  io.devices[0].read_rate = 4200000.0;
+  io.devices[0].write_rate = 1100000.0;
+  io.devices[0].await_ms = 0.8;
+  io.devices[0].utilization = 62.0;
+  io.devices[1].reads = 10;
+  name(io.devices[1].name, sizeof(io.devices[1].name), "sda");
+  io.devices[1].read_iops = 0.0;
+  io.devices[1].write_iops = 4.0;
+  io.devices[1].read_rate = 0.0;
+  io.devices[1].write_rate = 16000.0;
+  io.devices[1].await_ms = 12.0;
+  io.devices[1].utilization = 0.0;
+  io.count = 2;
+  io.taken_ns = 1;
+
+  r.processes.wanted = 2;
+  r.processes.by_cpu = {{4242, "cc1plus", 97.5, 512ull << 20}, {17, "kswapd0", 3.2, 0}};
+  r.processes.by_rss = {{4242, "cc1plus", 97.5, 512ull << 20}, {901, "postgres", 0.4, 3ull << 30}};
+
+  CPUInfo& cpu = r.cpu;
+  cpu.model = "AMD EPYC 7763 64-Core Processor";
+  cpu.cores_physical = 16;
+  cpu.cores_logical = 32;
+  cpu.sockets = 1;
+  cpu.topology.threads_per_core = 2;
+  cpu.topology.caches = {{1, 'd', 32 << 10, 2, 16}, {1, 'i', 32 << 10, 2, 16},
+                         {2, 'u', 512 << 10, 2, 16}, {3, 'u', 32 << 20, 16, 2}};
+  cpu.topology.numa = {{0, "0-7,16-23"}, {1, "8-15,24-31"}};
+  cpu.load_1 = 12.0;
+  cpu.load_5 = 20.0;
+  cpu.load_15 = 28.0;
+  r.platform = {"kvm", "aws", "m6a.8xlarge"};
+
+  r.login.user = "alice";
+  r.login.tty = "pts/0";
+  r.login.timestamp = 1700000000;
+  r.login.time = "Tue 10:13 PM";
+  r.login.ip = "192.0.2.44";
+  r.login.ip_present = true;
+
+  MemInfo& mem = r.mem;
+  mem.total = 64ull << 30;
+  mem.used = 24ull << 30;
+  mem.percent = 37.5;
+  mem.available = 40ull << 30;
+  mem.wired = 4ull << 30;
+  mem.compressed = 1ull << 30;
+  mem.file_backed = 16ull << 30;
+  mem.swap_total = 8ull << 30;
+  mem.swap_used = 1ull << 29;
+
+  r.pressure.cpu = {true, {2.4, 1.0, 0.5}, {0.0, 0.0, 0.0}};
+  r.pressure.memory = {true, {0.3, 0.1, 0.0}, {0.1, 0.0, 0.0}};
+  r.pressure.io = {true, {5.5, 3.0, 1.2}, {4.0, 2.1, 0.9}};
+  CgroupInfo& cgroup = r.cgroup;
+  cgroup.present = true;
+  cgroup.path = "/system.slice/build.service";
+  cgroup.cpu_limit = 8.0;
+  cgroup.cpu_periods = 1000;
+  cgroup.cpu_throttled_periods = 125;
+  cgroup.memory_current = 6ull << 30;
+  cgroup.memory_max = 16ull << 30;
+  cgroup.io_read_bytes = 2500000000;
+  cgroup.io_write_bytes = 730000000;
+  cgroup.pressure.cpu = {true, {8.0, 4.0, 2.0}, {0.0, 0.0, 0.0}};
+
+  r.disks = {{"/", "ext4", 500ull * 1000 * 1000 * 1000, 210ull * 1000 * 1000 * 1000, 42.0},
+             {"/var/lib/docker", "xfs", 2000ull * 1000 * 1000 * 1000,
+              1700ull * 1000 * 1000 * 1000, 85.0}};
+  r.uptime_seconds = 3 * 86400 + 7200;
+  r.uptime = "3 days";
+
+  CPUUsage& usage = r.cpu_usage;
+  usage.busy = 43.0;
+  usage.user = 31.0;
+  usage.system = 9.0;
+  usage.iowait = 2.0;
+  usage.steal = 1.0;
+  for (int i = 0; i < 32; ++i) {
+    usage.cores.push_back(static_cast<double>(i * 3 % 100));
+  }
+  return report;
+}
+
+// The fixed report rendered as the terminal gets it; with "timeouts" every
+// collector is marked as having missed its deadline
+int checkRender(int argc, char** argv) {
+  std::unique_ptr<Report> report = fixedReport();
+  if (argc > 0 && strcmp(argv[0], "timeouts") == 0) {
+    report->timed_out = ALL_COLLECTORS;
+  }
+  Frame frame;
+  renderReport(*report, RenderOptions(), frame);
+  return frame.buf.flush(STDOUT_FILENO) ? 0 : 1;
+}
+
+// The fixed report as --prometheus prints it, or with "classic" as
+// --textfile writes it
+int checkMetrics(int argc, char** argv) {
+  std::unique_ptr<Report> report = fixedReport();
+  const bool classic = argc > 0 && strcmp(argv[0], "classic") == 0;
+  Frame frame;
+  formatReport(*report, classic ? OutputFormat::PrometheusText : OutputFormat::Prometheus,
+               RenderOptions(), frame);
+  return frame.buf.flush(STDOUT_FILENO) ? 0 : 1;
+}
+
+// getDisplayWidth as it was before the vector fast path: byte by byte, two
+// columns for any 4-byte sequence. It loops forever on a CSI sequence cut
+// off by a byte outside the parameter range, so it is only given input it
+// handles.
+size_t scalarDisplayWidth(const std::string& str) {
+  size_t width = 0;
+  for (size_t i = 0; i < str.length(); ) {
+    unsigned char c = static_cast<unsigned char>(str[i]);
+    if (c == 0x1B) {
+      size_t j = i + 1;
+      if (j < str.length() && str[j] == '[') {
+        j++;
+        while (j < str.length()) {
+          unsigned char ch = static_cast<unsigned char>(str[j]);
+          if (ch >= 0x40 && ch <= 0x7E) {
+            i = j + 1;
+            break;
+          }
+          if (ch < 0x20 || ch > 0x3F) {
+            break;
+          }
+          j++;
+        }
+        if (j >= str.length()) {
+          i = str.length();
+        }
+        continue;
+      }
+      width += 1;
+      i += 1;
+    } else if ((c & 0x80) == 0) {
+      width += 1;
+      i += 1;
+    } else if ((c & 0xE0) == 0xC0) {
+      if (i + 1 < str.length()) {
+        unsigned char c1 = static_cast<unsigned char>(str[i + 1]);
+        if ((c == 0xC2 && c1 >= 0xA1 && c1 <= 0xAF) || (c == 0xC3 && c1 >= 0x80 && c1 <= 0xBF)) {
+          width += 1;
+        } else {
+          width += 2;
+        }
+      } else {
+        width += 2;
+      }
+      i += 2;
+    } else if ((c & 0xF0) == 0xE0) {
+      width += 1;
+      i += 3;
+    } else if ((c & 0xF8) == 0xF0) {
+      width += 2;
+      i += 4;
+    } else {
+      width += 1;
+      i += 1;
+    }
+  }
+  return width;
+}
+
+// The current rules without the fast path: every token through
+// displayTokenWidth, one at a time
+size_t tokenDisplayWidth(const std::string& str) {
+  size_t width = 0;
+  for (size_t i = 0; i < str.size();) {
+    width += displayTokenWidth(str.data(), str.size(), i);
+  }
+  return width;
+}
+
+// xorshift64*, so every run and every machine fuzzes the same strings
+struct Random {
+  uint64_t state = 0x9E3779B97F4A7C15ull;
+  uint64_t next() {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545F4914F6CDD1Dull;
+  }
+  size_t below(size_t n) { return static_cast<size_t>(next() % n); }
+};
+
+const char* const FUZZ_PIECES[] = {
+    "a", "Z", " ", "~", "0", "\t", "\x1b[0m", "\x1b[38;5;213m", "\x1b[1m", "\x1b[2m", "\x1b",
+    "\xe3\x81\x8d", "\xe2\x96\xb0", "\xf0\x9f\x98\x80", "\xc3\xa9", "\xcc\x81", "\xe2\x80\x8b",
+    "\xef\xbd\xa5", "\x1b[", "\x1b[12", "\xe3\x81", "\x80", "\xff", "\xf0\x9f",
+};
+// The first eleven pieces are the ones the old function measures the same
+constexpr size_t OLD_COMPATIBLE_PIECES = 11;
+
+std::string fuzzString(Random& random, size_t pieces) {
+  std::string str;
+  const size_t count = random.below(48);
+  for (size_t i = 0; i < count; ++i) {
+    // Mostly long ASCII runs, so the vector loops and their tails are hit
+    if (random.below(3) == 0) {
+      str.append(random.below(70), static_cast<char>('a' + random.below(26)));
+    } else {
+      str += FUZZ_PIECES[random.below(pieces)];
+    }
+  }
+  return str;
+}
+
+// plainASCIIPrefix against a byte loop for a special byte at every position
+// and alignment of strings up to 160 bytes, then getDisplayWidth against the
+// token loop on random bytes and pieces, and against the old function on
+// the input both define the same way
+int checkWidthFuzz(int argc, char** argv) {
+  const size_t rounds = argc > 0 ? strtoul(argv[0], nullptr, 10) : 200000;
+  size_t failures = 0;
+  const auto fail = [&failures](const std::string& str, size_t got, size_t want,
+                                const char* what) {
+    if (++failures > 10) return;
+    printf("%s: got %zu, want %zu for \"", what, got, want);
+    for (unsigned char c : str) printf(c >= 0x20 && c < 0x7F ? "%c" : "\\x%02x", c);
+    printf("\"\n");
+  };
+
+  char buf[192];
+  for (const unsigned char special : {0x1B, 0x80, 0xC3, 0xFF}) {
+    for (size_t offset = 0; offset < 32; ++offset) {
+      for (size_t len = 0; len <= 160; ++len) {
+        for (size_t at = 0; at <= len; ++at) {
+          memset(buf, 'x', sizeof(buf));
+          if (at < len) buf[offset + at] = static_cast<char>(special);
+          const size_t got = plainASCIIPrefix(buf + offset, len);
+          if (got != at) fail(std::string(buf + offset, len), got, at, "plainASCIIPrefix");
+        }
+      }
+    }
+  }
+
+  Random random;
+  std::string bytes;
+  for (size_t round = 0; round < rounds; ++round) {
+    const std::string str = fuzzString(random, sizeof(FUZZ_PIECES) / sizeof(FUZZ_PIECES[0]));
+    const size_t width = getDisplayWidth(str);
+    const size_t want = tokenDisplayWidth(str);
+    if (width != want) fail(str, width, want, "token loop");
+
+    const std::string old_str = fuzzString(random, OLD_COMPATIBLE_PIECES);
+    const size_t old_width = getDisplayWidth(old_str);
+    const size_t old_want = scalarDisplayWidth(old_str);
+    if (old_width != old_want) fail(old_str, old_width, old_want, "old scalar");
+
+    bytes.resize(random.below(100));
+    for (char& c : bytes) c = static_cast<char>(random.next() >> 56);
+    const size_t bytes_width = getDisplayWidth(bytes);
+    const size_t bytes_want = tokenDisplayWidth(bytes);
+    if (bytes_width != bytes_want) fail(bytes, bytes_width, bytes_want, "random bytes");
+  }
+#if defined(__AVX2__)
+  const char* path = "avx2";
+#elif defined(__SSE2__)
+  const char* path = "sse2";
+#elif defined(__aarch64__)
+  const char* path = "neon";
+#else
+  const char* path = "scalar";
+#endif
+  printf("%s: %zu mismatches in %zu rounds\n", path, failures, rounds);
+  return failures == 0 ? 0 : 1;
+}
+
+// Nanoseconds per call of the old function, the token loop and
+// getDisplayWidth over the rows of the fixed report, as the layout pass
+// measures them, and over long plain ASCII
+int checkWidthBench(int, char**) {
+  std::unique_ptr<Report> report = fixedReport();
+  Frame frame;
+  renderReport(*report, RenderOptions(), frame);
+  std::vector<std::string> rows;
+  for (size_t i = 0; i < frame.rows(); ++i) rows.emplace_back(frame.row(i));
+  const std::vector<std::string> ascii = {std::string(64, 'x'), std::string(200, 'y'),
+                                          "debian gnu/linux 12 (bookworm)", "10.0.3.17"};
+
+  const auto time = [](const std::vector<std::string>& corpus, size_t (*width)(const std::string&)) {
+    constexpr int ROUNDS = 20000;
+    volatile size_t sink = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < ROUNDS; ++round) {
+      for (const std::string& str : corpus) sink = sink + width(str);
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    return static_cast<double>(
+               std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) /
+           (static_cast<double>(ROUNDS) * static_cast<double>(corpus.size()));
+  };
+  const auto current = [](const std::string& str) { return getDisplayWidth(str); };
+  // The token loop applies today's width rules without the fast path, which
+  // separates what the rules cost from what the fast path saves
+  printf("report rows:  old %6.1f ns  token loop %6.1f ns  now %6.1f ns\n",
+         time(rows, scalarDisplayWidth), time(rows, tokenDisplayWidth), time(rows, current));
+  printf("plain ascii:  old %6.1f ns  token loop %6.1f ns  now %6.1f ns\n",
+         time(ascii, scalarDisplayWidth), time(ascii, tokenDisplayWidth), time(ascii, current));
+  return 0;
+}
+
+// codePointWidth for every code point against a linear search of
+// WIDTH_RANGES, after checking the ranges are sorted, disjoint and above
+// ASCII as buildWidthTable assumes
+int checkWidthTable(int, char**) {
+  size_t failures = 0;
+  char32_t previous = 0x7F;
+  for (const WidthRange& range : WIDTH_RANGES) {
+    if (range.first <= previous || range.last < range.first || range.width > 2) {
+      printf("range U+%04X-U+%04X is out of order\n", static_cast<unsigned>(range.first),
+             static_cast<unsigned>(range.last));
+      ++failures;
+    }
+    previous = range.last;
+  }
+  for (char32_t cp = 0; cp <= 0x10FFFF + 16; ++cp) {
+    unsigned want = 1;
+    for (const WidthRange& range : WIDTH_RANGES) {
+      if (cp >= range.first && cp <= range.last) {
+        want = range.width;
+        break;
+      }
+    }
+    const unsigned got = codePointWidth(cp);
+    if (got != want && ++failures <= 10) {
+      printf("U+%04X: table says %u, ranges say %u\n", static_cast<unsigned>(cp), got, want);
+    }
+  }
+  printf("%zu ranges, %zu distinct blocks, %zu mismatches\n",
+         sizeof(WIDTH_RANGES) / sizeof(WIDTH_RANGES[0]), WIDTH_TABLE_FULL.count, failures);
+  return failures == 0 ? 0 : 1;
+}
+
+// printDivider as it was before BoxLayout: the coloured corners and one
+// copy of the 3-byte glyph per column, on every call
+void columnDivider(Frame& frame, int current_len) {
+  const int length = current_len + MAX_NAME_LEN + BORDERS_AND_PADDING;
+  RenderBuffer& out = frame.buf;
+  out.append(CYAN);
+  out.append("├");
+  const char* glyph = "─";
+  const size_t glyph_len = strlen(glyph);
+  out.reserve(glyph_len * static_cast<size_t>(length - 2));
+  for (int i = 2; i < length; ++i) {
+    memcpy(out.storage.data() + out.size, glyph, glyph_len);
+    out.size += glyph_len;
+  }
+  out.append("┤");
+  out.append(RESET);
+  frame.endRow();
+}
+
+// Nanoseconds per divider for the per-column path and printBorder at box
+// widths from 20 to 200 columns, after checking they draw the same bytes
+int checkBorderBench(int, char**) {
+  Frame old_frame;
+  Frame new_frame;
+  for (const int width : {20, 50, 100, 150, 200}) {
+    const int current_len = width - MAX_NAME_LEN - BORDERS_AND_PADDING;
+    old_frame.clear();
+    new_frame.clear();
+    columnDivider(old_frame, current_len);
+    printBorder(new_frame, boxLayout(current_len), Border::Divider);
+    if (old_frame.row(0) != new_frame.row(0)) {
+      printf("%d columns: printBorder draws a different line\n", width);
+      return 1;
+    }
+
+    const auto time = [current_len](Frame& frame, void (*draw)(Frame&, int)) {
+      constexpr int ROUNDS = 200000;
+      const auto start = std::chrono::steady_clock::now();
+      for (int round = 0; round < ROUNDS; ++round) {
+        frame.clear();
+        draw(frame, current_len);
+      }
+      const auto elapsed = std::chrono::steady_clock::now() - start;
+      return static_cast<double>(
+                 std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) /
+             ROUNDS;
+    };
+    const auto layout = [](Frame& frame, int len) {
+      printBorder(frame, boxLayout(len), Border::Divider);
+    };
+    printf("%3d columns:  per column %6.1f ns  layout %6.1f ns\n", width,
+           time(old_frame, columnDivider), time(new_frame, layout));
+  }
+  return 0;
+}
+
+// A parallel scan of this process, listed once per slot across sixteen
+// chunks, on four threads, and a second one over the descriptors the first
+// kept. Every slot must be read both times; with "stalled", run under
+// MACHINE_REPORT_STALL=process_scan:<ms>, the chunks the pool workers took
+// must be dropped instead and the scan must end soon after its
+// IO_DEADLINE_MS wait.
+int checkProcessScan(int argc, char** argv) {
+  const bool stalled = argc > 0 && strcmp(argv[0], "stalled") == 0;
+  const size_t count = 16 * SCAN_CHUNK;
+  std::vector<int> pids(count, static_cast<int>(getpid()));
+  std::vector<int> fds(count, -1);
+  std::vector<ProcessSample> samples(count);
+  const auto countRead = [&samples] {
+    return static_cast<size_t>(std::count_if(
+        samples.begin(), samples.end(), [](const ProcessSample& sample) { return sample.pid != 0; }));
+  };
+  const auto start = std::chrono::steady_clock::now();
+  scanInParallel(pids, fds, samples, 4);
+  const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start).count();
+  const size_t read = countRead();
+  const size_t kept =
+      static_cast<size_t>(std::count_if(fds.begin(), fds.end(), [](int fd) { return fd >= 0; }));
+  printf("%zu of %zu processes read in %lld ms", read, count, static_cast<long long>(ms));
+  int status;
+  if (stalled) {
+    printf("\n");
+    status = read > 0 && read < count && ms < IO_DEADLINE_MS + 200 ? 0 : 1;
+  } else {
+    for (ProcessSample& sample : samples) sample.pid = 0;
+    scanInParallel(pids, fds, samples, 4);
+    printf(", %zu of them again through %zu kept descriptors\n", countRead(), kept);
+    status = read == count && countRead() == count ? 0 : 1;
+  }
+  for (int& fd : fds) closeProcessFd(fd);
+  return status;
+}
+
+#if defined(__linux__)
+// One line per wtmp file: the newest login found by the reverse scan, with
+// the raw timestamp so the output does not depend on the time zone
+int checkWtmp(int argc, char** argv) {
+  for (int i = 0; i < argc; ++i) {
+    const char* slash = strrchr(argv[i], '/');
+    printf("%s:", slash != nullptr ? slash + 1 : argv[i]);
+    LoginInfo info;
+    if (readLastLogin(argv[i], info)) {
+      printf(" %s %s %lld %s\n", info.user.c_str(), info.tty.c_str(),
+             static_cast<long long>(info.timestamp), info.ip_present ? info.ip.c_str() : "-");
+    } else {
+      printf(" none\n");
+    }
+  }
+  return 0;
+}
+
+// The volumes getDisks finds in each mountinfo file, twice in a row, so that
+// a network mount stalled on the first pass is seen skipped on the second
+int checkDisks(int argc, char** argv) {
+  for (int i = 0; i < argc; ++i) {
+    const char* slash = strrchr(argv[i], '/');
+    for (int pass = 0; pass < 2; ++pass) {
+      printf("%s:", slash != nullptr ? slash + 1 : argv[i]);
+      for (const DiskInfo& disk : getDisks(DEFAULT_FS_TYPES, argv[i])) {
+        printf(" %s %s", disk.mount.c_str(), disk.fstype.c_str());
+      }
+      printf("\n");
+    }
+  }
+  return 0;
+}
+#endif
+
+struct Check {
+  const char* name;
+  const char* usage;
+  int (*run)(int argc, char** argv);
+};
+
+constexpr Check CHECKS[] = {
+    {"render", "[timeouts]", checkRender},
+    {"metrics", "[classic]", checkMetrics},
+    {"width-fuzz", "[rounds]", checkWidthFuzz},
+    {"width-bench", "", checkWidthBench},
+    {"width-table", "", checkWidthTable},
+    {"border-bench", "", checkBorderBench},
+    {"process-scan", "[stalled]", checkProcessScan},
+#if defined(__linux__)
+    {"wtmp", "<wtmp file>...", checkWtmp},
+    {"disks", "<mountinfo>...", checkDisks},
+#endif
+};
+
+void printChecks(FILE* out) {
+  fprintf(out, "usage: selftest <check> [args...]\n");
+  for (const Check& check : CHECKS) {
+    fprintf(out, "  %s %s\n", check.name, check.usage);
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    printChecks(stderr);
+    return 2;
+  }
+  for (const Check& check : CHECKS) {
+    if (strcmp(argv[1], check.name) == 0) {
+      return check.run(argc - 2, argv + 2);
+    }
+  }
+  printChecks(stderr);
+  return 2;
+}